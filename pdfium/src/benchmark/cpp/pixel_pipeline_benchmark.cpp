@@ -0,0 +1,144 @@
+//
+// Host check and benchmark of the pixel pipeline kernels, see utils/PixelPipeline.h.
+//
+// Every affine pass of the ColorMode presets, and of random transforms, is run by the scalar
+// reference and by each vector kernel the host CPU has, on RGBA and RGB tiles. The outputs must
+// be bit-identical, then each kernel is timed on a 512 x 512 tile. Exits with 1 on a mismatch.
+//
+// Run scripts/run_native_benchmarks.sh, on an ARM host or device for the NEON kernel.
+//
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <PixelPipeline.h>
+
+static const int kTileSize = 512;
+static const int kTimedRuns = 50;
+
+struct Kernel {
+    const char *name;
+    AffinePixelsKernel run;
+};
+
+static uint32_t sSeed = 12345;
+
+static uint32_t nextRandom() {
+    sSeed = sSeed * 1664525u + 1013904223u;
+    return sSeed >> 8;
+}
+
+// Premultiplied pixels, mostly opaque like a page, with transparent and translucent ones
+static void fillTile(std::vector<uint8_t> *pixels, int bytesPerPixel) {
+    for (size_t i = 0; i < pixels->size(); i += bytesPerPixel) {
+        uint32_t kind = nextRandom() % 8;
+        int alpha = kind == 0 ? 0 : (kind == 1 ? (int) (nextRandom() % 256) : 255);
+        if (bytesPerPixel == 3) alpha = 255;
+        for (int c = 0; c < 3; c++) {
+            (*pixels)[i + c] = (uint8_t) (alpha == 0 ? 0 : nextRandom() % (alpha + 1));
+        }
+        if (bytesPerPixel == 4) (*pixels)[i + 3] = (uint8_t) alpha;
+    }
+}
+
+static void addStage(std::vector<float> *stages, int type, const float *params, int count) {
+    stages->push_back((float) type);
+    for (int i = 0; i < PIXEL_STAGE_SIZE - 1; i++) stages->push_back(i < count ? params[i] : 0);
+}
+
+// Affine passes of the presets of ColorMode and of random transforms
+static std::vector<PixelStage> testPasses() {
+    std::vector<PixelStage> passes;
+    std::vector<std::vector<float> > pipelines(5);
+    addStage(&pipelines[0], PIXEL_STAGE_INVERT, NULL, 0);
+    const float sepia[6] = {0xF4, 0xEC, 0xD8, 0x5B, 0x46, 0x36};
+    addStage(&pipelines[1], PIXEL_STAGE_GRAYSCALE, NULL, 0);
+    addStage(&pipelines[1], PIXEL_STAGE_TINT, sepia, 6);
+    const float contrast[2] = {1, 2};
+    addStage(&pipelines[2], PIXEL_STAGE_GRAYSCALE, NULL, 0);
+    addStage(&pipelines[2], PIXEL_STAGE_TONE, contrast, 2);
+    addStage(&pipelines[3], PIXEL_STAGE_INVERT_LUMINANCE, NULL, 0);
+    const float gamma[2] = {0.7f, 1.3f};
+    addStage(&pipelines[4], PIXEL_STAGE_TONE, gamma, 2);
+    addStage(&pipelines[4], PIXEL_STAGE_INVERT, NULL, 0);
+    for (size_t p = 0; p < pipelines.size(); p++) {
+        PixelPipeline pipeline;
+        buildPixelPipeline(pipelines[p].data(), (int) pipelines[p].size(), &pipeline);
+        for (size_t s = 0; s < pipeline.size(); s++) {
+            if (!pipeline[s].isCurve) passes.push_back(pipeline[s]);
+        }
+    }
+    // Weights over the whole Q8 range the quantizer can produce
+    for (int r = 0; r < 16; r++) {
+        PixelStage stage;
+        stage.isCurve = false;
+        for (int i = 0; i < 12; i++) {
+            stage.coefficients[i] = (int16_t) ((int) (nextRandom() % 1025) - 512);
+        }
+        passes.push_back(stage);
+    }
+    return passes;
+}
+
+static double nowMs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+int main() {
+    std::vector<Kernel> kernels;
+    kernels.push_back(Kernel{"scalar", affinePixelsScalar});
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    kernels.push_back(Kernel{"neon", affinePixelsNeon});
+#endif
+#if defined(__SSE2__)
+    kernels.push_back(Kernel{"sse2", affinePixelsSse2});
+#endif
+
+    std::vector<PixelStage> passes = testPasses();
+    int pixels = kTileSize * kTileSize;
+    bool identical = true;
+    for (int bytesPerPixel = 3; bytesPerPixel <= 4; bytesPerPixel++) {
+        std::vector<uint8_t> source((size_t) pixels * bytesPerPixel);
+        // An odd width leaves pixels over for the scalar tail of the vector kernels
+        int rowPixels = kTileSize - 3;
+        fillTile(&source, bytesPerPixel);
+        for (size_t p = 0; p < passes.size(); p++) {
+            std::vector<uint8_t> expected = source;
+            for (int y = 0; y < kTileSize; y++) {
+                affinePixelsScalar(&expected[(size_t) y * kTileSize * bytesPerPixel], rowPixels,
+                                   bytesPerPixel, passes[p].coefficients);
+            }
+            for (size_t k = 1; k < kernels.size(); k++) {
+                std::vector<uint8_t> actual = source;
+                for (int y = 0; y < kTileSize; y++) {
+                    kernels[k].run(&actual[(size_t) y * kTileSize * bytesPerPixel], rowPixels,
+                                   bytesPerPixel, passes[p].coefficients);
+                }
+                if (memcmp(actual.data(), expected.data(), actual.size()) != 0) {
+                    printf("MISMATCH %s, pass %zu, %d bytes per pixel\n", kernels[k].name, p,
+                           bytesPerPixel);
+                    identical = false;
+                }
+            }
+        }
+
+        for (size_t k = 0; k < kernels.size(); k++) {
+            std::vector<uint8_t> tile = source;
+            double start = nowMs();
+            for (int run = 0; run < kTimedRuns; run++) {
+                const int16_t *m = passes[run % passes.size()].coefficients;
+                for (int y = 0; y < kTileSize; y++) {
+                    kernels[k].run(&tile[(size_t) y * kTileSize * bytesPerPixel], kTileSize,
+                                   bytesPerPixel, m);
+                }
+            }
+            printf("%-6s %s %dx%d: %.3f ms per pass\n", kernels[k].name,
+                   bytesPerPixel == 4 ? "RGBA" : "RGB ", kTileSize, kTileSize,
+                   (nowMs() - start) / kTimedRuns);
+        }
+    }
+    printf("%s\n", identical ? "All kernels match the scalar reference" : "Kernels differ");
+    return identical ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+//
+// Host check and benchmark of the glyph grid of utils/TextSpatialIndex.h on dense pages.
+//
+// The grid is compared with a scan over every character box, which is how
+// FPDFText_GetCharIndexAtPos finds a character. Both must return the same character for every
+// point and the same characters for every rect, then both are timed. Exits with 1 on a mismatch.
+// pdfium itself is not linked, the scan uses the same ranking as the grid.
+//
+// Run scripts/run_native_benchmarks.sh.
+//
+#include <stdio.h>
+#include <time.h>
+
+#include <TextSpatialIndex.h>
+
+static const int kQueries = 20000;
+static const int kRectQueries = 2000;
+
+struct PageLayout {
+    const char *name;
+    float fontSize;
+    int columns;  // table columns of the page, one gap of two characters between them
+};
+
+static uint32_t sSeed = 12345;
+
+static float nextUnit() {
+    sSeed = sSeed * 1664525u + 1013904223u;
+    return (sSeed >> 8) / 16777216.0f;
+}
+
+// A US letter page of lines of characters, with an empty box ending every line like pdfium's
+// generated line breaks, in PDF user space with y going up
+static void layoutPage(const PageLayout &layout, std::vector<float> *boxes) {
+    float charWidth = layout.fontSize * 0.55f;
+    float lineHeight = layout.fontSize * 1.2f;
+    float columnWidth = (540.0f - (layout.columns - 1) * 2 * charWidth) / layout.columns;
+    int charsPerColumn = (int) (columnWidth / charWidth);
+    for (float top = 756; top - layout.fontSize > 36; top -= lineHeight) {
+        for (int column = 0; column < layout.columns; column++) {
+            float left = 36 + column * (columnWidth + 2 * charWidth);
+            for (int c = 0; c < charsPerColumn; c++) {
+                // Cells of a sheet are not full, leave some characters out
+                if (nextUnit() < 0.2f) continue;
+                float x = left + c * charWidth;
+                float box[4] = {x, top, x + charWidth, top - layout.fontSize};
+                boxes->insert(boxes->end(), box, box + 4);
+            }
+        }
+        float lineBreak[4] = {0, 0, 0, 0};
+        boxes->insert(boxes->end(), lineBreak, lineBreak + 4);
+    }
+}
+
+static int scanCharAtPos(const std::vector<float> &boxes, float px, float py, float tx,
+                         float ty) {
+    int found = -1;
+    float foundDistance = 0, foundCenter = 0;
+    for (size_t i = 0; i < boxes.size() / 4; i++) {
+        const float *b = &boxes[i * 4];
+        if (b[2] <= b[0] || b[1] <= b[3]) continue;
+        float distance, center;
+        if (!rankTextBox(b, px, py, tx, ty, &distance, &center)) continue;
+        if (found == -1 || distance < foundDistance ||
+            (distance == foundDistance && center < foundCenter)) {
+            found = (int) i;
+            foundDistance = distance;
+            foundCenter = center;
+        }
+    }
+    return found;
+}
+
+static void scanCharsInRect(const std::vector<float> &boxes, float left, float top, float right,
+                            float bottom, std::vector<int> *chars) {
+    for (size_t i = 0; i < boxes.size() / 4; i++) {
+        const float *b = &boxes[i * 4];
+        if (b[2] <= b[0] || b[1] <= b[3]) continue;
+        if (b[2] < left || b[0] > right || b[1] < bottom || b[3] > top) continue;
+        chars->push_back((int) i);
+    }
+}
+
+static double nowMs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+int main() {
+    const PageLayout layouts[] = {
+            {"prose, 10 pt", 10, 1},
+            {"spreadsheet, 6 pt", 6, 12},
+            {"parts list, 3 pt", 3, 8},
+    };
+    bool identical = true;
+    for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        TextSpatialIndex index;
+        layoutPage(layouts[l], &index.boxes);
+        int chars = (int) (index.boxes.size() / 4);
+
+        double start = nowMs();
+        buildTextGrid(&index);
+        double buildMs = nowMs() - start;
+
+        // Touch points with the tolerances of a finger, in points
+        std::vector<float> points(kQueries * 2);
+        for (size_t i = 0; i < points.size(); i += 2) {
+            points[i] = 36 + nextUnit() * 540;
+            points[i + 1] = 36 + nextUnit() * 720;
+        }
+        const float tolerance = 4;
+
+        start = nowMs();
+        std::vector<int> gridHits(kQueries);
+        for (int q = 0; q < kQueries; q++) {
+            gridHits[q] = textGridCharAtPos(&index, points[q * 2], points[q * 2 + 1], tolerance,
+                                            tolerance);
+        }
+        double gridMs = nowMs() - start;
+
+        start = nowMs();
+        for (int q = 0; q < kQueries; q++) {
+            int hit = scanCharAtPos(index.boxes, points[q * 2], points[q * 2 + 1], tolerance,
+                                    tolerance);
+            if (hit != gridHits[q]) identical = false;
+        }
+        double scanMs = nowMs() - start;
+
+        // Selection rects, from a word to a few lines
+        double gridRectMs = 0, scanRectMs = 0;
+        for (int q = 0; q < kRectQueries; q++) {
+            float left = 36 + nextUnit() * 500, top = 60 + nextUnit() * 690;
+            float right = left + nextUnit() * 120, bottom = top - nextUnit() * 40;
+            std::vector<int> gridChars, scanChars;
+            start = nowMs();
+            textGridCharsInRect(&index, left, top, right, bottom, &gridChars);
+            gridRectMs += nowMs() - start;
+            start = nowMs();
+            scanCharsInRect(index.boxes, left, top, right, bottom, &scanChars);
+            scanRectMs += nowMs() - start;
+            if (gridChars != scanChars) identical = false;
+        }
+
+        printf("%s: %d chars, grid %dx%d built in %.2f ms\n", layouts[l].name, chars,
+               index.columns, index.rows, buildMs);
+        printf("  hit test   grid %.2f us, scan %.2f us per query\n",
+               gridMs * 1000 / kQueries, scanMs * 1000 / kQueries);
+        printf("  rect query grid %.2f us, scan %.2f us per query\n",
+               gridRectMs * 1000 / kRectQueries, scanRectMs * 1000 / kRectQueries);
+    }
+    printf("%s\n", identical ? "Grid matches the scan" : "Grid differs from the scan");
+    return identical ? 0 : 1;
+}
@@ -5,6 +5,9 @@
 #include <memory>
 #include <fstream>
 #include <map>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
 
 extern "C" {
 #include <stdlib.h>
@@ -28,10 +31,15 @@ extern "C" {
 
 extern "C" {
 #include <unistd.h>
+#include <fcntl.h>
+#include <wctype.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <string.h>
 #include <stdio.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
 #include <Mutex.h>
 #include <fpdfview.h>
 #include <fpdf_doc.h>
@@ -45,6 +53,9 @@ extern "C" {
 #include <android/native_window_jni.h>
 #include <android/bitmap.h>
 #include <fpdf_save.h>
+#include <PixelPipeline.h>
+#include <TextSpatialIndex.h>
+
 
 using namespace android;
 
@@ -82,17 +93,54 @@ struct rgb {
     uint8_t blue;
 };
 
+// Words, lines and blocks of a text page, see buildTextStructure. Each is stored as pairs of
+// first character index and index after the last character, in reading order.
+struct TextStructure {
+    std::vector<int> words;
+    std::vector<int> lines;
+    std::vector<int> blocks;
+
+    jlong bytes() const {
+        return (jlong) ((words.capacity() + lines.capacity() + blocks.capacity()) * sizeof(int));
+    }
+};
+
+// A text page cached by its document, see acquireTextPage
+struct TextPageEntry {
+    FPDF_TEXTPAGE textPage;
+    jlong bytes;
+    int pins;
+    unsigned long long lastUse;
+    TextSpatialIndex *index;
+    TextStructure *structure;
+};
+
 class DocumentFile {
 
 public:
     FPDF_DOCUMENT pdfDocument = NULL;
 
+    // Text pages by page index, loaded on first use and evicted least recently used first
+    std::map<int, TextPageEntry> textPages;
+    jlong textPagesBytes = 0;
+    jlong textPagesBudget = 8 * 1024 * 1024;
+    unsigned long long textPagesClock = 0;
+
     DocumentFile() { initLibraryIfNeed(); }
 
     ~DocumentFile();
 };
 
 DocumentFile::~DocumentFile() {
+    // Text pages are released with their page, this only catches those that were not
+    for (std::map<int, TextPageEntry>::iterator it = textPages.begin();
+         it != textPages.end(); ++it) {
+        delete it->second.index;
+        delete it->second.structure;
+        FPDFText_ClosePage(it->second.textPage);
+    }
+    textPages.clear();
+
     if (pdfDocument != NULL) {
         FPDF_CloseDocument(pdfDocument);
     }
@@ -177,6 +225,18 @@ void rgbBitmapTo565(void *source, int sourceStride, void *dest, AndroidBitmapInf
     }
 }
 
+// Pipelines come from PixelPipeline.stages, see PixelPipeline.h
+static bool readPixelPipeline(JNIEnv *env, jfloatArray stages, PixelPipeline *pipeline) {
+    pipeline->clear();
+    if (stages == NULL) return false;
+    jsize count = env->GetArrayLength(stages);
+    if (count == 0) return false;
+    std::vector<float> values(count);
+    env->GetFloatArrayRegion(stages, 0, count, values.data());
+    buildPixelPipeline(values.data(), count, pipeline);
+    return !pipeline->empty();
+}
+
 extern "C" {
 
 static constexpr char kContentsKey[] = "Contents";
@@ -431,6 +491,261 @@ JNI_FUNC(jobject, PdfiumCore, nativeGetPageSizeByIndex)(JNI_ARGS, jlong docPtr,
     return env->NewObject(clazz, constructorID, widthInt, heightInt);
 }
 
+/**
+ * Sizes of several pages in pixels, as width and height pairs in the order of pageIndexes.
+ * Pages are not loaded, their size comes from the (possibly inherited) MediaBox and rotation.
+ * Pages whose size cannot be read get 0x0.
+ */
+JNI_FUNC(jintArray, PdfiumCore, nativeGetPageSizes)(JNI_ARGS, jlong docPtr, jintArray pageIndexes,
+                                                   jint dpi) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (doc == NULL) {
+        LOGE("Document is null");
+
+        throwPdfiumException1(env, "Document is null");
+        return NULL;
+    }
+
+    jsize count = env->GetArrayLength(pageIndexes);
+    std::vector<jint> pages(count);
+    if (count > 0) env->GetIntArrayRegion(pageIndexes, 0, count, pages.data());
+
+    std::vector<jint> sizes(count * 2);
+    for (jsize i = 0; i < count; i++) {
+        double width, height;
+        if (!FPDF_GetPageSizeByIndex(doc->pdfDocument, pages[i], &width, &height)) {
+            width = 0;
+            height = 0;
+        }
+        sizes[i * 2] = (jint) (width * dpi / 72);
+        sizes[i * 2 + 1] = (jint) (height * dpi / 72);
+    }
+
+    jintArray result = env->NewIntArray(count * 2);
+    if (result == NULL) return NULL;
+    if (count > 0) env->SetIntArrayRegion(result, 0, count * 2, sizes.data());
+    return result;
+}
+
+// Objects covering this much of the page are backgrounds or scans, they say nothing of margins
+static const float kPageCoverRatio = 0.9f;
+// Space kept around content, as a fraction of the page
+static const float kCropPadding = 0.02f;
+// Crops keeping more than this fraction of the page area are not worth it
+static const float kMinCropGain = 0.95f;
+// Resolution of the pixel scan and the level below which a pixel counts as ink
+static const int kScanSize = 256;
+static const int kScanInkLevel = 160;
+// Device space used to express bounds as fractions of the page
+static const int kBoundsScale = 10000;
+
+// Grows bounds (left, top, right, bottom in page fractions) to include another box
+static void unionBounds(float *bounds, float left, float top, float right, float bottom) {
+    if (bounds[2] <= bounds[0] || bounds[3] <= bounds[1]) {
+        bounds[0] = left, bounds[1] = top, bounds[2] = right, bounds[3] = bottom;
+        return;
+    }
+    if (left < bounds[0]) bounds[0] = left;
+    if (top < bounds[1]) bounds[1] = top;
+    if (right > bounds[2]) bounds[2] = right;
+    if (bottom > bounds[3]) bounds[3] = bottom;
+}
+
+// Ink pixels per row and column of a low resolution render
+struct InkScan {
+    int width;
+    int height;
+    int inkPixels;
+    std::vector<int> rowInk;
+    std::vector<int> columnInk;
+};
+
+// Renders the page at a low resolution in grayscale and counts its ink pixels
+static bool scanInk(FPDF_PAGE page, InkScan *scan) {
+    float pageWidth = FPDF_GetPageWidthF(page);
+    float pageHeight = FPDF_GetPageHeightF(page);
+    if (pageWidth <= 0 || pageHeight <= 0) return false;
+    float scale = kScanSize / (pageWidth > pageHeight ? pageWidth : pageHeight);
+    int width = (int) (pageWidth * scale) > 0 ? (int) (pageWidth * scale) : 1;
+    int height = (int) (pageHeight * scale) > 0 ? (int) (pageHeight * scale) : 1;
+
+    FPDF_BITMAP bitmap = FPDFBitmap_Create(width, height, 0);
+    if (bitmap == NULL) return false;
+    FPDFBitmap_FillRect(bitmap, 0, 0, width, height, 0xFFFFFFFF);
+    FPDF_RenderPageBitmap(bitmap, page, 0, 0, width, height, 0, FPDF_GRAYSCALE);
+
+    const uint8_t *buffer = (const uint8_t *) FPDFBitmap_GetBuffer(bitmap);
+    int stride = FPDFBitmap_GetStride(bitmap);
+    scan->width = width;
+    scan->height = height;
+    scan->inkPixels = 0;
+    scan->rowInk.assign(height, 0);
+    scan->columnInk.assign(width, 0);
+    for (int y = 0; y < height; y++) {
+        const uint8_t *pixel = buffer + (size_t) y * stride;
+        for (int x = 0; x < width; x++, pixel += 4) {
+            // BGRx, the grayscale render makes every channel hold the level
+            if (pixel[1] < kScanInkLevel) {
+                scan->rowInk[y]++;
+                scan->columnInk[x]++;
+                scan->inkPixels++;
+            }
+        }
+    }
+    FPDFBitmap_Destroy(bitmap);
+    return true;
+}
+
+/**
+ * Renders the page at a low resolution and adds the box of its ink pixels to bounds. Rows and
+ * columns need two ink pixels, which skips isolated specks of scanner noise.
+ */
+static void scanInkBounds(FPDF_PAGE page, float *bounds) {
+    InkScan scan;
+    if (!scanInk(page, &scan)) return;
+    int width = scan.width, height = scan.height;
+    const std::vector<int> &rowInk = scan.rowInk, &columnInk = scan.columnInk;
+
+    int top = 0, bottom = height - 1, left = 0, right = width - 1;
+    while (top < height && rowInk[top] < 2) top++;
+    while (bottom > top && rowInk[bottom] < 2) bottom--;
+    while (left < width && columnInk[left] < 2) left++;
+    while (right > left && columnInk[right] < 2) right--;
+    if (top >= height || left >= width) return;
+    unionBounds(bounds, (float) left / width, (float) top / height,
+                (float) (right + 1) / width, (float) (bottom + 1) / height);
+}
+
+/**
+ * Content bounds of a page as fractions of its displayed (rotated) size: left, top, right and
+ * bottom. Text, paths and small images are measured by their object bounds. A page covered by
+ * an image or a form is scanned for ink when scanImages is set and left uncropped otherwise.
+ * Returns false when the page should not be cropped.
+ */
+static bool getPageContentBounds(FPDF_PAGE page, bool scanImages, float *out) {
+    FS_RECTF pageBox;
+    if (!FPDF_GetPageBoundingBox(page, &pageBox)) return false;
+    float pageArea = (pageBox.right - pageBox.left) * (pageBox.top - pageBox.bottom);
+    if (pageArea <= 0) return false;
+
+    float bounds[4] = {0, 0, 0, 0};
+    bool needsScan = false;
+    int count = FPDFPage_CountObjects(page);
+    for (int i = 0; i < count; i++) {
+        FPDF_PAGEOBJECT object = FPDFPage_GetObject(page, i);
+        float left, bottom, right, top;
+        if (object == NULL || !FPDFPageObj_GetBounds(object, &left, &bottom, &right, &top)) {
+            continue;
+        }
+        if (left < pageBox.left) left = pageBox.left;
+        if (right > pageBox.right) right = pageBox.right;
+        if (bottom < pageBox.bottom) bottom = pageBox.bottom;
+        if (top > pageBox.top) top = pageBox.top;
+        if (right <= left || top <= bottom) continue;
+
+        if ((right - left) * (top - bottom) >= pageArea * kPageCoverRatio) {
+            // A page sized path is a background, an image or a form may hold content anywhere
+            if (FPDFPageObj_GetType(object) != FPDF_PAGEOBJ_PATH) needsScan = true;
+            continue;
+        }
+
+        // Page space has y going up, the corners are mapped to the displayed orientation
+        int x1, y1, x2, y2;
+        FPDF_PageToDevice(page, 0, 0, kBoundsScale, kBoundsScale, 0, left, top, &x1, &y1);
+        FPDF_PageToDevice(page, 0, 0, kBoundsScale, kBoundsScale, 0, right, bottom, &x2, &y2);
+        unionBounds(bounds,
+                    (float) (x1 < x2 ? x1 : x2) / kBoundsScale,
+                    (float) (y1 < y2 ? y1 : y2) / kBoundsScale,
+                    (float) (x1 < x2 ? x2 : x1) / kBoundsScale,
+                    (float) (y1 < y2 ? y2 : y1) / kBoundsScale);
+    }
+
+    if (needsScan) {
+        if (!scanImages) return false;
+        scanInkBounds(page, bounds);
+    }
+    // Blank pages keep their full size
+    if (bounds[2] <= bounds[0] || bounds[3] <= bounds[1]) return false;
+
+    out[0] = bounds[0] - kCropPadding > 0 ? bounds[0] - kCropPadding : 0;
+    out[1] = bounds[1] - kCropPadding > 0 ? bounds[1] - kCropPadding : 0;
+    out[2] = bounds[2] + kCropPadding < 1 ? bounds[2] + kCropPadding : 1;
+    out[3] = bounds[3] + kCropPadding < 1 ? bounds[3] + kCropPadding : 1;
+    return (out[2] - out[0]) * (out[3] - out[1]) < kMinCropGain;
+}
+
+/**
+ * Content bounds of several pages, see getPageContentBounds. Four floats per page in the order
+ * of pageIndexes, 0, 0, 1, 1 for pages that are not cropped. Pages are loaded and closed here.
+ */
+JNI_FUNC(jfloatArray, PdfiumCore, nativeGetPageContentBounds)(JNI_ARGS, jlong docPtr,
+                                                              jintArray pageIndexes,
+                                                              jboolean scanImages) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (doc == NULL) {
+        LOGE("Document is null");
+
+        throwPdfiumException1(env, "Document is null");
+        return NULL;
+    }
+
+    jsize count = env->GetArrayLength(pageIndexes);
+    std::vector<jint> pages(count);
+    if (count > 0) env->GetIntArrayRegion(pageIndexes, 0, count, pages.data());
+
+    std::vector<jfloat> bounds(count * 4);
+    for (jsize i = 0; i < count; i++) {
+        float *out = &bounds[i * 4];
+        FPDF_PAGE page = FPDF_LoadPage(doc->pdfDocument, pages[i]);
+        if (page == NULL || !getPageContentBounds(page, scanImages, out)) {
+            out[0] = 0, out[1] = 0, out[2] = 1, out[3] = 1;
+        }
+        if (page != NULL) FPDF_ClosePage(page);
+    }
+
+    jfloatArray result = env->NewFloatArray(count * 4);
+    if (result == NULL) return NULL;
+    if (count > 0) env->SetFloatArrayRegion(result, 0, count * 4, bounds.data());
+    return result;
+}
+
+// Share of ink pixels under which a raster page still counts as blank, scanner dust and specks
+static const float kBlankInkRatio = 0.0005f;
+
+/**
+ * A page is blank when it has nothing to draw: no objects, or no text and no visible ink in a low
+ * resolution render of its images, forms and paths. Annotations count as content when they are
+ * rendered.
+ */
+static bool isBlankPage(FPDF_PAGE page, bool renderAnnot) {
+    if (renderAnnot && FPDFPage_GetAnnotCount(page) > 0) return false;
+
+    bool needsScan = false;
+    int count = FPDFPage_CountObjects(page);
+    for (int i = 0; i < count; i++) {
+        FPDF_PAGEOBJECT object = FPDFPage_GetObject(page, i);
+        if (object == NULL) continue;
+        // Text is content even when it is white or clipped, a scan does not change that
+        if (FPDFPageObj_GetType(object) == FPDF_PAGEOBJ_TEXT) return false;
+        needsScan = true;
+    }
+    if (!needsScan) return true;
+
+    InkScan scan;
+    if (!scanInk(page, &scan)) return false;
+    return scan.inkPixels <= scan.width * scan.height * kBlankInkRatio;
+}
+
+/**
+ * Whether an opened page is blank, see isBlankPage. Uses the parsed page of the viewer, so the
+ * check does not load the page a second time.
+ */
+JNI_FUNC(jboolean, PdfiumCore, nativeIsPageBlank)(JNI_ARGS, jlong pagePtr, jboolean renderAnnot) {
+    FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    if (page == NULL) return JNI_FALSE;
+    return isBlankPage(page, renderAnnot) ? JNI_TRUE : JNI_FALSE;
+}
+
 static void renderPageInternal(FPDF_PAGE page,
                                ANativeWindow_Buffer *windowBuffer,
                                int startX, int startY,
@@ -501,10 +816,15 @@ JNI_FUNC(void, PdfiumCore, nativeRenderPage)(JNI_ARGS, jlong pagePtr, jobject ob
     ANativeWindow_release(nativeWindow);
 }
 
+// Intermediate BGR buffer of RGB_565 renders. Tiles mostly share a few sizes, so the buffer is
+// kept per rendering thread and only grows instead of being allocated for every tile.
+static thread_local std::vector<rgb> sRgbScratch;
+
 JNI_FUNC(void, PdfiumCore, nativeRenderPageBitmap)(JNI_ARGS, jlong pagePtr, jobject bitmap,
                                                    jint startX, jint startY,
                                                    jint drawSizeHor, jint drawSizeVer,
-                                                   jboolean renderAnnot) {
+                                                   jboolean renderAnnot, jboolean draft,
+                                                   jboolean clear, jfloatArray pipelineStages) {
     try {
         FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
 
@@ -529,6 +849,9 @@ JNI_FUNC(void, PdfiumCore, nativeRenderPageBitmap)(JNI_ARGS, jlong pagePtr, jobj
             return;
         }
 
+        PixelPipeline pipeline;
+        bool hasPipeline = readPixelPipeline(env, pipelineStages, &pipeline);
+
         void *addr;
         if ((ret = AndroidBitmap_lockPixels(env, bitmap, &addr)) != 0) {
             LOGE("Locking bitmap failed: %s", strerror(ret * -1));
@@ -539,7 +862,9 @@ JNI_FUNC(void, PdfiumCore, nativeRenderPageBitmap)(JNI_ARGS, jlong pagePtr, jobj
         int format;
         int sourceStride;
         if (info.format == ANDROID_BITMAP_FORMAT_RGB_565) {
-            tmp = malloc(canvasVerSize * canvasHorSize * sizeof(rgb));
+            size_t pixelCount = (size_t) canvasVerSize * canvasHorSize;
+            if (sRgbScratch.size() < pixelCount) sRgbScratch.resize(pixelCount);
+            tmp = sRgbScratch.data();
             sourceStride = canvasHorSize * sizeof(rgb);
             format = FPDFBitmap_BGR;
         } else {
@@ -554,6 +879,10 @@ JNI_FUNC(void, PdfiumCore, nativeRenderPageBitmap)(JNI_ARGS, jlong pagePtr, jobj
         if (drawSizeHor < canvasHorSize || drawSizeVer < canvasVerSize) {
             FPDFBitmap_FillRect(pdfBitmap, 0, 0, canvasHorSize, canvasVerSize,
                                 0x848484FF); //Gray
+        } else if (clear && info.format == ANDROID_BITMAP_FORMAT_RGBA_8888) {
+            // Reused bitmaps still hold the previous tile, transparent areas must not show it
+            FPDFBitmap_FillRect(pdfBitmap, 0, 0, canvasHorSize, canvasVerSize,
+                                0x00000000); //Transparent
         }
 
         int baseHorSize = (canvasHorSize < drawSizeHor) ? canvasHorSize : (int) drawSizeHor;
@@ -566,6 +895,13 @@ JNI_FUNC(void, PdfiumCore, nativeRenderPageBitmap)(JNI_ARGS, jlong pagePtr, jobj
             flags |= FPDF_ANNOT;
         }
 
+        // Draft renders trade anti-aliasing and the image cache for speed, they are
+        // replaced by a full quality render once the view settles.
+        if (draft) {
+            flags |= FPDF_RENDER_NO_SMOOTHTEXT | FPDF_RENDER_NO_SMOOTHIMAGE |
+                     FPDF_RENDER_NO_SMOOTHPATH | FPDF_RENDER_LIMITEDIMAGECACHE;
+        }
+
         if (info.format == ANDROID_BITMAP_FORMAT_RGB_565) {
             FPDFBitmap_FillRect(pdfBitmap, baseX, baseY, baseHorSize, baseVerSize,
                                 0xFFFFFFFF); //White
@@ -576,11 +912,16 @@ JNI_FUNC(void, PdfiumCore, nativeRenderPageBitmap)(JNI_ARGS, jlong pagePtr, jobj
                               (int) drawSizeHor, (int) drawSizeVer,
                               0, flags);
 
+        if (hasPipeline) {
+            runPixelPipeline(pipeline, tmp, canvasHorSize, canvasVerSize, sourceStride,
+                             info.format == ANDROID_BITMAP_FORMAT_RGB_565 ? sizeof(rgb) : 4);
+        }
+
         if (info.format == ANDROID_BITMAP_FORMAT_RGB_565) {
             rgbBitmapTo565(tmp, sourceStride, addr, &info);
-            free(tmp);
         }
 
+        FPDFBitmap_Destroy(pdfBitmap);
         AndroidBitmap_unlockPixels(env, bitmap);
     } catch (const char *msg) {
         LOGE("%s", msg);
@@ -589,6 +930,46 @@ JNI_FUNC(void, PdfiumCore, nativeRenderPageBitmap)(JNI_ARGS, jlong pagePtr, jobj
     }
 }
 
+/**
+ * Runs a pixel pipeline over ARGB colours with the kernels used for rendering, so that the view
+ * can paint the areas around pages in the same colours as the rendered pages.
+ */
+JNI_FUNC(jintArray, PdfiumCore, nativeApplyPixelPipeline)(JNI_ARGS, jfloatArray pipelineStages,
+                                                          jintArray colors) {
+    jsize count = env->GetArrayLength(colors);
+    std::vector<jint> values(count);
+    if (count > 0) env->GetIntArrayRegion(colors, 0, count, values.data());
+
+    PixelPipeline pipeline;
+    if (readPixelPipeline(env, pipelineStages, &pipeline)) {
+        std::vector<uint8_t> pixels(count * 4);
+        for (jsize i = 0; i < count; i++) {
+            uint32_t color = (uint32_t) values[i];
+            uint32_t alpha = color >> 24;
+            pixels[i * 4] = (uint8_t) (((color >> 16) & 0xFF) * alpha / 255);
+            pixels[i * 4 + 1] = (uint8_t) (((color >> 8) & 0xFF) * alpha / 255);
+            pixels[i * 4 + 2] = (uint8_t) ((color & 0xFF) * alpha / 255);
+            pixels[i * 4 + 3] = (uint8_t) alpha;
+        }
+        runPixelPipeline(pipeline, pixels.data(), count, 1, count * 4, 4);
+        for (jsize i = 0; i < count; i++) {
+            uint32_t alpha = pixels[i * 4 + 3];
+            uint32_t color = alpha << 24;
+            if (alpha != 0) {
+                color |= (pixels[i * 4] * 255 / alpha) << 16;
+                color |= (pixels[i * 4 + 1] * 255 / alpha) << 8;
+                color |= pixels[i * 4 + 2] * 255 / alpha;
+            }
+            values[i] = (jint) color;
+        }
+    }
+
+    jintArray result = env->NewIntArray(count);
+    if (result == NULL) return NULL;
+    if (count > 0) env->SetIntArrayRegion(result, 0, count, values.data());
+    return result;
+}
+
 JNI_FUNC(jstring, PdfiumCore, nativeGetDocumentMetaText)(JNI_ARGS, jlong docPtr, jstring tag) {
     const char *ctag = env->GetStringUTFChars(tag, NULL);
     if (ctag == NULL) {
@@ -714,6 +1095,140 @@ JNI_FUNC(jobject, PdfiumCore, nativeGetLinkRect)(JNI_ARGS, jlong linkPtr) {
                           fsRectF.bottom);
 }
 
+// Destination page of a link, from its destination or its GoTo action, or -1
+static int getLinkDestPageIndex(FPDF_DOCUMENT document, FPDF_LINK link, FPDF_ACTION action) {
+    FPDF_DEST dest = FPDFLink_GetDest(document, link);
+    if (dest == NULL && action != NULL && FPDFAction_GetType(action) == PDFACTION_GOTO) {
+        dest = FPDFAction_GetDest(document, action);
+    }
+    return dest == NULL ? -1 : FPDFDest_GetDestPageIndex(document, dest);
+}
+
+static bool linkRectsOverlap(const std::vector<jfloat> &rects, size_t count, const float *rect) {
+    for (size_t i = 0; i < count; i++) {
+        const jfloat *other = &rects[i * 4];
+        if (rect[0] < other[2] && rect[2] > other[0] && rect[3] < other[1] && rect[1] > other[3]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Returns the links of a page in a single call as {float[] rects, int[] destPageIndexes,
+// String[] uris}, one entry per link. Rects are left, top, right, bottom in page coordinates,
+// the destination is -1 and the uri null when the link has none. With webLinks set, URLs
+// written as plain text are added too with a destination of -2, one entry per line they cover,
+// except where an annotation link already covers them.
+JNI_FUNC(jobjectArray, PdfiumCore, nativeGetPageLinkTable)(JNI_ARGS, jlong docPtr, jint pageIndex,
+                                                          jlong pagePtr, jboolean webLinks) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    if (doc == NULL || doc->pdfDocument == NULL || page == NULL) return NULL;
+
+    // Strings are only created at the end, a link dense page would exhaust the local references
+    std::vector<jfloat> rects;
+    std::vector<jint> destinations;
+    std::vector<int> uriIndexes;
+    std::vector<std::vector<jchar> > uris;
+
+    int pos = 0;
+    FPDF_LINK link;
+    while (FPDFLink_Enumerate(page, &pos, &link)) {
+        FS_RECTF rect;
+        if (!FPDFLink_GetAnnotRect(link, &rect)) continue;
+        FPDF_ACTION action = FPDFLink_GetAction(link);
+        int destination = getLinkDestPageIndex(doc->pdfDocument, link, action);
+
+        // Like nativeGetLinkURI, links with an action but no URI get an empty one
+        int uriIndex = -1;
+        if (action != NULL) {
+            unsigned long length = FPDFAction_GetURIPath(doc->pdfDocument, action, NULL, 0);
+            std::string path;
+            if (length > 0) {
+                FPDFAction_GetURIPath(doc->pdfDocument, action, WriteInto(&path, length), length);
+            }
+            // URI paths are 7-bit ASCII
+            uriIndex = (int) uris.size();
+            uris.push_back(std::vector<jchar>(path.begin(), path.end()));
+        }
+        if (destination < 0 && uriIndex < 0) continue;
+
+        rects.push_back(rect.left);
+        rects.push_back(rect.top);
+        rects.push_back(rect.right);
+        rects.push_back(rect.bottom);
+        destinations.push_back(destination);
+        uriIndexes.push_back(uriIndex);
+    }
+
+    if (webLinks) {
+        std::map<int, TextPageEntry>::iterator cached = doc->textPages.find((int) pageIndex);
+        FPDF_TEXTPAGE textPage = cached != doc->textPages.end() ? cached->second.textPage
+                                                               : FPDFText_LoadPage(page);
+        FPDF_PAGELINK pageLinks = textPage != NULL ? FPDFLink_LoadWebLinks(textPage) : NULL;
+        size_t annotationLinks = destinations.size();
+        int count = pageLinks != NULL ? FPDFLink_CountWebLinks(pageLinks) : 0;
+        std::vector<unsigned short> url;
+        for (int i = 0; i < count; i++) {
+            int length = FPDFLink_GetURL(pageLinks, i, NULL, 0);
+            if (length <= 1) continue;
+            url.assign((size_t) length, 0);
+            FPDFLink_GetURL(pageLinks, i, url.data(), length);
+
+            int uriIndex = -1;
+            int rectCount = FPDFLink_CountRects(pageLinks, i);
+            for (int r = 0; r < rectCount; r++) {
+                double left = 0, top = 0, right = 0, bottom = 0;
+                if (!FPDFLink_GetRect(pageLinks, i, r, &left, &top, &right, &bottom)) continue;
+                float rect[4] = {(float) left, (float) top, (float) right, (float) bottom};
+                if (linkRectsOverlap(rects, annotationLinks, rect)) continue;
+                // The terminating NUL is counted in length
+                if (uriIndex < 0) {
+                    uriIndex = (int) uris.size();
+                    uris.push_back(std::vector<jchar>(url.begin(), url.begin() + length - 1));
+                }
+                rects.insert(rects.end(), rect, rect + 4);
+                destinations.push_back(-2);
+                uriIndexes.push_back(uriIndex);
+            }
+        }
+        if (pageLinks != NULL) FPDFLink_CloseWebLinks(pageLinks);
+        if (textPage != NULL && cached == doc->textPages.end()) FPDFText_ClosePage(textPage);
+    }
+
+    jclass objectClass = env->FindClass("java/lang/Object");
+    jclass stringClass = env->FindClass("java/lang/String");
+    jobjectArray result = env->NewObjectArray(3, objectClass, NULL);
+    jfloatArray javaRects = env->NewFloatArray((jsize) rects.size());
+    jintArray javaDestinations = env->NewIntArray((jsize) destinations.size());
+    jobjectArray javaUris = env->NewObjectArray((jsize) uriIndexes.size(), stringClass, NULL);
+    if (result == NULL || javaRects == NULL || javaDestinations == NULL || javaUris == NULL) {
+        return NULL;
+    }
+
+    env->SetFloatArrayRegion(javaRects, 0, (jsize) rects.size(), rects.data());
+    env->SetIntArrayRegion(javaDestinations, 0, (jsize) destinations.size(), destinations.data());
+    // Links sharing a URI are adjacent, each string is created once
+    int stringIndex = -1;
+    jstring string = NULL;
+    for (size_t i = 0; i < uriIndexes.size(); i++) {
+        if (uriIndexes[i] < 0) continue;
+        if (uriIndexes[i] != stringIndex) {
+            if (string != NULL) env->DeleteLocalRef(string);
+            stringIndex = uriIndexes[i];
+            const std::vector<jchar> &uri = uris[stringIndex];
+            string = env->NewString(uri.empty() ? NULL : uri.data(), (jsize) uri.size());
+            if (string == NULL) return NULL;
+        }
+        env->SetObjectArrayElement(javaUris, (jsize) i, string);
+    }
+    if (string != NULL) env->DeleteLocalRef(string);
+    env->SetObjectArrayElement(result, 0, javaRects);
+    env->SetObjectArrayElement(result, 1, javaDestinations);
+    env->SetObjectArrayElement(result, 2, javaUris);
+    return result;
+}
+
 JNI_FUNC(jobject, PdfiumCore, nativePageCoordinateToDevice)(JNI_ARGS, jlong pagePtr, jint startX,
                                                             jint startY, jint sizeX,
                                                             jint sizeY, jint rotate, jdouble pageX,
@@ -747,6 +1262,86 @@ JNI_FUNC(jint, PdfiumCore, nativeGetPageRotation)(JNI_ARGS, jlong pagePtr) {
     return (jint) FPDFPage_GetRotation(page);
 }
 
+// pdfium does not report its allocations, these are rough costs of a parsed text page. Parsed
+// pages are estimated from their complexity, see PageComplexity.memoryEstimate.
+static const jlong kPageBaseBytes = 16 * 1024;
+static const jlong kTextCharBytes = 96;
+static const int kMaxFormDepth = 8;
+
+// Fields of a page complexity profile, in the order of the PageComplexity constructor
+enum {
+    COMPLEXITY_TEXT_OBJECTS,
+    COMPLEXITY_PATH_OBJECTS,
+    COMPLEXITY_IMAGE_OBJECTS,
+    COMPLEXITY_SHADING_OBJECTS,
+    COMPLEXITY_FORM_OBJECTS,
+    COMPLEXITY_PATH_SEGMENTS,
+    COMPLEXITY_IMAGE_PIXELS,
+    COMPLEXITY_TRANSPARENT_OBJECTS,
+    COMPLEXITY_FIELD_COUNT
+};
+
+static void profileObject(FPDF_PAGEOBJECT object, int depth, jlong *profile) {
+    // Transparent objects are composited through an offscreen group when rendered
+    if (FPDFPageObj_HasTransparency(object)) profile[COMPLEXITY_TRANSPARENT_OBJECTS]++;
+    switch (FPDFPageObj_GetType(object)) {
+        case FPDF_PAGEOBJ_TEXT:
+            profile[COMPLEXITY_TEXT_OBJECTS]++;
+            break;
+        case FPDF_PAGEOBJ_PATH: {
+            profile[COMPLEXITY_PATH_OBJECTS]++;
+            int segments = FPDFPath_CountSegments(object);
+            if (segments > 0) profile[COMPLEXITY_PATH_SEGMENTS] += segments;
+            break;
+        }
+        case FPDF_PAGEOBJ_IMAGE: {
+            profile[COMPLEXITY_IMAGE_OBJECTS]++;
+            unsigned int width = 0, height = 0;
+            if (FPDFImageObj_GetImagePixelSize(object, &width, &height)) {
+                profile[COMPLEXITY_IMAGE_PIXELS] += (jlong) width * height;
+            }
+            break;
+        }
+        case FPDF_PAGEOBJ_SHADING:
+            profile[COMPLEXITY_SHADING_OBJECTS]++;
+            break;
+        case FPDF_PAGEOBJ_FORM: {
+            profile[COMPLEXITY_FORM_OBJECTS]++;
+            if (depth >= kMaxFormDepth) break;
+            int count = FPDFFormObj_CountObjects(object);
+            for (int i = 0; i < count; i++) {
+                FPDF_PAGEOBJECT child = FPDFFormObj_GetObject(object, i);
+                if (child != NULL) profileObject(child, depth + 1, profile);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/**
+ * Counts what an opened page draws, walking its objects and those of its forms without rendering
+ * it. Returns the COMPLEXITY_ fields, which both the render cost and the memory estimate of the
+ * page are derived from.
+ */
+JNI_FUNC(jlongArray, PdfiumCore, nativeGetPageComplexity)(JNI_ARGS, jlong pagePtr) {
+    FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    jlong profile[COMPLEXITY_FIELD_COUNT] = {0};
+    if (page != NULL) {
+        int count = FPDFPage_CountObjects(page);
+        for (int i = 0; i < count; i++) {
+            FPDF_PAGEOBJECT object = FPDFPage_GetObject(page, i);
+            if (object != NULL) profileObject(object, 0, profile);
+        }
+    }
+
+    jlongArray result = env->NewLongArray(COMPLEXITY_FIELD_COUNT);
+    if (result == NULL) return NULL;
+    env->SetLongArrayRegion(result, 0, COMPLEXITY_FIELD_COUNT, profile);
+    return result;
+}
+
 
 //////////////////////////////////////////
 // Begin PDF TextPage api
@@ -775,18 +1370,102 @@ static jlong loadTextPageInternal(JNIEnv *env, FPDF_PAGE page) {
     }
 }
 
-static void closeTextPageInternal(jlong textPagePtr) {
-    FPDFText_ClosePage(reinterpret_cast<FPDF_TEXTPAGE>(textPagePtr));
+static void releaseTextPage(DocumentFile *doc, int pageIndex) {
+    std::map<int, TextPageEntry>::iterator it = doc->textPages.find(pageIndex);
+    if (it == doc->textPages.end()) return;
+    delete it->second.index;
+    delete it->second.structure;
+    FPDFText_ClosePage(it->second.textPage);
+    doc->textPagesBytes -= it->second.bytes;
+    doc->textPages.erase(it);
+}
+
+// Evicts unpinned text pages, least recently used first, until the cache fits its budget.
+// The page given in keepIndex is never evicted.
+static void trimTextPages(DocumentFile *doc, int keepIndex) {
+    while (doc->textPagesBytes > doc->textPagesBudget) {
+        std::map<int, TextPageEntry>::iterator victim = doc->textPages.end();
+        for (std::map<int, TextPageEntry>::iterator it = doc->textPages.begin();
+             it != doc->textPages.end(); ++it) {
+            if (it->first == keepIndex || it->second.pins > 0) continue;
+            if (victim == doc->textPages.end() || it->second.lastUse < victim->second.lastUse) {
+                victim = it;
+            }
+        }
+        if (victim == doc->textPages.end()) return;
+        releaseTextPage(doc, victim->first);
+    }
 }
 
-JNI_FUNC(jlong, PdfiumCore, nativeLoadTextPage)(JNI_ARGS, jlong docPtr, jlong pagePtr) {
-    // docPtr is kept for potential context but not directly used by loadTextPageInternal now
+// Returns the cached text page of pageIndex, running the text layout of page on first use.
+// The returned text page stays valid until another page is acquired, unless it is pinned.
+static jlong acquireTextPage(JNIEnv *env, DocumentFile *doc, int pageIndex, FPDF_PAGE page) {
+    std::map<int, TextPageEntry>::iterator it = doc->textPages.find(pageIndex);
+    if (it != doc->textPages.end()) {
+        it->second.lastUse = ++doc->textPagesClock;
+        return reinterpret_cast<jlong>(it->second.textPage);
+    }
+
+    jlong textPagePtr = loadTextPageInternal(env, page);
+    if (textPagePtr == -1) return -1;
+
+    FPDF_TEXTPAGE textPage = reinterpret_cast<FPDF_TEXTPAGE>(textPagePtr);
+    TextPageEntry entry;
+    entry.textPage = textPage;
+    entry.bytes = kPageBaseBytes + (jlong) FPDFText_CountChars(textPage) * kTextCharBytes;
+    entry.pins = 0;
+    entry.lastUse = ++doc->textPagesClock;
+    entry.index = NULL;
+    entry.structure = NULL;
+    doc->textPages[pageIndex] = entry;
+    doc->textPagesBytes += entry.bytes;
+    trimTextPages(doc, pageIndex);
+    return textPagePtr;
+}
+
+JNI_FUNC(jlong, PdfiumCore, nativeLoadTextPage)(JNI_ARGS, jlong docPtr, jint pageIndex,
+                                                jlong pagePtr) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile *>(docPtr);
     FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
-    return loadTextPageInternal(env, page);
+    if (doc == NULL) return loadTextPageInternal(env, page);
+    return acquireTextPage(env, doc, (int) pageIndex, page);
 }
 
-JNI_FUNC(jlongArray, PdfiumCore, nativeLoadTextPages)(JNI_ARGS, jlong docPtr, jlongArray pagePtrs) {
-    // docPtr is kept for potential context
+JNI_FUNC(jboolean, PdfiumCore, nativeHasTextPage)(JNI_ARGS, jlong docPtr, jint pageIndex) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (doc == NULL) return JNI_FALSE;
+    return doc->textPages.count((int) pageIndex) > 0 ? JNI_TRUE : JNI_FALSE;
+}
+
+JNI_FUNC(void, PdfiumCore, nativePinTextPage)(JNI_ARGS, jlong docPtr, jint pageIndex,
+                                              jboolean pin) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (doc == NULL) return;
+    std::map<int, TextPageEntry>::iterator it = doc->textPages.find((int) pageIndex);
+    if (it == doc->textPages.end()) return;
+    if (pin) {
+        it->second.pins++;
+    } else if (it->second.pins > 0) {
+        it->second.pins--;
+        trimTextPages(doc, -1);
+    }
+}
+
+JNI_FUNC(void, PdfiumCore, nativeSetTextPageBudget)(JNI_ARGS, jlong docPtr, jlong budgetBytes) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (doc == NULL) return;
+    doc->textPagesBudget = budgetBytes;
+    trimTextPages(doc, -1);
+}
+
+JNI_FUNC(jlong, PdfiumCore, nativeGetTextPagesBytes)(JNI_ARGS, jlong docPtr) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    return doc == NULL ? 0 : doc->textPagesBytes;
+}
+
+JNI_FUNC(jlongArray, PdfiumCore, nativeLoadTextPages)(JNI_ARGS, jlong docPtr, jint fromIndex,
+                                                      jlongArray pagePtrs) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile *>(docPtr);
     if (pagePtrs == NULL) {
         LOGE("pagePtrs array is null");
         return NULL;
@@ -804,12 +1483,23 @@ JNI_FUNC(jlongArray, PdfiumCore, nativeLoadTextPages)(JNI_ARGS, jlong docPtr, jl
         return NULL; // Or throw exception
     }
 
+    // Pages of the range are pinned while loading so that a range larger than the budget does
+    // not evict its own first pages, the budget is enforced again on the next acquisition.
     std::vector<jlong> textPagesResult(numPages);
     for (jsize i = 0; i < numPages; ++i) {
         FPDF_PAGE currentPage = reinterpret_cast<FPDF_PAGE>(nativePagePtrs[i]);
-        textPagesResult[i] = loadTextPageInternal(env, currentPage);
+        if (doc == NULL) {
+            textPagesResult[i] = loadTextPageInternal(env, currentPage);
+            continue;
+        }
+        textPagesResult[i] = acquireTextPage(env, doc, fromIndex + i, currentPage);
+        if (textPagesResult[i] != -1) doc->textPages[fromIndex + i].pins++;
         // Optionally, check for -1 and handle error (e.g., stop and return partially filled array or throw)
     }
+    for (jsize i = 0; doc != NULL && i < numPages; ++i) {
+        std::map<int, TextPageEntry>::iterator it = doc->textPages.find(fromIndex + i);
+        if (it != doc->textPages.end() && textPagesResult[i] != -1) it->second.pins--;
+    }
 
     env->ReleaseLongArrayElements(pagePtrs, nativePagePtrs,
                                   JNI_ABORT); // Use JNI_ABORT as we just read
@@ -824,16 +1514,16 @@ JNI_FUNC(jlongArray, PdfiumCore, nativeLoadTextPages)(JNI_ARGS, jlong docPtr, jl
     return javaTextPages;
 }
 
-JNI_FUNC(void, PdfiumCore, nativeCloseTextPage)(JNI_ARGS, jlong textPagePtr) {
-    closeTextPageInternal(textPagePtr);
+JNI_FUNC(void, PdfiumCore, nativeCloseTextPage)(JNI_ARGS, jlong docPtr, jint pageIndex) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (doc != NULL) releaseTextPage(doc, (int) pageIndex);
 }
 
-JNI_FUNC(void, PdfiumCore, nativeCloseTextPages)(JNI_ARGS, jlongArray textPagesPtr) {
-    int length = (int) (env->GetArrayLength(textPagesPtr));
-    jlong *textPages = env->GetLongArrayElements(textPagesPtr, NULL);
-
-    int i;
-    for (i = 0; i < length; i++) { closeTextPageInternal(textPages[i]); }
+JNI_FUNC(void, PdfiumCore, nativeCloseTextPages)(JNI_ARGS, jlong docPtr, jint fromIndex,
+                                                 jint toIndex) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (doc == NULL) return;
+    for (int i = fromIndex; i <= toIndex; i++) releaseTextPage(doc, i);
 }
 
 JNI_FUNC(jint, PdfiumCore, nativeTextCountChars)(JNI_ARGS, jlong textPagePtr) {
@@ -866,6 +1556,331 @@ JNI_FUNC(jint, PdfiumCore, nativeTextGetCharIndexAtPos)(JNI_ARGS, jlong textPage
                                              (double) yTolerance);
 }
 
+// Glyph table layout, must match com.harissk.pdfium.text.GlyphTable. Every field is an array of
+// `count` 4 byte values in native byte order, stored one after the other.
+enum GlyphTableField {
+    kGlyphUnicode = 0,      // int32
+    kGlyphLooseLeft,        // float, PDF user space
+    kGlyphLooseTop,
+    kGlyphLooseRight,
+    kGlyphLooseBottom,
+    kGlyphLeft,             // float, tight box
+    kGlyphTop,
+    kGlyphRight,
+    kGlyphBottom,
+    kGlyphOriginX,          // float
+    kGlyphOriginY,
+    kGlyphFontSize,         // float, points
+    kGlyphFontWeight,       // int32, -1 if unknown
+    kGlyphFieldCount
+};
+
+JNI_FUNC(jint, PdfiumCore, nativeGetGlyphTable)(JNI_ARGS, jlong textPagePtr, jobject buffer) {
+    FPDF_TEXTPAGE textPage = reinterpret_cast<FPDF_TEXTPAGE>(textPagePtr);
+    if (textPage == NULL || buffer == NULL) return -1;
+
+    int count = FPDFText_CountChars(textPage);
+    if (count <= 0) return 0;
+
+    void *address = env->GetDirectBufferAddress(buffer);
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if (address == NULL || capacity < (jlong) count * kGlyphFieldCount * 4) return -1;
+
+    int32_t *ints = reinterpret_cast<int32_t *>(address);
+    float *floats = reinterpret_cast<float *>(address);
+#define GLYPH_FIELD(base, field) ((base) + (size_t) (field) * count)
+    int32_t *unicode = GLYPH_FIELD(ints, kGlyphUnicode);
+    float *looseLeft = GLYPH_FIELD(floats, kGlyphLooseLeft);
+    float *looseTop = GLYPH_FIELD(floats, kGlyphLooseTop);
+    float *looseRight = GLYPH_FIELD(floats, kGlyphLooseRight);
+    float *looseBottom = GLYPH_FIELD(floats, kGlyphLooseBottom);
+    float *left = GLYPH_FIELD(floats, kGlyphLeft);
+    float *top = GLYPH_FIELD(floats, kGlyphTop);
+    float *right = GLYPH_FIELD(floats, kGlyphRight);
+    float *bottom = GLYPH_FIELD(floats, kGlyphBottom);
+    float *originX = GLYPH_FIELD(floats, kGlyphOriginX);
+    float *originY = GLYPH_FIELD(floats, kGlyphOriginY);
+    float *fontSize = GLYPH_FIELD(floats, kGlyphFontSize);
+    int32_t *fontWeight = GLYPH_FIELD(ints, kGlyphFontWeight);
+#undef GLYPH_FIELD
+
+    for (int i = 0; i < count; i++) {
+        unicode[i] = (int32_t) FPDFText_GetUnicode(textPage, i);
+
+        FS_RECTF loose = {0, 0, 0, 0};
+        FPDFText_GetLooseCharBox(textPage, i, &loose);
+        looseLeft[i] = loose.left;
+        looseTop[i] = loose.top;
+        looseRight[i] = loose.right;
+        looseBottom[i] = loose.bottom;
+
+        double l = 0, r = 0, b = 0, t = 0;
+        FPDFText_GetCharBox(textPage, i, &l, &r, &b, &t);
+        left[i] = (float) l;
+        top[i] = (float) t;
+        right[i] = (float) r;
+        bottom[i] = (float) b;
+
+        double x = 0, y = 0;
+        FPDFText_GetCharOrigin(textPage, i, &x, &y);
+        originX[i] = (float) x;
+        originY[i] = (float) y;
+
+        fontSize[i] = (float) FPDFText_GetFontSize(textPage, i);
+        fontWeight[i] = (int32_t) FPDFText_GetFontWeight(textPage, i);
+    }
+    return count;
+}
+
+// Reads the loose box of every character of the page and builds its grid, see TextSpatialIndex.h
+static TextSpatialIndex *buildTextSpatialIndex(FPDF_TEXTPAGE textPage) {
+    TextSpatialIndex *index = new TextSpatialIndex();
+    int count = FPDFText_CountChars(textPage);
+    if (count <= 0) return index;
+
+    index->boxes.resize((size_t) count * 4);
+    for (int i = 0; i < count; i++) {
+        FS_RECTF box = {0, 0, 0, 0};
+        FPDFText_GetLooseCharBox(textPage, i, &box);
+        float *b = &index->boxes[(size_t) i * 4];
+        b[0] = box.left;
+        b[1] = box.top;
+        b[2] = box.right;
+        b[3] = box.bottom;
+    }
+    buildTextGrid(index);
+    return index;
+}
+
+// Returns the spatial index of a cached text page, building it on first use
+static TextSpatialIndex *getTextSpatialIndex(DocumentFile *doc, int pageIndex) {
+    if (doc == NULL) return NULL;
+    std::map<int, TextPageEntry>::iterator it = doc->textPages.find(pageIndex);
+    if (it == doc->textPages.end()) return NULL;
+    TextPageEntry &entry = it->second;
+    if (entry.index == NULL) {
+        entry.index = buildTextSpatialIndex(entry.textPage);
+        entry.bytes += entry.index->bytes();
+        doc->textPagesBytes += entry.index->bytes();
+    }
+    return entry.index;
+}
+
+JNI_FUNC(jint, PdfiumCore, nativeTextIndexCharAtPos)(JNI_ARGS, jlong docPtr, jint pageIndex,
+                                                     jdouble x, jdouble y,
+                                                     jdouble xTolerance, jdouble yTolerance) {
+    TextSpatialIndex *index =
+            getTextSpatialIndex(reinterpret_cast<DocumentFile *>(docPtr), (int) pageIndex);
+    if (index == NULL) return -3;
+    return textGridCharAtPos(index, (float) x, (float) y, (float) xTolerance,
+                             (float) yTolerance);
+}
+
+JNI_FUNC(jintArray, PdfiumCore, nativeTextIndexCharsInRect)(JNI_ARGS, jlong docPtr,
+                                                            jint pageIndex, jdouble left,
+                                                            jdouble top, jdouble right,
+                                                            jdouble bottom) {
+    TextSpatialIndex *index =
+            getTextSpatialIndex(reinterpret_cast<DocumentFile *>(docPtr), (int) pageIndex);
+    if (index == NULL) return NULL;
+
+    std::vector<int> chars;
+    textGridCharsInRect(index, (float) left, (float) top, (float) right, (float) bottom, &chars);
+
+    jintArray result = env->NewIntArray((jsize) chars.size());
+    if (result == NULL) return NULL;
+    env->SetIntArrayRegion(result, 0, (jsize) chars.size(), chars.data());
+    return result;
+}
+
+JNI_FUNC(jfloatArray, PdfiumCore, nativeTextIndexRangeRects)(JNI_ARGS, jlong docPtr,
+                                                             jint pageIndex, jint startIndex,
+                                                             jint count) {
+    TextSpatialIndex *index =
+            getTextSpatialIndex(reinterpret_cast<DocumentFile *>(docPtr), (int) pageIndex);
+    if (index == NULL) return NULL;
+
+    int chars = (int) (index->boxes.size() / 4);
+    int start = startIndex < 0 ? 0 : (int) startIndex;
+    int end = count < 0 || start + count > chars ? chars : start + (int) count;
+
+    // Consecutive boxes of one line are merged, a line is left when the vertical overlap
+    // drops under half of the smaller height or the text moves backwards
+    std::vector<float> rects;
+    for (int i = start; i < end; i++) {
+        const float *b = &index->boxes[(size_t) i * 4];
+        if (b[2] <= b[0] || b[1] <= b[3]) continue;
+        if (!rects.empty()) {
+            float *line = &rects[rects.size() - 4];
+            float overlap = std::min(line[1], b[1]) - std::max(line[3], b[3]);
+            float minHeight = std::min(line[1] - line[3], b[1] - b[3]);
+            if (overlap > minHeight / 2 && b[0] >= line[0]) {
+                line[1] = std::max(line[1], b[1]);
+                line[2] = std::max(line[2], b[2]);
+                line[3] = std::min(line[3], b[3]);
+                continue;
+            }
+        }
+        rects.insert(rects.end(), b, b + 4);
+    }
+
+    jfloatArray result = env->NewFloatArray((jsize) rects.size());
+    if (result == NULL) return NULL;
+    env->SetFloatArrayRegion(result, 0, (jsize) rects.size(), rects.data());
+    return result;
+}
+
+// Letters and digits form words. Non-ASCII characters count as letters except spaces and the
+// general and CJK punctuation blocks, which keeps scripts without a case mapping searchable.
+static bool isTextWordChar(unsigned short c) {
+    if (c < 0x80) return iswalnum(c) != 0;
+    if (c >= 0x2000 && c <= 0x206F) return false;
+    if (c >= 0x3000 && c <= 0x303F) return false;
+    return iswspace(c) == 0;
+}
+
+// Two characters of a line further apart than this share of the line height belong to
+// different words even without a space between them
+static const float kWordGapRatio = 0.25f;
+// Lines further apart than this share of their height start a new block
+static const float kBlockGapRatio = 0.8f;
+// Lines whose heights differ by more than this ratio, such as a heading and its paragraph,
+// start a new block
+static const float kBlockHeightRatio = 1.3f;
+
+static bool isEmptyTextBox(const float *b) { return b[2] <= b[0] || b[1] <= b[3]; }
+
+// Groups the characters of a text page into lines, from the character order of pdfium and the
+// loose boxes of the spatial index, then lines into blocks and line runs into words.
+static TextStructure *buildTextStructure(FPDF_TEXTPAGE textPage, const TextSpatialIndex *index) {
+    TextStructure *structure = new TextStructure();
+    int count = (int) (index->boxes.size() / 4);
+
+    // Lines, with the union of their boxes as left, top, right, bottom
+    std::vector<float> lineBoxes;
+    int lineStart = -1;
+    for (int i = 0; i <= count; i++) {
+        unsigned int c = i < count ? FPDFText_GetUnicode(textPage, i) : '\n';
+        bool lineBreak = c == '\r' || c == '\n';
+        const float *b = i < count ? &index->boxes[(size_t) i * 4] : NULL;
+        bool empty = b == NULL || isEmptyTextBox(b);
+
+        if (lineStart >= 0 && !lineBreak && !empty) {
+            float *line = &lineBoxes[lineBoxes.size() - 4];
+            float overlap = std::min(line[1], b[1]) - std::max(line[3], b[3]);
+            float minHeight = std::min(line[1] - line[3], b[1] - b[3]);
+            // The text going down or back to the left without a line break is a new line too
+            if (overlap <= minHeight / 2 || b[2] < line[0]) {
+                structure->lines.push_back(lineStart);
+                structure->lines.push_back(i);
+                lineStart = -1;
+            } else {
+                line[0] = std::min(line[0], b[0]);
+                line[1] = std::max(line[1], b[1]);
+                line[2] = std::max(line[2], b[2]);
+                line[3] = std::min(line[3], b[3]);
+                continue;
+            }
+        }
+        if (lineBreak) {
+            if (lineStart >= 0) {
+                structure->lines.push_back(lineStart);
+                structure->lines.push_back(i);
+            }
+            lineStart = -1;
+        } else if (lineStart < 0 && !empty) {
+            lineStart = i;
+            lineBoxes.insert(lineBoxes.end(), b, b + 4);
+        }
+    }
+
+    // Blocks, successive lines close to each other and of similar height
+    size_t lineCount = structure->lines.size() / 2;
+    for (size_t l = 0; l < lineCount; l++) {
+        const float *line = &lineBoxes[l * 4];
+        bool newBlock = l == 0;
+        if (!newBlock) {
+            const float *previous = &lineBoxes[(l - 1) * 4];
+            float height = line[1] - line[3];
+            float previousHeight = previous[1] - previous[3];
+            float gap = previous[3] - line[1];
+            float ratio = height > previousHeight ? height / previousHeight
+                                                  : previousHeight / height;
+            bool overlapsHorizontally = line[0] < previous[2] && line[2] > previous[0];
+            newBlock = gap > kBlockGapRatio * std::max(height, previousHeight) ||
+                       gap < -previousHeight || ratio > kBlockHeightRatio ||
+                       !overlapsHorizontally;
+        }
+        if (newBlock) {
+            if (l > 0) structure->blocks.push_back(structure->lines[l * 2 - 1]);
+            structure->blocks.push_back(structure->lines[l * 2]);
+        }
+    }
+    if (lineCount > 0) structure->blocks.push_back(structure->lines.back());
+
+    // Words, runs of word characters within a line
+    for (size_t l = 0; l < lineCount; l++) {
+        int end = structure->lines[l * 2 + 1];
+        float gapLimit = kWordGapRatio * (lineBoxes[l * 4 + 1] - lineBoxes[l * 4 + 3]);
+        int wordStart = -1;
+        const float *last = NULL;
+        for (int i = structure->lines[l * 2]; i <= end; i++) {
+            bool word = i < end && isTextWordChar((unsigned short) FPDFText_GetUnicode(textPage, i));
+            const float *b = i < end ? &index->boxes[(size_t) i * 4] : NULL;
+            bool gap = word && last != NULL && !isEmptyTextBox(b) && b[0] - last[2] > gapLimit;
+            if (wordStart >= 0 && (!word || gap)) {
+                structure->words.push_back(wordStart);
+                structure->words.push_back(i);
+                wordStart = -1;
+            }
+            if (word && wordStart < 0) wordStart = i;
+            if (word && !isEmptyTextBox(b)) last = b;
+            if (!word) last = NULL;
+        }
+    }
+    return structure;
+}
+
+// Returns the text structure of a cached text page, building it on first use
+static TextStructure *getTextStructure(DocumentFile *doc, int pageIndex) {
+    TextSpatialIndex *index = getTextSpatialIndex(doc, pageIndex);
+    if (index == NULL) return NULL;
+    TextPageEntry &entry = doc->textPages[pageIndex];
+    if (entry.structure == NULL) {
+        entry.structure = buildTextStructure(entry.textPage, index);
+        entry.bytes += entry.structure->bytes();
+        doc->textPagesBytes += entry.structure->bytes();
+    }
+    return entry.structure;
+}
+
+// Returns the words, lines and blocks of a cached text page as
+// [wordCount, lineCount, blockCount, word ranges..., line ranges..., block ranges...], each range
+// being the first character index and the index after the last one. Null if the text page is
+// not cached.
+JNI_FUNC(jintArray, PdfiumCore, nativeGetTextStructure)(JNI_ARGS, jlong docPtr, jint pageIndex) {
+    TextStructure *structure =
+            getTextStructure(reinterpret_cast<DocumentFile *>(docPtr), (int) pageIndex);
+    if (structure == NULL) return NULL;
+
+    jint counts[3] = {(jint) structure->words.size() / 2, (jint) structure->lines.size() / 2,
+                      (jint) structure->blocks.size() / 2};
+    jsize size = (jsize) (3 + structure->words.size() + structure->lines.size() +
+                          structure->blocks.size());
+    jintArray result = env->NewIntArray(size);
+    if (result == NULL) return NULL;
+    jsize offset = 0;
+    env->SetIntArrayRegion(result, offset, 3, counts);
+    offset += 3;
+    env->SetIntArrayRegion(result, offset, (jsize) structure->words.size(), structure->words.data());
+    offset += (jsize) structure->words.size();
+    env->SetIntArrayRegion(result, offset, (jsize) structure->lines.size(), structure->lines.data());
+    offset += (jsize) structure->lines.size();
+    env->SetIntArrayRegion(result, offset, (jsize) structure->blocks.size(),
+                           structure->blocks.data());
+    return result;
+}
+
 JNI_FUNC(jint, PdfiumCore, nativeTextGetText)(JNI_ARGS, jlong textPagePtr, jint start_index,
                                               jint count, jshortArray result) {
     FPDF_TEXTPAGE textPage = reinterpret_cast<FPDF_TEXTPAGE>(textPagePtr);
@@ -879,6 +1894,49 @@ JNI_FUNC(jint, PdfiumCore, nativeTextGetText)(JNI_ARGS, jlong textPagePtr, jint
     return output;
 }
 
+// UTF-16 output of pdfium for the String variants, reused across calls of a thread
+static thread_local std::vector<unsigned short> sTextScratch;
+
+// Characters of a text range that FPDFText_GetText will write, the terminator excluded
+static int clampTextRange(FPDF_TEXTPAGE textPage, int startIndex, int count) {
+    if (textPage == NULL || startIndex < 0 || count <= 0) return 0;
+    int chars = FPDFText_CountChars(textPage);
+    if (startIndex >= chars) return 0;
+    return count < chars - startIndex ? count : chars - startIndex;
+}
+
+// Same as nativeTextGetText, returning the text as a String built from pdfium's UTF-16 output
+JNI_FUNC(jstring, PdfiumCore, nativeTextGetTextString)(JNI_ARGS, jlong textPagePtr,
+                                                       jint start_index, jint count) {
+    FPDF_TEXTPAGE textPage = reinterpret_cast<FPDF_TEXTPAGE>(textPagePtr);
+    int length = clampTextRange(textPage, (int) start_index, (int) count);
+    if (length == 0) return env->NewString(NULL, 0);
+
+    if (sTextScratch.size() < (size_t) length + 1) sTextScratch.resize((size_t) length + 1);
+    int written = FPDFText_GetText(textPage, (int) start_index, length, sTextScratch.data());
+    // The written count includes the terminating NUL
+    if (written <= 1) return env->NewString(NULL, 0);
+    return env->NewString(reinterpret_cast<const jchar *>(sTextScratch.data()), written - 1);
+}
+
+// Writes the UTF-16 text of a range into a direct buffer, which must hold count + 1 chars for
+// the terminating NUL. Returns the number of chars written without the NUL, or -1 if the
+// buffer is not direct or too small.
+JNI_FUNC(jint, PdfiumCore, nativeTextGetTextDirect)(JNI_ARGS, jlong textPagePtr,
+                                                    jint start_index, jint count,
+                                                    jobject buffer) {
+    FPDF_TEXTPAGE textPage = reinterpret_cast<FPDF_TEXTPAGE>(textPagePtr);
+    void *address = env->GetDirectBufferAddress(buffer);
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    int length = clampTextRange(textPage, (int) start_index, (int) count);
+    if (address == NULL || capacity < (jlong) (length + 1) * 2) return -1;
+    if (length == 0) return 0;
+
+    int written = FPDFText_GetText(textPage, (int) start_index, length,
+                                   static_cast<unsigned short *>(address));
+    return written > 0 ? written - 1 : 0;
+}
+
 JNI_FUNC(jint, PdfiumCore, nativeTextCountRects)(JNI_ARGS, jlong textPagePtr, jint start_index,
                                                  jint count) {
     FPDF_TEXTPAGE textPage = reinterpret_cast<FPDF_TEXTPAGE>(textPagePtr);
@@ -929,6 +1987,24 @@ JNI_FUNC(jint, PdfiumCore, nativeTextGetBoundedText)(JNI_ARGS, jlong textPagePtr
     return output;
 }
 
+// Same as nativeTextGetBoundedText, returning the text as a String, or null if there is none
+JNI_FUNC(jstring, PdfiumCore, nativeTextGetBoundedTextString)(JNI_ARGS, jlong textPagePtr,
+                                                              jdouble left, jdouble top,
+                                                              jdouble right, jdouble bottom) {
+    FPDF_TEXTPAGE textPage = reinterpret_cast<FPDF_TEXTPAGE>(textPagePtr);
+    int length = FPDFText_GetBoundedText(textPage, (double) left, (double) top, (double) right,
+                                         (double) bottom, NULL, 0);
+    if (length <= 0) return NULL;
+
+    if (sTextScratch.size() < (size_t) length + 1) sTextScratch.resize((size_t) length + 1);
+    int written = FPDFText_GetBoundedText(textPage, (double) left, (double) top, (double) right,
+                                          (double) bottom, sTextScratch.data(), length + 1);
+    // The bounded count has no terminator, unlike FPDFText_GetText
+    if (written <= 0) return NULL;
+    if (written > length) written = length;
+    return env->NewString(reinterpret_cast<const jchar *>(sTextScratch.data()), written);
+}
+
 //////////////////////////////////////////
 // Begin PDF SDK Search
 //////////////////////////////////////////
@@ -1002,101 +2078,1526 @@ JNI_FUNC(jint, PdfiumCore, nativeCountSearchResult)(JNI_ARGS, jlong searchHandle
     return FPDFText_GetSchCount(search);
 }
 
+// Collects every match of a text page as (charStart, charCount, rectCount) triples in matches
+// and their highlight rects as (left, top, right, bottom) in rects.
+static void searchTextPage(FPDF_TEXTPAGE textPage, FPDF_WIDESTRING query, unsigned long flags,
+                           std::vector<jint> &matches, std::vector<jfloat> &rects) {
+    FPDF_SCHHANDLE search = FPDFText_FindStart(textPage, query, flags, 0);
+    if (search == NULL) return;
+    while (FPDFText_FindNext(search)) {
+        int start = FPDFText_GetSchResultIndex(search);
+        int count = FPDFText_GetSchCount(search);
+        int rectCount = FPDFText_CountRects(textPage, start, count);
+        if (rectCount < 0) rectCount = 0;
+        for (int r = 0; r < rectCount; r++) {
+            double left = 0, top = 0, right = 0, bottom = 0;
+            FPDFText_GetRect(textPage, r, &left, &top, &right, &bottom);
+            rects.push_back((jfloat) left);
+            rects.push_back((jfloat) top);
+            rects.push_back((jfloat) right);
+            rects.push_back((jfloat) bottom);
+        }
+        matches.push_back(start);
+        matches.push_back(count);
+        matches.push_back(rectCount);
+    }
+    FPDFText_FindClose(search);
+}
+
+// Searches pages fromPage..toPage and reports each page to PdfiumCore.onSearchPageResults,
+// which returns false to cancel. Cached text pages are reused, other pages are loaded only for
+// the duration of their search. Returns the number of matches, or -1 if cancelled.
+JNI_FUNC(jint, PdfiumCore, nativeSearchDocument)(JNI_ARGS, jlong docPtr, jstring query,
+                                                 jboolean matchCase, jboolean matchWholeWord,
+                                                 jint fromPage, jint toPage) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (doc == NULL || doc->pdfDocument == NULL || query == NULL) return 0;
+
+    jclass clazz = env->GetObjectClass(thiz);
+    jmethodID callback = env->GetMethodID(clazz, "onSearchPageResults", "(I[I[F)Z");
+    if (callback == NULL) return 0;
+
+    unsigned long flags = 0;
+    if (matchCase) flags |= FPDF_MATCHCASE;
+    if (matchWholeWord) flags |= FPDF_MATCHWHOLEWORD;
+
+    unsigned short *pQuery = convertWideString(env, query);
+    int pageCount = FPDF_GetPageCount(doc->pdfDocument);
+    int first = fromPage < 0 ? 0 : (int) fromPage;
+    int last = toPage >= pageCount ? pageCount - 1 : (int) toPage;
+
+    jint total = 0;
+    std::vector<jint> matches;
+    std::vector<jfloat> rects;
+    for (int pageIndex = first; pageIndex <= last; pageIndex++) {
+        matches.clear();
+        rects.clear();
+
+        std::map<int, TextPageEntry>::iterator cached = doc->textPages.find(pageIndex);
+        if (cached != doc->textPages.end()) {
+            searchTextPage(cached->second.textPage, pQuery, flags, matches, rects);
+        } else {
+            FPDF_PAGE page = FPDF_LoadPage(doc->pdfDocument, pageIndex);
+            FPDF_TEXTPAGE textPage = page != NULL ? FPDFText_LoadPage(page) : NULL;
+            if (textPage != NULL) {
+                searchTextPage(textPage, pQuery, flags, matches, rects);
+                FPDFText_ClosePage(textPage);
+            }
+            if (page != NULL) FPDF_ClosePage(page);
+        }
+
+        jintArray javaMatches = NULL;
+        jfloatArray javaRects = NULL;
+        if (!matches.empty()) {
+            total += (jint) (matches.size() / 3);
+            javaMatches = env->NewIntArray((jsize) matches.size());
+            javaRects = env->NewFloatArray((jsize) rects.size());
+            if (javaMatches == NULL || javaRects == NULL) break;
+            env->SetIntArrayRegion(javaMatches, 0, (jsize) matches.size(), matches.data());
+            env->SetFloatArrayRegion(javaRects, 0, (jsize) rects.size(), rects.data());
+        }
+
+        jboolean proceed = env->CallBooleanMethod(thiz, callback, (jint) pageIndex,
+                                                  javaMatches, javaRects);
+        if (javaMatches != NULL) env->DeleteLocalRef(javaMatches);
+        if (javaRects != NULL) env->DeleteLocalRef(javaRects);
+        if (env->ExceptionCheck() || !proceed) {
+            total = -1;
+            break;
+        }
+    }
+
+    free(pQuery);
+    return total;
+}
+
 //////////////////////////////////////////
-// Begin PDF Annotation api
+// Begin PDF Full-text index api
 //////////////////////////////////////////
-JNI_FUNC(jlong, PdfiumCore, nativeAddTextAnnotation)(JNI_ARGS, jlong docPtr, int page_index,
-                                                     jstring text_,
-                                                     jintArray color_, jintArray bound_) {
-
-    // This function uses loadPageInternal, not the refactored loadTextPageInternal.
-    // If its FPDF_PAGE also needs to come from Java, it would require similar refactoring.
-    // For now, assuming its FPDF_PAGE loading mechanism remains unchanged.
-    FPDF_PAGE page;
-    DocumentFile *doc = reinterpret_cast<DocumentFile *>(docPtr);
-    // NOTE: This still uses the old loadPageInternal to get an FPDF_PAGE.
-    // This is distinct from the FPDF_TEXTPAGE loading changes above.
-    jlong pagePtrAsJlong = loadPageInternal(env, doc, page_index); // Renamed for clarity
-    if (pagePtrAsJlong == -1) {
-        return -1;
+
+// Sidecar file layout, little endian, all offsets from the start of the file:
+//   FtsHeader
+//   FtsTerm[termCount]        sorted by the UTF-8 bytes of the term
+//   char strings[]            UTF-8 terms, not terminated
+//   uint32 postings[][2]      (page, char offset) per occurrence, grouped by term
+//   char identity[]           document identity the index was built for
+static const char kFtsMagic[4] = {'P', 'F', 'T', 'I'};
+static const uint32_t kFtsVersion = 1;
+static const int kFtsMaxTermChars = 64;
+
+struct FtsHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t pageCount;
+    uint32_t indexedPages;
+    uint32_t termCount;
+    uint32_t postingCount;
+    uint32_t identityLength;
+    uint32_t reserved;
+    uint64_t termsOffset;
+    uint64_t stringsOffset;
+    uint64_t postingsOffset;
+    uint64_t identityOffset;
+};
+
+struct FtsTerm {
+    uint32_t stringOffset;
+    uint32_t stringLength;
+    uint32_t charLength;
+    uint32_t postingStart;
+    uint32_t postingCount;
+};
+
+struct FtsPostings {
+    uint32_t charLength;
+    std::vector<uint32_t> postings;
+};
+
+struct FtsBuilder {
+    std::string path;
+    std::string identity;
+    uint32_t pageCount;
+    uint32_t indexedPages;
+    std::map<std::string, FtsPostings> terms;
+};
+
+struct FtsIndex {
+    void *base;
+    size_t size;
+    const FtsHeader *header;
+    const FtsTerm *terms;
+    const char *strings;
+    const uint32_t *postings;
+};
+
+static void appendUtf8(std::string &out, unsigned short c) {
+    if (c < 0x80) {
+        out.push_back((char) c);
+    } else if (c < 0x800) {
+        out.push_back((char) (0xC0 | (c >> 6)));
+        out.push_back((char) (0x80 | (c & 0x3F)));
     } else {
-        page = reinterpret_cast<FPDF_PAGE>(pagePtrAsJlong);
+        out.push_back((char) (0xE0 | (c >> 12)));
+        out.push_back((char) (0x80 | ((c >> 6) & 0x3F)));
+        out.push_back((char) (0x80 | (c & 0x3F)));
     }
+}
 
-    // Get the bound array
-    jint *bounds = env->GetIntArrayElements(bound_, NULL);
-    int boundsLen = (int) (env->GetArrayLength(bound_));
-    if (boundsLen != 4) {
-        return -1;
+static void addFtsTerm(FtsBuilder *builder, const std::string &term, uint32_t page,
+                       uint32_t offset, uint32_t charLength) {
+    FtsPostings &entry = builder->terms[term];
+    entry.charLength = charLength;
+    entry.postings.push_back(page);
+    entry.postings.push_back(offset);
+}
+
+// Splits the page text into lower cased words and records their positions. Words longer than
+// kFtsMaxTermChars are indexed by their first kFtsMaxTermChars characters.
+static void tokenizeFtsPage(FtsBuilder *builder, FPDF_TEXTPAGE textPage, uint32_t page) {
+    int count = FPDFText_CountChars(textPage);
+    if (count <= 0) return;
+    std::vector<unsigned short> text((size_t) count + 1);
+    FPDFText_GetText(textPage, 0, count, text.data());
+
+    std::string term;
+    int start = -1;
+    for (int i = 0; i <= count; i++) {
+        bool word = i < count && isTextWordChar(text[i]);
+        if (word) {
+            if (start < 0) {
+                start = i;
+                term.clear();
+            }
+            if (i - start < kFtsMaxTermChars) appendUtf8(term, (unsigned short) towlower(text[i]));
+        } else if (start >= 0) {
+            int chars = i - start < kFtsMaxTermChars ? i - start : kFtsMaxTermChars;
+            addFtsTerm(builder, term, page, (uint32_t) start, (uint32_t) chars);
+            start = -1;
+        }
     }
+}
 
-    // Set the annotation rectangle.
-    FS_RECTF rect;
-    rect.left = bounds[0];
-    rect.top = bounds[1];
-    rect.right = bounds[2];
-    rect.bottom = bounds[3];
-
-    // Get the text color
-    unsigned int R, G, B, A;
-    jint *colors = env->GetIntArrayElements(color_, NULL);
-    int colorsLen = (int) (env->GetArrayLength(color_));
-    if (colorsLen == 4) {
-        R = colors[0];
-        G = colors[1];
-        B = colors[2];
-        A = colors[3];
+// Splits a query the same way pages are indexed
+static std::vector<std::string> tokenizeFtsQuery(JNIEnv *env, jstring query) {
+    std::vector<std::string> tokens;
+    const jchar *raw = env->GetStringChars(query, NULL);
+    if (raw == NULL) return tokens;
+    jsize length = env->GetStringLength(query);
+    std::string term;
+    int chars = 0;
+    for (jsize i = 0; i <= length; i++) {
+        if (i < length && isTextWordChar(raw[i])) {
+            if (chars++ < kFtsMaxTermChars) appendUtf8(term, (unsigned short) towlower(raw[i]));
+        } else if (!term.empty()) {
+            tokens.push_back(term);
+            term.clear();
+            chars = 0;
+        }
+    }
+    env->ReleaseStringChars(query, raw);
+    return tokens;
+}
+
+static FtsIndex *openFtsIndex(const char *path, const std::string &identity) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(FtsHeader)) {
+        close(fd);
+        return NULL;
+    }
+    size_t size = (size_t) st.st_size;
+    void *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return NULL;
+
+    const FtsHeader *header = static_cast<const FtsHeader *>(base);
+    const char *bytes = static_cast<const char *>(base);
+    // Offsets are bounded by the size first, so the sums below cannot overflow
+    bool valid = memcmp(header->magic, kFtsMagic, 4) == 0 && header->version == kFtsVersion &&
+                 header->termsOffset <= size && header->postingsOffset <= size &&
+                 header->identityOffset <= size &&
+                 header->termsOffset + (uint64_t) header->termCount * sizeof(FtsTerm) <= size &&
+                 header->stringsOffset <= header->postingsOffset &&
+                 header->termsOffset % 4 == 0 && header->postingsOffset % 4 == 0 &&
+                 header->postingsOffset + (uint64_t) header->postingCount * 8 <= size &&
+                 header->identityOffset + header->identityLength <= size &&
+                 header->identityLength == identity.size() &&
+                 memcmp(bytes + header->identityOffset, identity.data(), identity.size()) == 0;
+    // Every term must point inside the strings and postings, a truncated or corrupt file is
+    // rejected as a whole
+    const FtsTerm *terms = reinterpret_cast<const FtsTerm *>(bytes + header->termsOffset);
+    for (uint32_t t = 0; valid && t < header->termCount; t++) {
+        valid = header->stringsOffset + terms[t].stringOffset + terms[t].stringLength <=
+                header->postingsOffset &&
+                (uint64_t) terms[t].postingStart + terms[t].postingCount <= header->postingCount;
+    }
+    if (!valid) {
+        munmap(base, size);
+        return NULL;
+    }
+
+    FtsIndex *index = new FtsIndex();
+    index->base = base;
+    index->size = size;
+    index->header = header;
+    index->terms = reinterpret_cast<const FtsTerm *>(bytes + header->termsOffset);
+    index->strings = bytes + header->stringsOffset;
+    index->postings = reinterpret_cast<const uint32_t *>(bytes + header->postingsOffset);
+    return index;
+}
+
+static void closeFtsIndex(FtsIndex *index) {
+    if (index == NULL) return;
+    munmap(index->base, index->size);
+    delete index;
+}
+
+static std::string ftsIdentity(JNIEnv *env, jstring identity) {
+    const char *raw = env->GetStringUTFChars(identity, NULL);
+    if (raw == NULL) return std::string();
+    std::string result(raw);
+    env->ReleaseStringUTFChars(identity, raw);
+    return result;
+}
+
+// Returns the permanent (0) or changing (1) identifier of the document as hex, or null
+JNI_FUNC(jstring, PdfiumCore, nativeGetFileIdentifier)(JNI_ARGS, jlong docPtr, jint type) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (doc == NULL || doc->pdfDocument == NULL) return NULL;
+
+    FPDF_FILEIDTYPE idType = type == 1 ? FILEIDTYPE_CHANGING : FILEIDTYPE_PERMANENT;
+    unsigned long length = FPDF_GetFileIdentifier(doc->pdfDocument, idType, NULL, 0);
+    if (length <= 1) return NULL;
+    std::vector<unsigned char> id(length);
+    FPDF_GetFileIdentifier(doc->pdfDocument, idType, id.data(), length);
+
+    // The identifier is a binary string followed by a NUL
+    static const char kHex[] = "0123456789abcdef";
+    std::string hex;
+    for (unsigned long i = 0; i + 1 < length; i++) {
+        hex.push_back(kHex[id[i] >> 4]);
+        hex.push_back(kHex[id[i] & 0x0F]);
+    }
+    return env->NewStringUTF(hex.c_str());
+}
+
+JNI_FUNC(jlong, PdfiumCore, nativeFtsBuilderCreate)(JNI_ARGS, jstring path, jstring identity,
+                                                    jint pageCount) {
+    FtsBuilder *builder = new FtsBuilder();
+    builder->path = ftsIdentity(env, path);
+    builder->identity = ftsIdentity(env, identity);
+    builder->pageCount = (uint32_t) pageCount;
+    builder->indexedPages = 0;
+
+    // Resume from a partial index left by a previous session
+    FtsIndex *existing = openFtsIndex(builder->path.c_str(), builder->identity);
+    if (existing != NULL && existing->header->pageCount == builder->pageCount) {
+        for (uint32_t t = 0; t < existing->header->termCount; t++) {
+            const FtsTerm &term = existing->terms[t];
+            FtsPostings &entry = builder->terms[std::string(existing->strings + term.stringOffset,
+                                                            term.stringLength)];
+            entry.charLength = term.charLength;
+            const uint32_t *postings = existing->postings + (size_t) term.postingStart * 2;
+            entry.postings.assign(postings, postings + (size_t) term.postingCount * 2);
+        }
+        builder->indexedPages = existing->header->indexedPages;
+    }
+    closeFtsIndex(existing);
+    return reinterpret_cast<jlong>(builder);
+}
+
+JNI_FUNC(jint, PdfiumCore, nativeFtsBuilderIndexedPages)(JNI_ARGS, jlong builderPtr) {
+    FtsBuilder *builder = reinterpret_cast<FtsBuilder *>(builderPtr);
+    return builder == NULL ? 0 : (jint) builder->indexedPages;
+}
+
+// Indexes up to pageCount more pages. Cached text pages are reused, other pages are loaded only
+// while being indexed. Returns the number of pages indexed so far.
+JNI_FUNC(jint, PdfiumCore, nativeFtsBuilderAddPages)(JNI_ARGS, jlong builderPtr, jlong docPtr,
+                                                     jint pageCount) {
+    FtsBuilder *builder = reinterpret_cast<FtsBuilder *>(builderPtr);
+    DocumentFile *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (builder == NULL || doc == NULL || doc->pdfDocument == NULL) return 0;
+
+    uint32_t end = builder->indexedPages + (uint32_t) pageCount;
+    if (end > builder->pageCount) end = builder->pageCount;
+    for (uint32_t pageIndex = builder->indexedPages; pageIndex < end; pageIndex++) {
+        std::map<int, TextPageEntry>::iterator cached = doc->textPages.find((int) pageIndex);
+        if (cached != doc->textPages.end()) {
+            tokenizeFtsPage(builder, cached->second.textPage, pageIndex);
+        } else {
+            FPDF_PAGE page = FPDF_LoadPage(doc->pdfDocument, (int) pageIndex);
+            FPDF_TEXTPAGE textPage = page != NULL ? FPDFText_LoadPage(page) : NULL;
+            if (textPage != NULL) {
+                tokenizeFtsPage(builder, textPage, pageIndex);
+                FPDFText_ClosePage(textPage);
+            }
+            if (page != NULL) FPDF_ClosePage(page);
+        }
+        builder->indexedPages = pageIndex + 1;
+    }
+    return (jint) builder->indexedPages;
+}
+
+// Writes the index to a temporary file that replaces the sidecar once complete, so a reader
+// never maps a partially written file.
+JNI_FUNC(jboolean, PdfiumCore, nativeFtsBuilderSave)(JNI_ARGS, jlong builderPtr) {
+    FtsBuilder *builder = reinterpret_cast<FtsBuilder *>(builderPtr);
+    if (builder == NULL) return JNI_FALSE;
+
+    FtsHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kFtsMagic, 4);
+    header.version = kFtsVersion;
+    header.pageCount = builder->pageCount;
+    header.indexedPages = builder->indexedPages;
+    header.termCount = (uint32_t) builder->terms.size();
+    header.identityLength = (uint32_t) builder->identity.size();
+
+    std::vector<FtsTerm> terms;
+    std::string strings;
+    uint32_t postingCount = 0;
+    terms.reserve(builder->terms.size());
+    for (std::map<std::string, FtsPostings>::const_iterator it = builder->terms.begin();
+         it != builder->terms.end(); ++it) {
+        FtsTerm term;
+        term.stringOffset = (uint32_t) strings.size();
+        term.stringLength = (uint32_t) it->first.size();
+        term.charLength = it->second.charLength;
+        term.postingStart = postingCount;
+        term.postingCount = (uint32_t) (it->second.postings.size() / 2);
+        postingCount += term.postingCount;
+        strings += it->first;
+        terms.push_back(term);
+    }
+    header.postingCount = postingCount;
+    header.termsOffset = sizeof(FtsHeader);
+    header.stringsOffset = header.termsOffset + terms.size() * sizeof(FtsTerm);
+    // Postings are read in place as uint32, keep them aligned
+    header.postingsOffset = (header.stringsOffset + strings.size() + 3) & ~(uint64_t) 3;
+    header.identityOffset = header.postingsOffset + (uint64_t) postingCount * 8;
+
+    std::string tmpPath = builder->path + ".tmp";
+    FILE *file = fopen(tmpPath.c_str(), "wb");
+    if (file == NULL) return JNI_FALSE;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && (terms.empty() || fwrite(terms.data(), sizeof(FtsTerm), terms.size(), file) == terms.size());
+    ok = ok && fwrite(strings.data(), 1, strings.size(), file) == strings.size();
+    static const char kPadding[4] = {0, 0, 0, 0};
+    size_t padding = (size_t) (header.postingsOffset - header.stringsOffset - strings.size());
+    ok = ok && fwrite(kPadding, 1, padding, file) == padding;
+    for (std::map<std::string, FtsPostings>::const_iterator it = builder->terms.begin();
+         ok && it != builder->terms.end(); ++it) {
+        const std::vector<uint32_t> &postings = it->second.postings;
+        ok = fwrite(postings.data(), sizeof(uint32_t), postings.size(), file) == postings.size();
+    }
+    ok = ok && fwrite(builder->identity.data(), 1, builder->identity.size(), file) ==
+               builder->identity.size();
+    ok = fclose(file) == 0 && ok;
+
+    if (!ok || rename(tmpPath.c_str(), builder->path.c_str()) != 0) {
+        unlink(tmpPath.c_str());
+        return JNI_FALSE;
+    }
+    return JNI_TRUE;
+}
+
+JNI_FUNC(void, PdfiumCore, nativeFtsBuilderDestroy)(JNI_ARGS, jlong builderPtr) {
+    delete reinterpret_cast<FtsBuilder *>(builderPtr);
+}
+
+JNI_FUNC(jlong, PdfiumCore, nativeFtsOpen)(JNI_ARGS, jstring path, jstring identity) {
+    std::string filePath = ftsIdentity(env, path);
+    return reinterpret_cast<jlong>(openFtsIndex(filePath.c_str(), ftsIdentity(env, identity)));
+}
+
+JNI_FUNC(jintArray, PdfiumCore, nativeFtsInfo)(JNI_ARGS, jlong indexPtr) {
+    FtsIndex *index = reinterpret_cast<FtsIndex *>(indexPtr);
+    if (index == NULL) return NULL;
+    jint info[3] = {(jint) index->header->pageCount, (jint) index->header->indexedPages,
+                    (jint) index->header->termCount};
+    jintArray result = env->NewIntArray(3);
+    if (result != NULL) env->SetIntArrayRegion(result, 0, 3, info);
+    return result;
+}
+
+// Returns the range of terms starting with prefix, or equal to it when exact is set
+static void findFtsTerms(const FtsIndex *index, const std::string &prefix, bool exact,
+                         uint32_t *first, uint32_t *last) {
+    uint32_t low = 0, high = index->header->termCount;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        const FtsTerm &term = index->terms[mid];
+        if (std::string(index->strings + term.stringOffset, term.stringLength) < prefix) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    *first = low;
+    uint32_t end = low;
+    while (end < index->header->termCount) {
+        const FtsTerm &term = index->terms[end];
+        if (term.stringLength < prefix.size() ||
+            memcmp(index->strings + term.stringOffset, prefix.data(), prefix.size()) != 0) break;
+        if (exact && term.stringLength != prefix.size()) break;
+        end++;
+    }
+    *last = end;
+}
+
+// Finds the occurrences of the last query word, completed as a prefix when requested, on pages
+// that also contain every other query word. Returns (page, charOffset, charLength) triples.
+JNI_FUNC(jintArray, PdfiumCore, nativeFtsSearch)(JNI_ARGS, jlong indexPtr, jstring query,
+                                                 jboolean prefix, jint maxResults) {
+    FtsIndex *index = reinterpret_cast<FtsIndex *>(indexPtr);
+    if (index == NULL || query == NULL) return NULL;
+
+    std::vector<std::string> tokens = tokenizeFtsQuery(env, query);
+    std::vector<jint> hits;
+    if (!tokens.empty()) {
+        // Pages containing every word but the last one
+        std::vector<uint32_t> pages;
+        bool filtered = false;
+        for (size_t t = 0; t + 1 < tokens.size(); t++) {
+            uint32_t first, last;
+            findFtsTerms(index, tokens[t], true, &first, &last);
+            std::vector<uint32_t> termPages;
+            for (uint32_t i = first; i < last; i++) {
+                const FtsTerm &term = index->terms[i];
+                const uint32_t *p = index->postings + (size_t) term.postingStart * 2;
+                for (uint32_t k = 0; k < term.postingCount; k++) termPages.push_back(p[k * 2]);
+            }
+            std::sort(termPages.begin(), termPages.end());
+            termPages.erase(std::unique(termPages.begin(), termPages.end()), termPages.end());
+            if (filtered) {
+                std::vector<uint32_t> both;
+                std::set_intersection(pages.begin(), pages.end(), termPages.begin(),
+                                      termPages.end(), std::back_inserter(both));
+                pages.swap(both);
+            } else {
+                pages.swap(termPages);
+                filtered = true;
+            }
+        }
+
+        uint32_t first, last;
+        findFtsTerms(index, tokens.back(), !prefix, &first, &last);
+        for (uint32_t i = first; i < last; i++) {
+            const FtsTerm &term = index->terms[i];
+            const uint32_t *p = index->postings + (size_t) term.postingStart * 2;
+            for (uint32_t k = 0; k < term.postingCount; k++) {
+                if (maxResults >= 0 && hits.size() / 3 >= (size_t) maxResults) break;
+                if (filtered && !std::binary_search(pages.begin(), pages.end(), p[k * 2])) continue;
+                hits.push_back((jint) p[k * 2]);
+                hits.push_back((jint) p[k * 2 + 1]);
+                hits.push_back((jint) term.charLength);
+            }
+        }
+    }
+
+    jintArray result = env->NewIntArray((jsize) hits.size());
+    if (result != NULL) env->SetIntArrayRegion(result, 0, (jsize) hits.size(), hits.data());
+    return result;
+}
+
+JNI_FUNC(void, PdfiumCore, nativeFtsClose)(JNI_ARGS, jlong indexPtr) {
+    closeFtsIndex(reinterpret_cast<FtsIndex *>(indexPtr));
+}
+
+//////////////////////////////////////////
+// Begin PDF Search session api
+//////////////////////////////////////////
+
+typedef std::vector<unsigned short> SearchText;
+
+// Match starts of one query, per page. A page is present once it has been searched, so a
+// cancelled query keeps the pages it got through.
+typedef std::map<int, std::vector<int> > SearchResultSet;
+
+// Search as you type. Page texts are read once and kept, case folded unless matching case.
+// Results are cached per query: extending the query only re-verifies the matches of its
+// longest cached prefix, and going back to a prefix reuses its results as they are. Matches
+// are stored as plain substring matches and filtered for whole words when reported, since a
+// whole word match of the extended query is never one of its prefix.
+struct SearchSession {
+    bool matchCase;
+    bool matchWholeWord;
+    std::map<int, SearchText> pageTexts;
+    size_t pageTextsBytes;
+    size_t pageTextsBudget;
+    std::map<SearchText, SearchResultSet> results;
+};
+
+static const size_t kSearchSessionTextBudget = 8 * 1024 * 1024;
+
+static bool readSearchPageText(DocumentFile *doc, int pageIndex, bool fold, SearchText &text) {
+    FPDF_TEXTPAGE textPage = NULL;
+    FPDF_PAGE page = NULL;
+    std::map<int, TextPageEntry>::iterator cached = doc->textPages.find(pageIndex);
+    if (cached != doc->textPages.end()) {
+        textPage = cached->second.textPage;
     } else {
-        R = 51u;
-        G = 102u;
-        B = 153u;
-        A = 204u;
+        page = FPDF_LoadPage(doc->pdfDocument, pageIndex);
+        textPage = page != NULL ? FPDFText_LoadPage(page) : NULL;
     }
 
-    // Add a text annotation to the page.
-    FPDF_ANNOTATION annot = FPDFPage_CreateAnnot(page, FPDF_ANNOT_TEXT);
+    bool loaded = textPage != NULL;
+    if (loaded) {
+        int count = FPDFText_CountChars(textPage);
+        text.assign(count > 0 ? (size_t) count + 1 : 1, 0);
+        if (count > 0) FPDFText_GetText(textPage, 0, count, text.data());
+        text.pop_back();
+        if (fold) {
+            for (size_t i = 0; i < text.size(); i++) text[i] = (unsigned short) towlower(text[i]);
+        }
+    }
 
-    // set the rectangle of the annotation
-    FPDFAnnot_SetRect(annot, &rect);
-    env->ReleaseIntArrayElements(bound_, bounds, 0);
+    if (page != NULL) {
+        if (textPage != NULL) FPDFText_ClosePage(textPage);
+        FPDF_ClosePage(page);
+    }
+    return loaded;
+}
 
-    // Set the color of the annotation.
-    FPDFAnnot_SetColor(annot, FPDFANNOT_COLORTYPE_Color, R, G, B, A);
-    env->ReleaseIntArrayElements(color_, colors, 0);
+// Returns the text of a page, read from the session when kept there. Texts are kept until the
+// session budget is used up, later pages are read again on every query.
+static const SearchText *searchPageText(SearchSession *session, DocumentFile *doc, int pageIndex,
+                                        SearchText &scratch) {
+    std::map<int, SearchText>::const_iterator kept = session->pageTexts.find(pageIndex);
+    if (kept != session->pageTexts.end()) return &kept->second;
+    if (!readSearchPageText(doc, pageIndex, !session->matchCase, scratch)) return NULL;
 
-    // Set the content of the annotation.
-    unsigned short *kContents = convertWideString(env, text_);
-    FPDFAnnot_SetStringValue(annot, kContentsKey, kContents);
-    free(kContents); // Free the allocated wide string
+    size_t bytes = scratch.size() * sizeof(unsigned short);
+    if (session->pageTextsBytes + bytes > session->pageTextsBudget) return &scratch;
+    session->pageTextsBytes += bytes;
+    SearchText &text = session->pageTexts[pageIndex];
+    text.swap(scratch);
+    return &text;
+}
 
-    // save page
-    FPDF_DOCUMENT pdfDoc = doc->pdfDocument;
-    if (!FPDF_SaveAsCopy(pdfDoc, NULL, FPDF_INCREMENTAL)) {
-        return -1;
+static bool searchTextMatchesAt(const SearchText &text, int start, const SearchText &query) {
+    if (start < 0 || start + query.size() > text.size()) return false;
+    return std::equal(query.begin(), query.end(), text.begin() + start);
+}
+
+static bool isWholeWordAt(const SearchText &text, int start, int length) {
+    if (start > 0 && isTextWordChar(text[start - 1])) return false;
+    size_t end = (size_t) start + length;
+    return end >= text.size() || !isTextWordChar(text[end]);
+}
+
+// Drops cached results that cannot serve the new query, that is every query which is not a
+// prefix of it. The cache then holds at most one chain of prefixes.
+static void trimSearchResults(SearchSession *session, const SearchText &query) {
+    std::map<SearchText, SearchResultSet>::iterator it = session->results.begin();
+    while (it != session->results.end()) {
+        const SearchText &cached = it->first;
+        bool prefix = cached.size() <= query.size() &&
+                      std::equal(cached.begin(), cached.end(), query.begin());
+        if (prefix) ++it; else session->results.erase(it++);
     }
+}
 
-    // close page
-    closePageInternal(
-            pagePtrAsJlong); // Use the jlong version for consistency with closePageInternal
+// Finds the match starts of query on a page, from the longest cached prefix searched on that
+// page when there is one, by scanning the page text otherwise.
+static void searchSessionPage(SearchSession *session, DocumentFile *doc, int pageIndex,
+                              const SearchText &query, std::vector<int> &starts) {
+    const std::vector<int> *candidates = NULL;
+    size_t candidateLength = 0;
+    for (std::map<SearchText, SearchResultSet>::const_iterator it = session->results.begin();
+         it != session->results.end(); ++it) {
+        if (it->first.size() >= query.size() || it->first.size() < candidateLength) continue;
+        SearchResultSet::const_iterator page = it->second.find(pageIndex);
+        if (page == it->second.end()) continue;
+        candidates = &page->second;
+        candidateLength = it->first.size();
+    }
 
-    // reload page
-    // NOTE: This reloads the FPDF_PAGE using the old mechanism.
-    pagePtrAsJlong = loadPageInternal(env, doc, page_index);
-    if (pagePtrAsJlong == -1) {
-        // Handle error after trying to reload page for annotation
-        return -1;
+    starts.clear();
+    // A prefix without matches on the page rules it out without reading its text
+    if (candidates != NULL && candidates->empty()) return;
+
+    SearchText scratch;
+    const SearchText *text = searchPageText(session, doc, pageIndex, scratch);
+    if (text == NULL) return;
+
+    if (candidates != NULL) {
+        for (size_t i = 0; i < candidates->size(); i++) {
+            int start = (*candidates)[i];
+            if (searchTextMatchesAt(*text, start, query)) starts.push_back(start);
+        }
+        return;
     }
+    if (query.empty() || text->size() < query.size()) return;
+    SearchText::const_iterator from = text->begin();
+    while (true) {
+        SearchText::const_iterator found = std::search(from, text->end(), query.begin(), query.end());
+        if (found == text->end()) break;
+        starts.push_back((int) (found - text->begin()));
+        from = found + 1;
+    }
+}
 
-    jclass clazz = env->FindClass("com/harissk/pdfium/PdfiumCore");
-    jmethodID callback = env->GetMethodID(clazz, "onAnnotationAdded",
-                                          "(Ljava/lang/Integer;Ljava/lang/Long;)V"); // Return type is V (void)
-    // The callback likely expects the FPDF_PAGE pointer, not FPDF_ANNOTATION pointer.
-    // Ensure the Java callback signature matches what's passed.
-    // Assuming it expects the reloaded page pointer.
-    env->CallObjectMethod(thiz, callback, NewInteger(env, page_index),
-                          NewLong(env, pagePtrAsJlong));
+JNI_FUNC(jlong, PdfiumCore, nativeSearchSessionCreate)(JNI_ARGS, jboolean matchCase,
+                                                       jboolean matchWholeWord) {
+    SearchSession *session = new SearchSession();
+    session->matchCase = matchCase == JNI_TRUE;
+    session->matchWholeWord = matchWholeWord == JNI_TRUE;
+    session->pageTextsBytes = 0;
+    session->pageTextsBudget = kSearchSessionTextBudget;
+    return reinterpret_cast<jlong>(session);
+}
 
-    return reinterpret_cast<jlong>(annot);
+JNI_FUNC(void, PdfiumCore, nativeSearchSessionDestroy)(JNI_ARGS, jlong sessionPtr) {
+    delete reinterpret_cast<SearchSession *>(sessionPtr);
+}
+
+// Searches the pages of pageOrder, in that order, and reports each of them to
+// PdfiumCore.onSearchPageResults like nativeSearchDocument. Rects are only measured on pages
+// whose text page is cached, matches of other pages are reported with no rect. Returns the
+// number of matches, or -1 if cancelled.
+JNI_FUNC(jint, PdfiumCore, nativeSearchSessionQuery)(JNI_ARGS, jlong sessionPtr, jlong docPtr,
+                                                     jstring query, jintArray pageOrder) {
+    SearchSession *session = reinterpret_cast<SearchSession *>(sessionPtr);
+    DocumentFile *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (session == NULL || doc == NULL || doc->pdfDocument == NULL || query == NULL ||
+        pageOrder == NULL)
+        return 0;
+
+    jclass clazz = env->GetObjectClass(thiz);
+    jmethodID callback = env->GetMethodID(clazz, "onSearchPageResults", "(I[I[F)Z");
+    if (callback == NULL) return 0;
+
+    SearchText pattern;
+    const jchar *raw = env->GetStringChars(query, NULL);
+    if (raw == NULL) return 0;
+    pattern.assign(raw, raw + env->GetStringLength(query));
+    env->ReleaseStringChars(query, raw);
+    if (pattern.empty()) return 0;
+    if (!session->matchCase) {
+        for (size_t i = 0; i < pattern.size(); i++) {
+            pattern[i] = (unsigned short) towlower(pattern[i]);
+        }
+    }
+
+    trimSearchResults(session, pattern);
+    SearchResultSet &resultSet = session->results[pattern];
+
+    jsize orderLength = env->GetArrayLength(pageOrder);
+    std::vector<jint> order((size_t) orderLength);
+    env->GetIntArrayRegion(pageOrder, 0, orderLength, order.data());
+    int pageCount = FPDF_GetPageCount(doc->pdfDocument);
+
+    jint total = 0;
+    std::vector<jint> matches;
+    std::vector<jfloat> rects;
+    for (size_t o = 0; o < order.size(); o++) {
+        int pageIndex = order[o];
+        if (pageIndex < 0 || pageIndex >= pageCount) continue;
+
+        SearchResultSet::iterator page = resultSet.find(pageIndex);
+        if (page == resultSet.end()) {
+            std::vector<int> starts;
+            searchSessionPage(session, doc, pageIndex, pattern, starts);
+            page = resultSet.insert(std::make_pair(pageIndex, starts)).first;
+        }
+
+        std::map<int, TextPageEntry>::iterator cached = doc->textPages.find(pageIndex);
+        FPDF_TEXTPAGE textPage = cached != doc->textPages.end() ? cached->second.textPage : NULL;
+        SearchText scratch;
+        const SearchText *pageText = NULL;
+        if (session->matchWholeWord && !page->second.empty()) {
+            pageText = searchPageText(session, doc, pageIndex, scratch);
+        }
+
+        matches.clear();
+        rects.clear();
+        int count = (int) pattern.size();
+        for (size_t i = 0; i < page->second.size(); i++) {
+            int start = page->second[i];
+            if (pageText != NULL && !isWholeWordAt(*pageText, start, count)) continue;
+            int rectCount = textPage != NULL ? FPDFText_CountRects(textPage, start, count) : 0;
+            if (rectCount < 0) rectCount = 0;
+            for (int r = 0; r < rectCount; r++) {
+                double left = 0, top = 0, right = 0, bottom = 0;
+                FPDFText_GetRect(textPage, r, &left, &top, &right, &bottom);
+                rects.push_back((jfloat) left);
+                rects.push_back((jfloat) top);
+                rects.push_back((jfloat) right);
+                rects.push_back((jfloat) bottom);
+            }
+            matches.push_back(start);
+            matches.push_back(count);
+            matches.push_back(rectCount);
+        }
+
+        jintArray javaMatches = NULL;
+        jfloatArray javaRects = NULL;
+        if (!matches.empty()) {
+            total += (jint) (matches.size() / 3);
+            javaMatches = env->NewIntArray((jsize) matches.size());
+            javaRects = env->NewFloatArray((jsize) rects.size());
+            if (javaMatches == NULL || javaRects == NULL) break;
+            env->SetIntArrayRegion(javaMatches, 0, (jsize) matches.size(), matches.data());
+            env->SetFloatArrayRegion(javaRects, 0, (jsize) rects.size(), rects.data());
+        }
+
+        jboolean proceed = env->CallBooleanMethod(thiz, callback, (jint) pageIndex,
+                                                  javaMatches, javaRects);
+        if (javaMatches != NULL) env->DeleteLocalRef(javaMatches);
+        if (javaRects != NULL) env->DeleteLocalRef(javaRects);
+        if (env->ExceptionCheck() || !proceed) {
+            total = -1;
+            break;
+        }
+    }
+    return total;
+}
+
+//////////////////////////////////////////
+// Begin PDF Text extraction api
+//////////////////////////////////////////
+
+static const size_t kExtractQueueBytes = 4 * 1024 * 1024;
+static const size_t kExtractWriteBuffer = 64 * 1024;
+
+// Page texts handed from the extracting thread to the writer thread. The extracting thread
+// waits while the queue holds more than kExtractQueueBytes, which bounds the memory used
+// whatever the document size.
+struct TextExtraction {
+    int fd;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    std::vector<SearchText *> queue;
+    size_t queuedBytes;
+    bool finished;
+    bool failed;
+    int64_t bytesWritten;
+};
+
+static bool writeFully(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        length -= (size_t) written;
+    }
+    return true;
+}
+
+// Appends UTF-16 text as UTF-8, joining surrogate pairs and replacing lone surrogates
+static void appendUtf16AsUtf8(std::string &out, const unsigned short *text, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        uint32_t c = text[i];
+        if (c >= 0xD800 && c <= 0xDBFF && i + 1 < length && text[i + 1] >= 0xDC00 &&
+            text[i + 1] <= 0xDFFF) {
+            c = 0x10000 + ((c - 0xD800) << 10) + (text[++i] - 0xDC00);
+        } else if (c >= 0xD800 && c <= 0xDFFF) {
+            c = 0xFFFD;
+        }
+
+        if (c < 0x80) {
+            out.push_back((char) c);
+        } else if (c < 0x800) {
+            out.push_back((char) (0xC0 | (c >> 6)));
+            out.push_back((char) (0x80 | (c & 0x3F)));
+        } else if (c < 0x10000) {
+            out.push_back((char) (0xE0 | (c >> 12)));
+            out.push_back((char) (0x80 | ((c >> 6) & 0x3F)));
+            out.push_back((char) (0x80 | (c & 0x3F)));
+        } else {
+            out.push_back((char) (0xF0 | (c >> 18)));
+            out.push_back((char) (0x80 | ((c >> 12) & 0x3F)));
+            out.push_back((char) (0x80 | ((c >> 6) & 0x3F)));
+            out.push_back((char) (0x80 | (c & 0x3F)));
+        }
+    }
+}
+
+// Writer thread: encodes the queued page texts to UTF-8 and writes them in page order
+static void *writeExtractedText(void *arg) {
+    TextExtraction *extraction = static_cast<TextExtraction *>(arg);
+    std::string buffer;
+    buffer.reserve(kExtractWriteBuffer * 2);
+    std::vector<SearchText *> pages;
+    bool ok = true;
+
+    while (true) {
+        pthread_mutex_lock(&extraction->lock);
+        while (extraction->queue.empty() && !extraction->finished) {
+            pthread_cond_wait(&extraction->changed, &extraction->lock);
+        }
+        pages.swap(extraction->queue);
+        bool finished = extraction->finished;
+        pthread_mutex_unlock(&extraction->lock);
+
+        size_t released = 0;
+        for (size_t i = 0; i < pages.size(); i++) {
+            if (ok) appendUtf16AsUtf8(buffer, pages[i]->data(), pages[i]->size());
+            released += pages[i]->size() * sizeof(unsigned short);
+            delete pages[i];
+            if (ok && buffer.size() >= kExtractWriteBuffer) {
+                ok = writeFully(extraction->fd, buffer.data(), buffer.size());
+                if (ok) extraction->bytesWritten += (int64_t) buffer.size();
+                buffer.clear();
+            }
+        }
+        pages.clear();
+
+        pthread_mutex_lock(&extraction->lock);
+        extraction->queuedBytes -= released;
+        if (!ok) extraction->failed = true;
+        pthread_cond_broadcast(&extraction->changed);
+        pthread_mutex_unlock(&extraction->lock);
+
+        if (finished) break;
+    }
+
+    if (ok && !buffer.empty()) {
+        ok = writeFully(extraction->fd, buffer.data(), buffer.size());
+        if (ok) extraction->bytesWritten += (int64_t) buffer.size();
+    }
+    if (!ok) extraction->failed = true;
+    return NULL;
+}
+
+// Queues a page text for the writer, waiting while the queue is full. Returns false once the
+// writer has failed.
+static bool queueExtractedText(TextExtraction *extraction, SearchText *text) {
+    size_t bytes = text->size() * sizeof(unsigned short);
+    pthread_mutex_lock(&extraction->lock);
+    while (!extraction->failed && !extraction->queue.empty() &&
+           extraction->queuedBytes + bytes > kExtractQueueBytes) {
+        pthread_cond_wait(&extraction->changed, &extraction->lock);
+    }
+    bool ok = !extraction->failed;
+    if (ok) {
+        extraction->queue.push_back(text);
+        extraction->queuedBytes += bytes;
+        pthread_cond_broadcast(&extraction->changed);
+    }
+    pthread_mutex_unlock(&extraction->lock);
+    if (!ok) delete text;
+    return ok;
+}
+
+// Extracts the text of pages fromPage..toPage and writes it to fd as UTF-8, each page followed
+// by separator. Text is read on the calling thread, pdfium not being thread safe, while a writer
+// thread encodes and writes the previous pages. PdfiumCore.onTextExtractionProgress is called
+// after every page and returns false to cancel. Returns the number of bytes written, -1 if
+// cancelled or -2 if writing failed.
+JNI_FUNC(jlong, PdfiumCore, nativeExtractText)(JNI_ARGS, jlong docPtr, jint fd, jint fromPage,
+                                               jint toPage, jstring separator) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (doc == NULL || doc->pdfDocument == NULL || fd < 0) return -2;
+
+    jclass clazz = env->GetObjectClass(thiz);
+    jmethodID callback = env->GetMethodID(clazz, "onTextExtractionProgress", "(II)Z");
+    if (callback == NULL) return -2;
+
+    SearchText pageSeparator;
+    if (separator != NULL) {
+        const jchar *raw = env->GetStringChars(separator, NULL);
+        if (raw != NULL) {
+            pageSeparator.assign(raw, raw + env->GetStringLength(separator));
+            env->ReleaseStringChars(separator, raw);
+        }
+    }
+
+    int pageCount = FPDF_GetPageCount(doc->pdfDocument);
+    int first = fromPage < 0 ? 0 : (int) fromPage;
+    int last = toPage >= pageCount ? pageCount - 1 : (int) toPage;
+
+    TextExtraction extraction;
+    extraction.fd = fd;
+    pthread_mutex_init(&extraction.lock, NULL);
+    pthread_cond_init(&extraction.changed, NULL);
+    extraction.queuedBytes = 0;
+    extraction.finished = false;
+    extraction.failed = false;
+    extraction.bytesWritten = 0;
+
+    pthread_t writer;
+    if (pthread_create(&writer, NULL, writeExtractedText, &extraction) != 0) {
+        pthread_cond_destroy(&extraction.changed);
+        pthread_mutex_destroy(&extraction.lock);
+        return -2;
+    }
+
+    bool cancelled = false;
+    for (int pageIndex = first; pageIndex <= last; pageIndex++) {
+        SearchText *text = new SearchText();
+        readSearchPageText(doc, pageIndex, false, *text);
+        text->insert(text->end(), pageSeparator.begin(), pageSeparator.end());
+        if (!queueExtractedText(&extraction, text)) break;
+
+        jboolean proceed = env->CallBooleanMethod(thiz, callback, (jint) (pageIndex - first + 1),
+                                                  (jint) (last - first + 1));
+        if (env->ExceptionCheck() || !proceed) {
+            cancelled = true;
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&extraction.lock);
+    extraction.finished = true;
+    pthread_cond_broadcast(&extraction.changed);
+    pthread_mutex_unlock(&extraction.lock);
+    pthread_join(writer, NULL);
+
+    for (size_t i = 0; i < extraction.queue.size(); i++) delete extraction.queue[i];
+    pthread_cond_destroy(&extraction.changed);
+    pthread_mutex_destroy(&extraction.lock);
+
+    if (extraction.failed) return -2;
+    if (cancelled) return -1;
+    return (jlong) extraction.bytesWritten;
+}
+
+//////////////////////////////////////////
+// Begin PDF Annotation api
+//////////////////////////////////////////
+
+// Annotations the viewer draws itself from their properties, see nativeGetPageAnnotationTable
+static bool isOverlayAnnotation(FPDF_ANNOTATION_SUBTYPE subtype) {
+    switch (subtype) {
+        case FPDF_ANNOT_LINE:
+        case FPDF_ANNOT_SQUARE:
+        case FPDF_ANNOT_CIRCLE:
+        case FPDF_ANNOT_POLYGON:
+        case FPDF_ANNOT_POLYLINE:
+        case FPDF_ANNOT_HIGHLIGHT:
+        case FPDF_ANNOT_UNDERLINE:
+        case FPDF_ANNOT_SQUIGGLY:
+        case FPDF_ANNOT_STRIKEOUT:
+        case FPDF_ANNOT_INK:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static jint annotationColor(FPDF_ANNOTATION annot, FPDFANNOT_COLORTYPE type) {
+    unsigned int r = 0, g = 0, b = 0, a = 0;
+    if (!FPDFAnnot_GetColor(annot, type, &r, &g, &b, &a)) return 0;
+    return (jint) ((a << 24) | (r << 16) | (g << 8) | b);
+}
+
+// Appends a point of the page as fractions of the displayed page
+static void pushPagePoint(FPDF_PAGE page, std::vector<jfloat> *geometry, float x, float y) {
+    int deviceX, deviceY;
+    FPDF_PageToDevice(page, 0, 0, kBoundsScale, kBoundsScale, 0, x, y, &deviceX, &deviceY);
+    geometry->push_back((jfloat) deviceX / kBoundsScale);
+    geometry->push_back((jfloat) deviceY / kBoundsScale);
+}
+
+// Appends a path as its point count followed by its points
+static void pushPath(FPDF_PAGE page, std::vector<jfloat> *geometry, const FS_POINTF *points,
+                     size_t count) {
+    geometry->push_back((jfloat) count);
+    for (size_t i = 0; i < count; i++) pushPagePoint(page, geometry, points[i].x, points[i].y);
+}
+
+// Appends the paths of an annotation: its quads, ink strokes, line or vertices
+static int pushAnnotationPaths(FPDF_PAGE page, FPDF_ANNOTATION annot,
+                               FPDF_ANNOTATION_SUBTYPE subtype, std::vector<jfloat> *geometry) {
+    std::vector<FS_POINTF> points;
+    switch (subtype) {
+        case FPDF_ANNOT_HIGHLIGHT:
+        case FPDF_ANNOT_UNDERLINE:
+        case FPDF_ANNOT_SQUIGGLY:
+        case FPDF_ANNOT_STRIKEOUT: {
+            size_t count = FPDFAnnot_CountAttachmentPoints(annot);
+            int paths = 0;
+            for (size_t i = 0; i < count; i++) {
+                FS_QUADPOINTSF quad;
+                if (!FPDFAnnot_GetAttachmentPoints(annot, i, &quad)) continue;
+                // Top left, top right, bottom left and bottom right
+                FS_POINTF corners[4] = {{quad.x1, quad.y1}, {quad.x2, quad.y2},
+                                        {quad.x3, quad.y3}, {quad.x4, quad.y4}};
+                pushPath(page, geometry, corners, 4);
+                paths++;
+            }
+            return paths;
+        }
+        case FPDF_ANNOT_INK: {
+            unsigned long count = FPDFAnnot_GetInkListCount(annot);
+            for (unsigned long i = 0; i < count; i++) {
+                unsigned long length = FPDFAnnot_GetInkListPath(annot, i, NULL, 0);
+                points.resize(length);
+                if (length > 0) FPDFAnnot_GetInkListPath(annot, i, points.data(), length);
+                pushPath(page, geometry, points.data(), length);
+            }
+            return (int) count;
+        }
+        case FPDF_ANNOT_LINE: {
+            FS_POINTF line[2];
+            if (!FPDFAnnot_GetLine(annot, &line[0], &line[1])) return 0;
+            pushPath(page, geometry, line, 2);
+            return 1;
+        }
+        case FPDF_ANNOT_POLYGON:
+        case FPDF_ANNOT_POLYLINE: {
+            unsigned long length = FPDFAnnot_GetVertices(annot, NULL, 0);
+            if (length == 0) return 0;
+            points.resize(length);
+            FPDFAnnot_GetVertices(annot, points.data(), length);
+            pushPath(page, geometry, points.data(), length);
+            return 1;
+        }
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Returns the annotations of a page that the viewer draws itself, in a separate layer above the
+ * page content, as {int[] info, float[] geometry}.
+ *
+ * info starts with 1 when every visible annotation of the page is in the table, then the page
+ * content can be rendered without annotations. It is 0 when some annotation can only be drawn
+ * by pdfium, like widgets, stamps or any annotation with its own appearance stream. Then come
+ * five ints per annotation: index on the page, subtype, color and interior color as ARGB (0 when
+ * unset) and the offset of its geometry.
+ *
+ * The geometry of an annotation is its rect (left, top, right, bottom), its border width, its
+ * path count and each path as a point count followed by x, y pairs. Lengths are fractions of
+ * the displayed page, the border width is a fraction of its width.
+ */
+JNI_FUNC(jobjectArray, PdfiumCore, nativeGetPageAnnotationTable)(JNI_ARGS, jlong pagePtr) {
+    FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    if (page == NULL) return NULL;
+
+    float pageWidth = FPDF_GetPageWidthF(page);
+    std::vector<jint> info(1, 1);
+    std::vector<jfloat> geometry;
+    int count = FPDFPage_GetAnnotCount(page);
+    for (int i = 0; i < count; i++) {
+        FPDF_ANNOTATION annot = FPDFPage_GetAnnot(page, i);
+        if (annot == NULL) continue;
+        FPDF_ANNOTATION_SUBTYPE subtype = FPDFAnnot_GetSubtype(annot);
+        int flags = FPDFAnnot_GetFlags(annot);
+        bool hidden = (flags & (FPDF_ANNOT_FLAG_HIDDEN | FPDF_ANNOT_FLAG_NOVIEW)) != 0;
+        // Links and popups have nothing to draw
+        if (hidden || subtype == FPDF_ANNOT_LINK || subtype == FPDF_ANNOT_POPUP) {
+            FPDFPage_CloseAnnot(annot);
+            continue;
+        }
+        // Colors can only be read from annotations without an appearance stream
+        jint color = isOverlayAnnotation(subtype) ? annotationColor(annot, FPDFANNOT_COLORTYPE_Color)
+                                                  : 0;
+        FS_RECTF rect;
+        if (color == 0 || !FPDFAnnot_GetRect(annot, &rect)) {
+            info[0] = 0;
+            FPDFPage_CloseAnnot(annot);
+            continue;
+        }
+
+        info.push_back(i);
+        info.push_back(subtype);
+        info.push_back(color);
+        info.push_back(FPDFAnnot_HasKey(annot, "IC")
+                       ? annotationColor(annot, FPDFANNOT_COLORTYPE_InteriorColor) : 0);
+        info.push_back((jint) geometry.size());
+
+        int x1, y1, x2, y2;
+        FPDF_PageToDevice(page, 0, 0, kBoundsScale, kBoundsScale, 0, rect.left, rect.top, &x1, &y1);
+        FPDF_PageToDevice(page, 0, 0, kBoundsScale, kBoundsScale, 0, rect.right, rect.bottom, &x2,
+                          &y2);
+        geometry.push_back((jfloat) (x1 < x2 ? x1 : x2) / kBoundsScale);
+        geometry.push_back((jfloat) (y1 < y2 ? y1 : y2) / kBoundsScale);
+        geometry.push_back((jfloat) (x1 < x2 ? x2 : x1) / kBoundsScale);
+        geometry.push_back((jfloat) (y1 < y2 ? y2 : y1) / kBoundsScale);
+
+        float radiusX, radiusY, borderWidth = 1;
+        if (!FPDFAnnot_GetBorder(annot, &radiusX, &radiusY, &borderWidth)) borderWidth = 1;
+        geometry.push_back(pageWidth > 0 ? borderWidth / pageWidth : 0);
+
+        size_t pathCountAt = geometry.size();
+        geometry.push_back(0);
+        geometry[pathCountAt] = (jfloat) pushAnnotationPaths(page, annot, subtype, &geometry);
+        FPDFPage_CloseAnnot(annot);
+    }
+
+    jclass objectClass = env->FindClass("java/lang/Object");
+    jobjectArray result = env->NewObjectArray(2, objectClass, NULL);
+    jintArray javaInfo = env->NewIntArray((jsize) info.size());
+    jfloatArray javaGeometry = env->NewFloatArray((jsize) geometry.size());
+    if (result == NULL || javaInfo == NULL || javaGeometry == NULL) return NULL;
+
+    env->SetIntArrayRegion(javaInfo, 0, (jsize) info.size(), info.data());
+    if (!geometry.empty()) {
+        env->SetFloatArrayRegion(javaGeometry, 0, (jsize) geometry.size(), geometry.data());
+    }
+    env->SetObjectArrayElement(result, 0, javaInfo);
+    env->SetObjectArrayElement(result, 1, javaGeometry);
+    return result;
+}
+
+// Edits of nativeApplyAnnotationEdits, see AnnotationTransaction
+enum AnnotationEditKind {
+    ANNOTATION_EDIT_ADD = 0,
+    ANNOTATION_EDIT_UPDATE,
+    ANNOTATION_EDIT_REMOVE,
+};
+
+// Fields set by an edit, values are read in this order
+enum AnnotationEditField {
+    ANNOTATION_FIELD_COLOR = 1,
+    ANNOTATION_FIELD_INTERIOR_COLOR = 1 << 1,
+    ANNOTATION_FIELD_BOUNDS = 1 << 2,
+    ANNOTATION_FIELD_BORDER = 1 << 3,
+    ANNOTATION_FIELD_CONTENTS = 1 << 4,
+    ANNOTATION_FIELD_PATHS = 1 << 5,
+};
+
+// kind, index, subtype, color, interior color, fields and the offset of its values
+static const int kAnnotationEditSize = 7;
+
+// Converts a point given as fractions of the displayed page to page space
+static FS_POINTF pagePointFromFraction(FPDF_PAGE page, float x, float y) {
+    double pageX = 0, pageY = 0;
+    FPDF_DeviceToPage(page, 0, 0, kBoundsScale, kBoundsScale, 0, (int) (x * kBoundsScale + 0.5f),
+                      (int) (y * kBoundsScale + 0.5f), &pageX, &pageY);
+    FS_POINTF point = {(float) pageX, (float) pageY};
+    return point;
+}
+
+// Grows dirty (left, top, right, bottom fractions of the displayed page) by the rect of annot
+static void unionAnnotationBounds(FPDF_PAGE page, FPDF_ANNOTATION annot, jfloat *dirty,
+                                  bool *hasDirty) {
+    FS_RECTF rect;
+    if (!FPDFAnnot_GetRect(annot, &rect)) return;
+    int x1, y1, x2, y2;
+    FPDF_PageToDevice(page, 0, 0, kBoundsScale, kBoundsScale, 0, rect.left, rect.top, &x1, &y1);
+    FPDF_PageToDevice(page, 0, 0, kBoundsScale, kBoundsScale, 0, rect.right, rect.bottom, &x2, &y2);
+    jfloat bounds[4] = {(jfloat) (x1 < x2 ? x1 : x2) / kBoundsScale,
+                        (jfloat) (y1 < y2 ? y1 : y2) / kBoundsScale,
+                        (jfloat) (x1 < x2 ? x2 : x1) / kBoundsScale,
+                        (jfloat) (y1 < y2 ? y2 : y1) / kBoundsScale};
+    if (!*hasDirty) {
+        memcpy(dirty, bounds, sizeof(bounds));
+        *hasDirty = true;
+        return;
+    }
+    if (bounds[0] < dirty[0]) dirty[0] = bounds[0];
+    if (bounds[1] < dirty[1]) dirty[1] = bounds[1];
+    if (bounds[2] > dirty[2]) dirty[2] = bounds[2];
+    if (bounds[3] > dirty[3]) dirty[3] = bounds[3];
+}
+
+static bool setAnnotationColor(FPDF_ANNOTATION annot, FPDFANNOT_COLORTYPE type, jint argb) {
+    return FPDFAnnot_SetColor(annot, type, (argb >> 16) & 0xFF, (argb >> 8) & 0xFF, argb & 0xFF,
+                              (argb >> 24) & 0xFF);
+}
+
+// Adds the quads or ink strokes of a new annotation, pdfium cannot set lines nor vertices
+static bool addAnnotationPaths(FPDF_PAGE page, FPDF_ANNOTATION annot,
+                               FPDF_ANNOTATION_SUBTYPE subtype, const std::vector<jfloat> &values,
+                               size_t *cursor) {
+    if (*cursor >= values.size()) return false;
+    int pathCount = (int) values[(*cursor)++];
+    std::vector<FS_POINTF> points;
+    for (int path = 0; path < pathCount; path++) {
+        if (*cursor >= values.size()) return false;
+        size_t count = (size_t) values[(*cursor)++];
+        if (*cursor + count * 2 > values.size()) return false;
+        points.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            points[i] = pagePointFromFraction(page, values[*cursor + i * 2],
+                                              values[*cursor + i * 2 + 1]);
+        }
+        *cursor += count * 2;
+
+        switch (subtype) {
+            case FPDF_ANNOT_HIGHLIGHT:
+            case FPDF_ANNOT_UNDERLINE:
+            case FPDF_ANNOT_SQUIGGLY:
+            case FPDF_ANNOT_STRIKEOUT: {
+                if (count != 4) return false;
+                // Top left, top right, bottom left and bottom right
+                FS_QUADPOINTSF quad = {points[0].x, points[0].y, points[1].x, points[1].y,
+                                       points[2].x, points[2].y, points[3].x, points[3].y};
+                if (!FPDFAnnot_AppendAttachmentPoints(annot, &quad)) return false;
+                break;
+            }
+            case FPDF_ANNOT_INK:
+                if (FPDFAnnot_AddInkStroke(annot, points.data(), count) < 0) return false;
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+// Annotations pdfium draws from their properties once their appearance stream is dropped
+static bool isRegenerableAnnotation(FPDF_ANNOTATION_SUBTYPE subtype) {
+    switch (subtype) {
+        case FPDF_ANNOT_TEXT:
+        case FPDF_ANNOT_POPUP:
+        case FPDF_ANNOT_SQUARE:
+        case FPDF_ANNOT_CIRCLE:
+        case FPDF_ANNOT_HIGHLIGHT:
+        case FPDF_ANNOT_UNDERLINE:
+        case FPDF_ANNOT_SQUIGGLY:
+        case FPDF_ANNOT_STRIKEOUT:
+        case FPDF_ANNOT_INK:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Sets the fields of an edit, reading its values from cursor
+static bool setAnnotationFields(JNIEnv *env, FPDF_PAGE page, FPDF_ANNOTATION annot,
+                                const jint *edit, const std::vector<jfloat> &values,
+                                size_t cursor, jstring contents) {
+    int fields = edit[5];
+    // Colors and geometry cannot be changed while an appearance stream draws the annotation.
+    // Other subtypes, like stamps, free text and widgets, would be left with nothing to draw.
+    if ((fields & ~ANNOTATION_FIELD_CONTENTS) != 0) {
+        if (!isRegenerableAnnotation(FPDFAnnot_GetSubtype(annot))) return false;
+        FPDFAnnot_SetAP(annot, FPDF_ANNOT_APPEARANCEMODE_NORMAL, NULL);
+    }
+    if ((fields & ANNOTATION_FIELD_COLOR) &&
+        !setAnnotationColor(annot, FPDFANNOT_COLORTYPE_Color, edit[3])) {
+        return false;
+    }
+    if ((fields & ANNOTATION_FIELD_INTERIOR_COLOR) &&
+        !setAnnotationColor(annot, FPDFANNOT_COLORTYPE_InteriorColor, edit[4])) {
+        return false;
+    }
+    if (fields & ANNOTATION_FIELD_BOUNDS) {
+        if (cursor + 4 > values.size()) return false;
+        FS_POINTF topLeft = pagePointFromFraction(page, values[cursor], values[cursor + 1]);
+        FS_POINTF bottomRight = pagePointFromFraction(page, values[cursor + 2],
+                                                      values[cursor + 3]);
+        cursor += 4;
+        FS_RECTF rect;
+        rect.left = topLeft.x < bottomRight.x ? topLeft.x : bottomRight.x;
+        rect.right = topLeft.x < bottomRight.x ? bottomRight.x : topLeft.x;
+        rect.bottom = topLeft.y < bottomRight.y ? topLeft.y : bottomRight.y;
+        rect.top = topLeft.y < bottomRight.y ? bottomRight.y : topLeft.y;
+        if (!FPDFAnnot_SetRect(annot, &rect)) return false;
+    }
+    if (fields & ANNOTATION_FIELD_BORDER) {
+        if (cursor >= values.size()) return false;
+        float width = values[cursor++] * FPDF_GetPageWidthF(page);
+        if (!FPDFAnnot_SetBorder(annot, 0, 0, width)) return false;
+    }
+    if ((fields & ANNOTATION_FIELD_CONTENTS) && contents != NULL) {
+        unsigned short *text = convertWideString(env, contents);
+        bool set = text != NULL && FPDFAnnot_SetStringValue(annot, kContentsKey, text);
+        free(text);
+        if (!set) return false;
+    }
+    if ((fields & ANNOTATION_FIELD_PATHS) &&
+        !addAnnotationPaths(page, annot, FPDFAnnot_GetSubtype(annot), values, &cursor)) {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Applies a batch of annotation edits to an opened page, in memory and in order, so indices refer
+ * to the annotations as the previous edits left them. The page stays open and nothing is saved.
+ *
+ * Each edit is seven ints: kind, annotation index, subtype, color, interior color, the set of
+ * fields it sets and the offset of their values, see AnnotationEditField. texts holds the
+ * contents of each edit.
+ *
+ * Returns {int[] indices, float[] dirty}: the index of the annotation each edit added, updated
+ * or removed, -1 if it failed, and the union of the rects of every annotation touched, before and
+ * after the edits, as fractions of the displayed page. dirty is empty if nothing changed.
+ */
+JNI_FUNC(jobjectArray, PdfiumCore, nativeApplyAnnotationEdits)(JNI_ARGS, jlong pagePtr,
+                                                               jintArray edits_,
+                                                               jfloatArray values_,
+                                                               jobjectArray texts) {
+    FPDF_PAGE page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    if (page == NULL) return NULL;
+
+    jsize editInts = env->GetArrayLength(edits_);
+    std::vector<jint> edits((size_t) editInts);
+    if (editInts > 0) env->GetIntArrayRegion(edits_, 0, editInts, edits.data());
+    jsize valueCount = env->GetArrayLength(values_);
+    std::vector<jfloat> values((size_t) valueCount);
+    if (valueCount > 0) env->GetFloatArrayRegion(values_, 0, valueCount, values.data());
+
+    int count = editInts / kAnnotationEditSize;
+    std::vector<jint> indices((size_t) count, -1);
+    jfloat dirty[4] = {0, 0, 0, 0};
+    bool hasDirty = false;
+    for (int i = 0; i < count; i++) {
+        const jint *edit = &edits[(size_t) i * kAnnotationEditSize];
+        size_t cursor = (size_t) edit[6];
+        jstring contents = (jstring) env->GetObjectArrayElement(texts, i);
+        switch (edit[0]) {
+            case ANNOTATION_EDIT_ADD: {
+                FPDF_ANNOTATION annot = FPDFPage_CreateAnnot(page, edit[2]);
+                if (annot == NULL) break;
+                int index = FPDFPage_GetAnnotCount(page) - 1;
+                bool set = setAnnotationFields(env, page, annot, edit, values, cursor, contents);
+                if (set) unionAnnotationBounds(page, annot, dirty, &hasDirty);
+                FPDFPage_CloseAnnot(annot);
+                if (set) {
+                    indices[i] = index;
+                } else {
+                    FPDFPage_RemoveAnnot(page, index);
+                }
+                break;
+            }
+            case ANNOTATION_EDIT_UPDATE: {
+                FPDF_ANNOTATION annot = FPDFPage_GetAnnot(page, edit[1]);
+                if (annot == NULL) break;
+                unionAnnotationBounds(page, annot, dirty, &hasDirty);
+                if (setAnnotationFields(env, page, annot, edit, values, cursor, contents)) {
+                    indices[i] = edit[1];
+                }
+                unionAnnotationBounds(page, annot, dirty, &hasDirty);
+                FPDFPage_CloseAnnot(annot);
+                break;
+            }
+            case ANNOTATION_EDIT_REMOVE: {
+                FPDF_ANNOTATION annot = FPDFPage_GetAnnot(page, edit[1]);
+                if (annot == NULL) break;
+                unionAnnotationBounds(page, annot, dirty, &hasDirty);
+                FPDFPage_CloseAnnot(annot);
+                if (FPDFPage_RemoveAnnot(page, edit[1])) indices[i] = edit[1];
+                break;
+            }
+            default:
+                break;
+        }
+        if (contents != NULL) env->DeleteLocalRef(contents);
+    }
+
+    jclass objectClass = env->FindClass("java/lang/Object");
+    jobjectArray result = env->NewObjectArray(2, objectClass, NULL);
+    jintArray javaIndices = env->NewIntArray(count);
+    jfloatArray javaDirty = env->NewFloatArray(hasDirty ? 4 : 0);
+    if (result == NULL || javaIndices == NULL || javaDirty == NULL) return NULL;
+
+    if (count > 0) env->SetIntArrayRegion(javaIndices, 0, count, indices.data());
+    if (hasDirty) env->SetFloatArrayRegion(javaDirty, 0, 4, dirty);
+    env->SetObjectArrayElement(result, 0, javaIndices);
+    env->SetObjectArrayElement(result, 1, javaDirty);
+    return result;
+}
+
+//////////////////////////////////////////
+// Begin PDF Save api
+//////////////////////////////////////////
+
+// Saved bytes are buffered into chunks of this size, allocated on this alignment. Every write but
+// the last is a whole chunk, so writes also land on chunk boundaries of the file.
+static const size_t kSaveChunkSize = 1024 * 1024;
+static const size_t kSaveChunkAlignment = 4096;
+
+// An FPDF_FILEWRITE writing to a file descriptor through a single chunk buffer, so the memory
+// used is the same whatever the document size
+struct FdFileWrite : FPDF_FILEWRITE {
+    int fd;
+    char *chunk;
+    size_t used;
+    int64_t bytesWritten;
+    bool failed;
+};
+
+static bool flushFileWrite(FdFileWrite *writer) {
+    if (writer->used == 0) return true;
+    if (!writeFully(writer->fd, writer->chunk, writer->used)) return false;
+    writer->bytesWritten += (int64_t) writer->used;
+    writer->used = 0;
+    return true;
+}
+
+static int writeFileBlock(FPDF_FILEWRITE *pThis, const void *data, unsigned long size) {
+    FdFileWrite *writer = static_cast<FdFileWrite *>(pThis);
+    const char *bytes = static_cast<const char *>(data);
+    while (!writer->failed && size > 0) {
+        // Blocks of whole chunks, like large images, skip the copy when the chunk is empty
+        if (writer->used == 0 && size >= kSaveChunkSize) {
+            size_t direct = size - size % kSaveChunkSize;
+            if (!writeFully(writer->fd, bytes, direct)) {
+                writer->failed = true;
+                break;
+            }
+            writer->bytesWritten += (int64_t) direct;
+            bytes += direct;
+            size -= direct;
+            continue;
+        }
+        size_t copied = kSaveChunkSize - writer->used;
+        if (copied > size) copied = size;
+        memcpy(writer->chunk + writer->used, bytes, copied);
+        writer->used += copied;
+        bytes += copied;
+        size -= copied;
+        if (writer->used == kSaveChunkSize && !flushFileWrite(writer)) writer->failed = true;
+    }
+    return writer->failed ? 0 : 1;
+}
+
+static int64_t elapsedNanos(const struct timespec &start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) (now.tv_sec - start.tv_sec) * 1000000000LL + (now.tv_nsec - start.tv_nsec);
+}
+
+/**
+ * Saves the document to fd, which must not be the file the document was read from. An
+ * incremental save copies the original file as it is and appends only the objects changed since
+ * it was opened, a full save writes every object again.
+ *
+ * Returns {bytes written, elapsed nanoseconds}, or null if saving failed.
+ */
+JNI_FUNC(jlongArray, PdfiumCore, nativeSaveToFd)(JNI_ARGS, jlong docPtr, jint fd,
+                                                 jboolean incremental) {
+    DocumentFile *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (doc == NULL || doc->pdfDocument == NULL) {
+        LOGE("Document is null");
+        throwPdfiumException1(env, "Document is null");
+        return NULL;
+    }
+    if (fd < 0) return NULL;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    FdFileWrite writer;
+    writer.version = 1;
+    writer.WriteBlock = writeFileBlock;
+    writer.fd = fd;
+    writer.chunk = NULL;
+    writer.used = 0;
+    writer.bytesWritten = 0;
+    writer.failed = false;
+    void *chunk = NULL;
+    if (posix_memalign(&chunk, kSaveChunkAlignment, kSaveChunkSize) != 0) return NULL;
+    writer.chunk = static_cast<char *>(chunk);
+
+    FPDF_DWORD flags = incremental ? FPDF_INCREMENTAL : FPDF_NO_INCREMENTAL;
+    bool saved = FPDF_SaveAsCopy(doc->pdfDocument, &writer, flags) && !writer.failed &&
+                 flushFileWrite(&writer);
+    free(chunk);
+    if (!saved) {
+        LOGE("Saving the document failed");
+        return NULL;
+    }
+
+    jlong stats[2] = {(jlong) writer.bytesWritten, (jlong) elapsedNanos(start)};
+    jlongArray result = env->NewLongArray(2);
+    if (result == NULL) return NULL;
+    env->SetLongArrayRegion(result, 0, 2, stats);
+    return result;
 }
 
 const char *getPdfiumErrorMessage(int errCode) {
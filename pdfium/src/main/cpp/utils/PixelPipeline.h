@@ -0,0 +1,340 @@
+//
+// Pixel pipeline of the rendered tiles: building the passes from the stages of a
+// com.harissk.pdfium.PixelPipeline and running them over a bitmap. Free of JNI and pdfium so the
+// kernels can be built and compared on the host, see pdfium/src/benchmark/cpp.
+//
+#ifndef PDFIUM_PIXEL_PIPELINE_H
+#define PDFIUM_PIXEL_PIPELINE_H
+
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#ifndef HWCAP_NEON
+#define HWCAP_NEON (1 << 12)
+#endif
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Pixel pipeline of nativeRenderPageBitmap. Stages come from PixelPipeline.stages as groups of
+// PIXEL_STAGE_SIZE floats: the stage type followed by its parameters.
+#define PIXEL_STAGE_SIZE 7
+
+enum {
+    PIXEL_STAGE_INVERT = 1,
+    PIXEL_STAGE_INVERT_LUMINANCE = 2,
+    PIXEL_STAGE_GRAYSCALE = 3,
+    PIXEL_STAGE_TONE = 4,
+    PIXEL_STAGE_TINT = 5,
+};
+
+// Rec. 601 luma weights, they sum to 1 so that gray levels stay within alpha
+static const double kLumaWeights[3] = {0.299, 0.587, 0.114};
+
+/**
+ * One pass over the pixels. Affine stages compute every colour channel as a weighted sum of
+ * red, green, blue and alpha in Q8 fixed point, which also transforms premultiplied colours
+ * correctly, then clamp it to [0, alpha]. Curve stages map each straight channel through a table.
+ */
+struct PixelStage {
+    bool isCurve;
+    int16_t coefficients[12];  // red, green, blue and alpha weights of each output channel
+    uint8_t curve[256];
+};
+
+typedef std::vector<PixelStage> PixelPipeline;
+
+// Affine transform in floating point, composed before it is quantized
+struct AffineTransform {
+    double matrix[12];
+    bool keepsRange;  // outputs always lie within [0, alpha], so no clamping is lost by fusing
+};
+
+static inline AffineTransform identityTransform() {
+    AffineTransform transform;
+    for (int i = 0; i < 12; i++) transform.matrix[i] = (i % 5 == 0) ? 1.0 : 0.0;
+    transform.keepsRange = true;
+    return transform;
+}
+
+// Returns second applied after first
+static inline AffineTransform composeTransforms(const AffineTransform &first,
+                                                const AffineTransform &second) {
+    AffineTransform result;
+    for (int c = 0; c < 3; c++) {
+        for (int j = 0; j < 4; j++) {
+            double value = (j == 3) ? second.matrix[c * 4 + 3] : 0.0;
+            for (int k = 0; k < 3; k++) {
+                value += second.matrix[c * 4 + k] * first.matrix[k * 4 + j];
+            }
+            result.matrix[c * 4 + j] = value;
+        }
+    }
+    result.keepsRange = second.keepsRange;
+    return result;
+}
+
+static inline PixelStage quantizeTransform(const AffineTransform &transform) {
+    PixelStage stage;
+    stage.isCurve = false;
+    for (int i = 0; i < 12; i++) {
+        long value = lround(transform.matrix[i] * 256.0);
+        stage.coefficients[i] = (int16_t) (value < -32768 ? -32768 : (value > 32767 ? 32767 : value));
+    }
+    return stage;
+}
+
+static inline uint8_t clampToByte(double value) {
+    return (uint8_t) (value <= 0 ? 0 : (value >= 255 ? 255 : lround(value)));
+}
+
+/**
+ * Builds the passes of a pipeline. Consecutive affine stages are fused into a single pass
+ * whenever the first cannot go out of range, so that presets cost one pass over the tile.
+ */
+static inline void buildPixelPipeline(const float *stages, int count, PixelPipeline *pipeline) {
+    AffineTransform pending = identityTransform();
+    bool hasPending = false;
+    for (int i = 0; i + PIXEL_STAGE_SIZE <= count; i += PIXEL_STAGE_SIZE) {
+        const float *params = stages + i + 1;
+        AffineTransform transform = identityTransform();
+        switch ((int) stages[i]) {
+            case PIXEL_STAGE_INVERT:
+                for (int c = 0; c < 3; c++) {
+                    transform.matrix[c * 5] = -1.0;
+                    transform.matrix[c * 4 + 3] = 1.0;
+                }
+                break;
+            case PIXEL_STAGE_INVERT_LUMINANCE:
+                // Moves every channel by the same amount, so that colour differences are kept
+                for (int c = 0; c < 3; c++) {
+                    for (int j = 0; j < 3; j++) {
+                        transform.matrix[c * 4 + j] = (c == j ? 1.0 : 0.0) - 2 * kLumaWeights[j];
+                    }
+                    transform.matrix[c * 4 + 3] = 1.0;
+                }
+                transform.keepsRange = false;
+                break;
+            case PIXEL_STAGE_GRAYSCALE:
+                for (int c = 0; c < 3; c++) {
+                    for (int j = 0; j < 3; j++) transform.matrix[c * 4 + j] = kLumaWeights[j];
+                }
+                break;
+            case PIXEL_STAGE_TONE: {
+                double gamma = params[0] > 0 ? params[0] : 1.0;
+                double contrast = params[1] >= 0 ? params[1] : 1.0;
+                if (gamma != 1.0) {
+                    // Gamma is not linear, it takes a table pass of its own
+                    if (hasPending) pipeline->push_back(quantizeTransform(pending));
+                    pending = identityTransform();
+                    hasPending = false;
+                    PixelStage stage;
+                    stage.isCurve = true;
+                    for (int v = 0; v < 256; v++) {
+                        double level = pow(v / 255.0, 1.0 / gamma);
+                        stage.curve[v] = clampToByte(((level - 0.5) * contrast + 0.5) * 255.0);
+                    }
+                    pipeline->push_back(stage);
+                    continue;
+                }
+                for (int c = 0; c < 3; c++) {
+                    transform.matrix[c * 5] = contrast;
+                    transform.matrix[c * 4 + 3] = (1.0 - contrast) / 2;
+                }
+                transform.keepsRange = contrast <= 1.0;
+                break;
+            }
+            case PIXEL_STAGE_TINT:
+                // Black goes to the ink colour and white to the paper colour
+                for (int c = 0; c < 3; c++) {
+                    transform.matrix[c * 5] = (params[c] - params[3 + c]) / 255.0;
+                    transform.matrix[c * 4 + 3] = params[3 + c] / 255.0;
+                }
+                break;
+            default:
+                continue;
+        }
+        if (hasPending && !pending.keepsRange) {
+            pipeline->push_back(quantizeTransform(pending));
+            pending = transform;
+        } else {
+            pending = hasPending ? composeTransforms(pending, transform) : transform;
+        }
+        hasPending = true;
+    }
+    if (hasPending) pipeline->push_back(quantizeTransform(pending));
+}
+
+// Scalar reference of the affine pass, also used for the pixels left over by the vector kernels
+static inline void affinePixelsScalar(uint8_t *pixels, int count, int bytesPerPixel,
+                                      const int16_t *m) {
+    for (int i = 0; i < count; i++, pixels += bytesPerPixel) {
+        int red = pixels[0], green = pixels[1], blue = pixels[2];
+        int alpha = bytesPerPixel == 4 ? pixels[3] : 255;
+        for (int c = 0; c < 3; c++) {
+            const int16_t *w = m + c * 4;
+            int value = (w[0] * red + w[1] * green + w[2] * blue + w[3] * alpha + 128) >> 8;
+            pixels[c] = (uint8_t) (value < 0 ? 0 : (value > alpha ? alpha : value));
+        }
+    }
+}
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+static inline int16x8_t affineChannelNeon(const int16x8_t *channels, const int16_t *w,
+                                          int16x8_t alpha) {
+    int32x4_t low = vmull_n_s16(vget_low_s16(channels[0]), w[0]);
+    int32x4_t high = vmull_n_s16(vget_high_s16(channels[0]), w[0]);
+    for (int j = 1; j < 4; j++) {
+        low = vmlal_n_s16(low, vget_low_s16(channels[j]), w[j]);
+        high = vmlal_n_s16(high, vget_high_s16(channels[j]), w[j]);
+    }
+    int16x8_t value = vcombine_s16(vqrshrn_n_s32(low, 8), vqrshrn_n_s32(high, 8));
+    return vminq_s16(vmaxq_s16(value, vdupq_n_s16(0)), alpha);
+}
+
+// Eight pixels per iteration, deinterleaved into one register per channel
+static inline void affinePixelsNeon(uint8_t *pixels, int count, int bytesPerPixel,
+                                    const int16_t *m) {
+    int i = 0;
+    int16x8_t channels[4];
+    if (bytesPerPixel == 4) {
+        for (; i + 8 <= count; i += 8, pixels += 32) {
+            uint8x8x4_t px = vld4_u8(pixels);
+            for (int j = 0; j < 4; j++) {
+                channels[j] = vreinterpretq_s16_u16(vmovl_u8(px.val[j]));
+            }
+            for (int c = 0; c < 3; c++) {
+                px.val[c] = vqmovun_s16(affineChannelNeon(channels, m + c * 4, channels[3]));
+            }
+            vst4_u8(pixels, px);
+        }
+    } else {
+        channels[3] = vdupq_n_s16(255);
+        for (; i + 8 <= count; i += 8, pixels += 24) {
+            uint8x8x3_t px = vld3_u8(pixels);
+            for (int j = 0; j < 3; j++) {
+                channels[j] = vreinterpretq_s16_u16(vmovl_u8(px.val[j]));
+            }
+            for (int c = 0; c < 3; c++) {
+                px.val[c] = vqmovun_s16(affineChannelNeon(channels, m + c * 4, channels[3]));
+            }
+            vst3_u8(pixels, px);
+        }
+    }
+    affinePixelsScalar(pixels, count - i, bytesPerPixel, m);
+}
+#endif
+
+#if defined(__SSE2__)
+// Weighted sum of one output channel for four pixels whose channels are paired as 16-bit lanes
+static inline __m128i affineChannelSse2(__m128i redGreen, __m128i blueAlpha, const int16_t *w) {
+    __m128i weightsRedGreen = _mm_set1_epi32((int) ((uint16_t) w[0] | ((uint32_t) (uint16_t) w[1] << 16)));
+    __m128i weightsBlueAlpha = _mm_set1_epi32((int) ((uint16_t) w[2] | ((uint32_t) (uint16_t) w[3] << 16)));
+    __m128i sum = _mm_add_epi32(_mm_madd_epi16(redGreen, weightsRedGreen),
+                                _mm_madd_epi16(blueAlpha, weightsBlueAlpha));
+    return _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(128)), 8);
+}
+
+// Eight RGBA pixels per iteration. SSE2 has no three-way deinterleave, RGB rows stay scalar.
+static inline void affinePixelsSse2(uint8_t *pixels, int count, int bytesPerPixel,
+                                    const int16_t *m) {
+    if (bytesPerPixel != 4) {
+        affinePixelsScalar(pixels, count, bytesPerPixel, m);
+        return;
+    }
+    const __m128i byteMask = _mm_set1_epi32(0xFF);
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 8 <= count; i += 8, pixels += 32) {
+        __m128i halves[2] = {_mm_loadu_si128((const __m128i *) pixels),
+                             _mm_loadu_si128((const __m128i *) (pixels + 16))};
+        __m128i redGreen[2], blueAlpha[2], alpha32[2];
+        for (int h = 0; h < 2; h++) {
+            __m128i v = halves[h];
+            __m128i red = _mm_and_si128(v, byteMask);
+            __m128i green = _mm_and_si128(_mm_srli_epi32(v, 8), byteMask);
+            __m128i blue = _mm_and_si128(_mm_srli_epi32(v, 16), byteMask);
+            alpha32[h] = _mm_srli_epi32(v, 24);
+            redGreen[h] = _mm_or_si128(red, _mm_slli_epi32(green, 16));
+            blueAlpha[h] = _mm_or_si128(blue, _mm_slli_epi32(alpha32[h], 16));
+        }
+        __m128i alpha = _mm_packs_epi32(alpha32[0], alpha32[1]);
+        __m128i out[3];
+        for (int c = 0; c < 3; c++) {
+            __m128i value = _mm_packs_epi32(affineChannelSse2(redGreen[0], blueAlpha[0], m + c * 4),
+                                            affineChannelSse2(redGreen[1], blueAlpha[1], m + c * 4));
+            out[c] = _mm_min_epi16(_mm_max_epi16(value, zero), alpha);
+        }
+        __m128i outRedGreen = _mm_or_si128(out[0], _mm_slli_epi16(out[1], 8));
+        __m128i outBlueAlpha = _mm_or_si128(out[2], _mm_slli_epi16(alpha, 8));
+        _mm_storeu_si128((__m128i *) pixels, _mm_unpacklo_epi16(outRedGreen, outBlueAlpha));
+        _mm_storeu_si128((__m128i *) (pixels + 16), _mm_unpackhi_epi16(outRedGreen, outBlueAlpha));
+    }
+    affinePixelsScalar(pixels, count - i, bytesPerPixel, m);
+}
+#endif
+
+typedef void (*AffinePixelsKernel)(uint8_t *, int, int, const int16_t *);
+
+/**
+ * Picks the widest kernel the CPU supports, once. The NEON kernel is only picked in builds with
+ * the PIXEL_PIPELINE_NEON CMake option: it has not been checked against the scalar reference on
+ * ARM yet, run scripts/run_native_benchmarks.sh there before turning it on.
+ */
+static inline AffinePixelsKernel selectAffinePixelsKernel() {
+#if defined(PIXEL_PIPELINE_NEON) && defined(__aarch64__)
+    return affinePixelsNeon;
+#elif defined(PIXEL_PIPELINE_NEON) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+    if (getauxval(AT_HWCAP) & HWCAP_NEON) return affinePixelsNeon;
+#elif defined(__SSE2__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) return affinePixelsSse2;
+#endif
+    return affinePixelsScalar;
+}
+
+static const AffinePixelsKernel sAffinePixelsKernel = selectAffinePixelsKernel();
+
+static inline void curvePixels(uint8_t *pixels, int count, int bytesPerPixel,
+                               const uint8_t *curve) {
+    for (int i = 0; i < count; i++, pixels += bytesPerPixel) {
+        int alpha = bytesPerPixel == 4 ? pixels[3] : 255;
+        if (alpha == 255) {
+            pixels[0] = curve[pixels[0]];
+            pixels[1] = curve[pixels[1]];
+            pixels[2] = curve[pixels[2]];
+        } else if (alpha != 0) {
+            // Premultiplied channels go through the curve as straight colours
+            for (int c = 0; c < 3; c++) {
+                int straight = pixels[c] * 255 / alpha;
+                pixels[c] = (uint8_t) (curve[straight > 255 ? 255 : straight] * alpha / 255);
+            }
+        }
+    }
+}
+
+/**
+ * Runs every pass of the pipeline over the pixels, row by row so that a row stays in cache
+ * between passes. bytesPerPixel is 3 for the opaque RGB scratch of RGB_565 bitmaps and 4 for
+ * premultiplied RGBA_8888 bitmaps.
+ */
+static inline void runPixelPipeline(const PixelPipeline &pipeline, void *pixels, int width,
+                                    int height, int stride, int bytesPerPixel) {
+    for (int y = 0; y < height; y++) {
+        uint8_t *row = (uint8_t *) pixels + (size_t) y * stride;
+        for (size_t s = 0; s < pipeline.size(); s++) {
+            const PixelStage &stage = pipeline[s];
+            if (stage.isCurve) {
+                curvePixels(row, width, bytesPerPixel, stage.curve);
+            } else {
+                sAffinePixelsKernel(row, width, bytesPerPixel, stage.coefficients);
+            }
+        }
+    }
+}
+
+#endif // PDFIUM_PIXEL_PIPELINE_H
@@ -0,0 +1,175 @@
+//
+// Uniform grid over the loose character boxes of a text page, used for hit-testing and selection
+// instead of pdfium's scan over every character. Free of JNI and pdfium so it can be built and
+// measured on the host, see pdfium/src/benchmark/cpp.
+//
+#ifndef PDFIUM_TEXT_SPATIAL_INDEX_H
+#define PDFIUM_TEXT_SPATIAL_INDEX_H
+
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+// Cell c holds the characters items[cellStart[c]] .. items[cellStart[c + 1] - 1], see
+// buildTextGrid.
+struct TextSpatialIndex {
+    std::vector<float> boxes;  // left, top, right, bottom per character, PDF user space
+    std::vector<int> cellStart;
+    std::vector<int> items;
+    float minX = 0, minY = 0, cellWidth = 1, cellHeight = 1;
+    int columns = 0, rows = 0;
+
+    int64_t bytes() const {
+        return (int64_t) (boxes.capacity() * sizeof(float) +
+                          (cellStart.capacity() + items.capacity()) * sizeof(int));
+    }
+};
+
+// Targets this many characters per grid cell, dense pages such as spreadsheets keep small cells
+static const int kCharsPerCell = 4;
+
+// Builds the grid over index->boxes, which hold the box of every character of the page
+static inline void buildTextGrid(TextSpatialIndex *index) {
+    int count = (int) (index->boxes.size() / 4);
+    float minX = 0, minY = 0, maxX = 0, maxY = 0;
+    bool any = false;
+    for (int i = 0; i < count; i++) {
+        const float *b = &index->boxes[(size_t) i * 4];
+        // Generated characters such as line breaks have empty boxes and are not indexed
+        if (b[2] <= b[0] || b[1] <= b[3]) continue;
+        if (!any) {
+            minX = b[0], maxX = b[2], minY = b[3], maxY = b[1];
+            any = true;
+        } else {
+            if (b[0] < minX) minX = b[0];
+            if (b[2] > maxX) maxX = b[2];
+            if (b[3] < minY) minY = b[3];
+            if (b[1] > maxY) maxY = b[1];
+        }
+    }
+    if (!any) return;
+
+    float width = maxX - minX > 1 ? maxX - minX : 1;
+    float height = maxY - minY > 1 ? maxY - minY : 1;
+    int cells = count / kCharsPerCell > 1 ? count / kCharsPerCell : 1;
+    int columns = (int) ceil(sqrt(cells * width / height));
+    if (columns < 1) columns = 1;
+    int rows = (cells + columns - 1) / columns;
+    if (rows < 1) rows = 1;
+
+    index->minX = minX;
+    index->minY = minY;
+    index->columns = columns;
+    index->rows = rows;
+    index->cellWidth = width / columns;
+    index->cellHeight = height / rows;
+
+    // Two passes over the boxes, counting then filling, keep the cells in one flat array
+    index->cellStart.assign((size_t) columns * rows + 1, 0);
+    for (int pass = 0; pass < 2; pass++) {
+        std::vector<int> cursor;
+        if (pass == 1) {
+            for (size_t c = 1; c < index->cellStart.size(); c++) {
+                index->cellStart[c] += index->cellStart[c - 1];
+            }
+            index->items.resize(index->cellStart.back());
+            cursor.assign(index->cellStart.begin(), index->cellStart.end() - 1);
+        }
+        for (int i = 0; i < count; i++) {
+            const float *b = &index->boxes[(size_t) i * 4];
+            if (b[2] <= b[0] || b[1] <= b[3]) continue;
+            int c0 = (int) ((b[0] - minX) / index->cellWidth);
+            int c1 = (int) ((b[2] - minX) / index->cellWidth);
+            int r0 = (int) ((b[3] - minY) / index->cellHeight);
+            int r1 = (int) ((b[1] - minY) / index->cellHeight);
+            if (c1 >= columns) c1 = columns - 1;
+            if (r1 >= rows) r1 = rows - 1;
+            for (int r = r0; r <= r1; r++) {
+                for (int c = c0; c <= c1; c++) {
+                    int cell = r * columns + c;
+                    if (pass == 0) index->cellStart[cell + 1]++;
+                    else index->items[cursor[cell]++] = i;
+                }
+            }
+        }
+    }
+}
+
+// Collects the characters of the cells overlapping the given area, a character spanning several
+// cells may be collected more than once.
+static inline void collectTextCells(const TextSpatialIndex *index, float left, float bottom,
+                                    float right, float top, std::vector<int> &out) {
+    if (index->columns == 0) return;
+    int c0 = (int) floor((left - index->minX) / index->cellWidth);
+    int c1 = (int) floor((right - index->minX) / index->cellWidth);
+    int r0 = (int) floor((bottom - index->minY) / index->cellHeight);
+    int r1 = (int) floor((top - index->minY) / index->cellHeight);
+    if (c0 < 0) c0 = 0;
+    if (r0 < 0) r0 = 0;
+    if (c1 >= index->columns) c1 = index->columns - 1;
+    if (r1 >= index->rows) r1 = index->rows - 1;
+    for (int r = r0; r <= r1; r++) {
+        for (int c = c0; c <= c1; c++) {
+            int cell = r * index->columns + c;
+            out.insert(out.end(), index->items.begin() + index->cellStart[cell],
+                       index->items.begin() + index->cellStart[cell + 1]);
+        }
+    }
+}
+
+/**
+ * Ranks a candidate of textGridCharAtPos. Closest box first, boxes containing the point are at 0
+ * and ranked by their center. Returns false if the box is out of the tolerance.
+ */
+static inline bool rankTextBox(const float *b, float px, float py, float tx, float ty,
+                               float *distance, float *center) {
+    if (px < b[0] - tx || px > b[2] + tx || py < b[3] - ty || py > b[1] + ty) return false;
+    float dx = px < b[0] ? b[0] - px : (px > b[2] ? px - b[2] : 0);
+    float dy = py < b[3] ? b[3] - py : (py > b[1] ? py - b[1] : 0);
+    *distance = dx + dy;
+    *center = fabsf((b[0] + b[2]) / 2 - px) + fabsf((b[1] + b[3]) / 2 - py);
+    return true;
+}
+
+// Index of the character at a point within the tolerances, -1 if there is none
+static inline int textGridCharAtPos(const TextSpatialIndex *index, float px, float py, float tx,
+                                    float ty) {
+    std::vector<int> candidates;
+    collectTextCells(index, px - tx, py - ty, px + tx, py + ty, candidates);
+
+    int found = -1;
+    float foundDistance = 0, foundCenter = 0;
+    for (size_t k = 0; k < candidates.size(); k++) {
+        int i = candidates[k];
+        float distance, center;
+        if (!rankTextBox(&index->boxes[(size_t) i * 4], px, py, tx, ty, &distance, &center)) {
+            continue;
+        }
+        // A character spanning several cells is seen again, the lowest index wins ties
+        if (found == -1 || distance < foundDistance ||
+            (distance == foundDistance && center < foundCenter) ||
+            (distance == foundDistance && center == foundCenter && i < found)) {
+            found = i;
+            foundDistance = distance;
+            foundCenter = center;
+        }
+    }
+    return found;
+}
+
+// Sorted indices of the characters whose boxes intersect the rect
+static inline void textGridCharsInRect(const TextSpatialIndex *index, float left, float top,
+                                       float right, float bottom, std::vector<int> *chars) {
+    std::vector<int> candidates;
+    collectTextCells(index, left, bottom, right, top, candidates);
+    for (size_t k = 0; k < candidates.size(); k++) {
+        const float *box = &index->boxes[(size_t) candidates[k] * 4];
+        if (box[2] < left || box[0] > right || box[1] < bottom || box[3] > top) continue;
+        chars->push_back(candidates[k]);
+    }
+    std::sort(chars->begin(), chars->end());
+    chars->erase(std::unique(chars->begin(), chars->end()), chars->end());
+}
+
+#endif // PDFIUM_TEXT_SPATIAL_INDEX_H
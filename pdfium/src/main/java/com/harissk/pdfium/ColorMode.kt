@@ -0,0 +1,38 @@
+package com.harissk.pdfium
+
+/**
+ * Colour presets applied natively to rendered pixels by [PdfiumCore.renderPageBitmap], so that
+ * rendered bitmaps are already in display form.
+ */
+enum class ColorMode {
+    /** Colours of the document. */
+    NONE,
+
+    /** Inverted colours, light content on a black page. */
+    NIGHT,
+
+    /** Shades of brown ink on a paper tone. */
+    SEPIA,
+
+    /** Grayscale with doubled contrast, light grays turn white and dark grays black. */
+    HIGH_CONTRAST;
+
+    /** The pipeline implementing this preset, null for [NONE]. */
+    val pipeline: PixelPipeline? by lazy {
+        when (this) {
+            NONE -> null
+            NIGHT -> PixelPipeline.Builder().invert().build()
+            SEPIA -> PixelPipeline.Builder()
+                .grayscale()
+                .tint(paper = SEPIA_PAPER, ink = SEPIA_INK)
+                .build()
+
+            HIGH_CONTRAST -> PixelPipeline.Builder().grayscale().tone(contrast = 2f).build()
+        }
+    }
+
+    private companion object {
+        const val SEPIA_PAPER = 0xFFF4ECD8.toInt()
+        const val SEPIA_INK = 0xFF5B4636.toInt()
+    }
+}
@@ -8,9 +8,11 @@ import android.graphics.RectF
  * @param bounds The bounding rectangle of the link.
  * @param destPageIdx The destination page index, if the link is an internal link.
  * @param uri The URI of the link, if the link is an external link.
+ * @param isWebLink True if the link is a URL written as plain text rather than a link annotation.
  */
 data class Link(
     val bounds: RectF,
     val destPageIdx: Int? = null,
     val uri: String? = null,
-)
\ No newline at end of file
+    val isWebLink: Boolean = false,
+)
@@ -0,0 +1,79 @@
+package com.harissk.pdfium
+
+/**
+ * What a page draws, counted from its objects without rendering it. Objects inside forms are
+ * counted as well, the forms themselves are counted in [formObjects].
+ *
+ * @param textObjects The number of text objects.
+ * @param pathObjects The number of path objects.
+ * @param imageObjects The number of image objects.
+ * @param shadingObjects The number of shading objects, such as gradients.
+ * @param formObjects The number of form objects.
+ * @param pathSegments The number of segments of all paths.
+ * @param imagePixels The number of pixels of all images, at their own resolution.
+ * @param transparentObjects The number of objects blended through a transparency group.
+ */
+data class PageComplexity(
+    val textObjects: Int,
+    val pathObjects: Int,
+    val imageObjects: Int,
+    val shadingObjects: Int,
+    val formObjects: Int,
+    val pathSegments: Long,
+    val imagePixels: Long,
+    val transparentObjects: Int,
+) {
+
+    /**
+     * Rough cost of rendering the page, in arbitrary units. Each path segment counts 1, each path
+     * object 2, text object 4 and form 8, every 256 image pixels count 1, each object blended
+     * through a transparency group 50 and each shading 2000, as a gradient is computed per pixel.
+     * Dense vector drawings, like CAD plans and maps, are dominated by their path segments.
+     */
+    val renderCost: Long
+        get() = textObjects * TEXT_OBJECT_COST +
+                pathObjects * PATH_OBJECT_COST +
+                pathSegments * PATH_SEGMENT_COST +
+                imagePixels / IMAGE_PIXELS_PER_COST +
+                shadingObjects * SHADING_OBJECT_COST +
+                formObjects * FORM_OBJECT_COST +
+                transparentObjects * TRANSPARENT_OBJECT_COST
+
+    /**
+     * Rough native memory held by the parsed page, in bytes: a fixed base, each object, each path
+     * segment and the decoded pixels of every image, which stay cached once the page is drawn.
+     */
+    val memoryEstimate: Long
+        get() = PAGE_BASE_BYTES +
+                (textObjects + pathObjects + imageObjects + shadingObjects + formObjects) *
+                OBJECT_BYTES +
+                pathSegments * PATH_SEGMENT_BYTES +
+                imagePixels * IMAGE_PIXEL_BYTES
+
+    companion object {
+        private const val TEXT_OBJECT_COST = 4L
+        private const val PATH_OBJECT_COST = 2L
+        private const val PATH_SEGMENT_COST = 1L
+        private const val IMAGE_PIXELS_PER_COST = 256L
+        private const val SHADING_OBJECT_COST = 2000L
+        private const val FORM_OBJECT_COST = 8L
+        private const val TRANSPARENT_OBJECT_COST = 50L
+
+        // pdfium does not report its allocations, these are rough per item costs
+        private const val PAGE_BASE_BYTES = 16 * 1024L
+        private const val OBJECT_BYTES = 512L
+        private const val PATH_SEGMENT_BYTES = 32L
+        private const val IMAGE_PIXEL_BYTES = 4L
+
+        internal fun fromFields(fields: LongArray) = PageComplexity(
+            textObjects = fields[0].toInt(),
+            pathObjects = fields[1].toInt(),
+            imageObjects = fields[2].toInt(),
+            shadingObjects = fields[3].toInt(),
+            formObjects = fields[4].toInt(),
+            pathSegments = fields[5],
+            imagePixels = fields[6],
+            transparentObjects = fields[7].toInt()
+        )
+    }
+}
@@ -5,14 +5,28 @@ import android.graphics.Point
 import android.graphics.PointF
 import android.graphics.RectF
 import android.os.ParcelFileDescriptor
+import android.system.ErrnoException
+import android.system.Os
 import android.util.ArrayMap
 import android.view.Surface
+import com.harissk.pdfium.annotation.AnnotationCommit
+import com.harissk.pdfium.annotation.AnnotationLayer
+import com.harissk.pdfium.annotation.AnnotationTransaction
 import com.harissk.pdfium.exception.PageRenderingException
 import com.harissk.pdfium.listener.LogWriter
+import com.harissk.pdfium.search.DocumentSearchListener
 import com.harissk.pdfium.search.FPDFTextSearchContext
+import com.harissk.pdfium.search.IncrementalSearchSession
+import com.harissk.pdfium.search.SearchMatch
 import com.harissk.pdfium.search.TextSearchContext
+import com.harissk.pdfium.text.FullTextIndex
+import com.harissk.pdfium.text.FullTextIndexBuilder
+import com.harissk.pdfium.text.GlyphTable
+import com.harissk.pdfium.text.TextExtractionListener
+import com.harissk.pdfium.text.TextStructure
 import com.harissk.pdfium.util.FileUtils
 import com.harissk.pdfium.util.Size
+import java.io.File
 import java.io.IOException
 import java.nio.ByteBuffer
 import java.nio.ByteOrder
@@ -29,7 +43,7 @@ import java.nio.ByteOrder
  * - Accessing and navigating through the document's table of contents (bookmarks).
  * - Rendering pages to surfaces or bitmaps for display.
  * - Extracting text from pages, including character positions and bounding boxes.
- * - Searching for text within pages.
+ * - Searching for text within pages, or through a persistent full-text index.
  * - Handling annotations (limited functionality).
  * - Managing native resources and closing documents.
  *
@@ -59,8 +73,9 @@ class PdfiumCore : java.io.Closeable {
 
     private var mCurrentDpi: Int = 72 // pdfium has default dpi set to 72
     private val mNativePagesPtr: MutableMap<Int, Long> = ArrayMap()
-    private val mNativeTextPagesPtr: MutableMap<Int, Long> = ArrayMap()
     private val mNativeSearchHandlePtr: MutableMap<Int, Long> = ArrayMap()
+    private val mPageLinks: MutableMap<Int, List<Link>> = ArrayMap()
+    private val mPageLinksWithWebLinks: MutableMap<Int, List<Link>> = ArrayMap()
     private var mNativeDocPtr: Long = 0
     private var mFileDescriptor: ParcelFileDescriptor? = null
 
@@ -89,9 +104,14 @@ class PdfiumCore : java.io.Closeable {
         pagePtr: Long, bitmap: Bitmap,
         startX: Int, startY: Int,
         drawSizeHor: Int, drawSizeVer: Int,
-        renderAnnot: Boolean,
+        renderAnnot: Boolean, draft: Boolean, clear: Boolean, pipelineStages: FloatArray?,
     )
 
+    private external fun nativeApplyPixelPipeline(
+        pipelineStages: FloatArray,
+        colors: IntArray,
+    ): IntArray
+
     private external suspend fun nativeGetDocumentMetaText(docPtr: Long, tag: String): String?
     private external suspend fun nativeGetFirstChildBookmark(
         docPtr: Long,
@@ -102,10 +122,24 @@ class PdfiumCore : java.io.Closeable {
     private external suspend fun nativeGetBookmarkTitle(bookmarkPtr: Long): String?
     private external suspend fun nativeGetBookmarkDestIndex(docPtr: Long, bookmarkPtr: Long): Long
     private external fun nativeGetPageSizeByIndex(docPtr: Long, pageIndex: Int, dpi: Int): Size
+    private external fun nativeGetPageSizes(docPtr: Long, pageIndexes: IntArray, dpi: Int): IntArray
+    private external fun nativeGetPageContentBounds(
+        docPtr: Long,
+        pageIndexes: IntArray,
+        scanImages: Boolean,
+    ): FloatArray
+    private external fun nativeIsPageBlank(pagePtr: Long, renderAnnot: Boolean): Boolean
     private external fun nativeGetPageLinks(pagePtr: Long): LongArray
+    private external fun nativeGetPageComplexity(pagePtr: Long): LongArray
     private external fun nativeGetDestPageIndex(docPtr: Long, linkPtr: Long): Int?
     private external fun nativeGetLinkURI(docPtr: Long, linkPtr: Long): String?
     private external fun nativeGetLinkRect(linkPtr: Long): RectF?
+    private external fun nativeGetPageLinkTable(
+        docPtr: Long,
+        pageIndex: Int,
+        pagePtr: Long,
+        webLinks: Boolean,
+    ): Array<Any?>?
     private external fun nativePageCoordinateToDevice(
         pagePtr: Long, startX: Int, startY: Int, sizeX: Int,
         sizeY: Int, rotate: Int, pageX: Double, pageY: Double,
@@ -119,10 +153,19 @@ class PdfiumCore : java.io.Closeable {
     ///////////////////////////////////////
     // PDF TextPage api
     ///////////
-    private external fun nativeLoadTextPage(docPtr: Long, pagePtr: Long): Long
-    private external fun nativeLoadTextPages(docPtr: Long, pagePtrs: LongArray): LongArray
-    private external fun nativeCloseTextPage(pagePtr: Long)
-    private external fun nativeCloseTextPages(pagesPtr: LongArray)
+    private external fun nativeLoadTextPage(docPtr: Long, pageIndex: Int, pagePtr: Long): Long
+    private external fun nativeLoadTextPages(
+        docPtr: Long,
+        fromIndex: Int,
+        pagePtrs: LongArray,
+    ): LongArray
+
+    private external fun nativeCloseTextPage(docPtr: Long, pageIndex: Int)
+    private external fun nativeCloseTextPages(docPtr: Long, fromIndex: Int, toIndex: Int)
+    private external fun nativeHasTextPage(docPtr: Long, pageIndex: Int): Boolean
+    private external fun nativePinTextPage(docPtr: Long, pageIndex: Int, pin: Boolean)
+    private external fun nativeSetTextPageBudget(docPtr: Long, budgetBytes: Long)
+    private external fun nativeGetTextPagesBytes(docPtr: Long): Long
     private external fun nativeTextCountChars(textPagePtr: Long): Int
     private external fun nativeTextGetText(
         textPagePtr: Long,
@@ -131,8 +174,22 @@ class PdfiumCore : java.io.Closeable {
         result: ShortArray,
     ): Int
 
+    private external fun nativeTextGetTextString(
+        textPagePtr: Long,
+        startIndex: Int,
+        count: Int,
+    ): String?
+
+    private external fun nativeTextGetTextDirect(
+        textPagePtr: Long,
+        startIndex: Int,
+        count: Int,
+        buffer: ByteBuffer,
+    ): Int
+
     private external fun nativeTextGetUnicode(textPagePtr: Long, index: Int): Int
     private external fun nativeTextGetCharBox(textPagePtr: Long, index: Int): DoubleArray
+    private external fun nativeGetGlyphTable(textPagePtr: Long, buffer: ByteBuffer): Int
     private external fun nativeTextGetCharIndexAtPos(
         textPagePtr: Long,
         x: Double,
@@ -141,6 +198,32 @@ class PdfiumCore : java.io.Closeable {
         yTolerance: Double,
     ): Int
 
+    private external fun nativeTextIndexCharAtPos(
+        docPtr: Long,
+        pageIndex: Int,
+        x: Double,
+        y: Double,
+        xTolerance: Double,
+        yTolerance: Double,
+    ): Int
+
+    private external fun nativeTextIndexCharsInRect(
+        docPtr: Long,
+        pageIndex: Int,
+        left: Double,
+        top: Double,
+        right: Double,
+        bottom: Double,
+    ): IntArray?
+
+    private external fun nativeTextIndexRangeRects(
+        docPtr: Long,
+        pageIndex: Int,
+        startIndex: Int,
+        count: Int,
+    ): FloatArray?
+
+    private external fun nativeGetTextStructure(docPtr: Long, pageIndex: Int): IntArray?
     private external fun nativeTextCountRects(textPagePtr: Long, start_index: Int, count: Int): Int
     private external fun nativeTextGetRect(textPagePtr: Long, rect_index: Int): DoubleArray
     private external fun nativeTextGetBoundedTextLength(
@@ -160,6 +243,14 @@ class PdfiumCore : java.io.Closeable {
         arr: ShortArray,
     ): Int
 
+    private external fun nativeTextGetBoundedTextString(
+        textPagePtr: Long,
+        left: Double,
+        top: Double,
+        right: Double,
+        bottom: Double,
+    ): String?
+
     ///////////////////////////////////////
     // PDF Search API
     ///////////
@@ -175,24 +266,96 @@ class PdfiumCore : java.io.Closeable {
     private external fun nativeSearchPrev(searchHandlePtr: Long): Boolean
     private external fun nativeGetCharIndexOfSearchResult(searchHandlePtr: Long): Int
     private external fun nativeCountSearchResult(searchHandlePtr: Long): Int
+    private external fun nativeSearchDocument(
+        docPtr: Long,
+        query: String,
+        matchCase: Boolean,
+        matchWholeWord: Boolean,
+        fromPage: Int,
+        toPage: Int,
+    ): Int
+
+    private external fun nativeSearchSessionCreate(matchCase: Boolean, matchWholeWord: Boolean): Long
+    private external fun nativeSearchSessionDestroy(sessionPtr: Long)
+    private external fun nativeSearchSessionQuery(
+        sessionPtr: Long,
+        docPtr: Long,
+        query: String,
+        pageOrder: IntArray,
+    ): Int
+
+    ///////////////////////////////////////
+    // PDF Full-text index API
+    ///////////
+    private external fun nativeGetFileIdentifier(docPtr: Long, type: Int): String?
+    private external fun nativeFtsBuilderCreate(path: String, identity: String, pageCount: Int): Long
+    private external fun nativeFtsBuilderIndexedPages(builderPtr: Long): Int
+    private external fun nativeFtsBuilderAddPages(builderPtr: Long, docPtr: Long, pageCount: Int): Int
+    private external fun nativeFtsBuilderSave(builderPtr: Long): Boolean
+    private external fun nativeFtsBuilderDestroy(builderPtr: Long)
+    private external fun nativeFtsOpen(path: String, identity: String): Long
+    private external fun nativeFtsInfo(indexPtr: Long): IntArray?
+    private external fun nativeFtsSearch(
+        indexPtr: Long,
+        query: String,
+        prefix: Boolean,
+        maxResults: Int,
+    ): IntArray?
+
+    private external fun nativeFtsClose(indexPtr: Long)
 
     ///////////////////////////////////////
     // PDF Annotation API
     ///////////
-    private external fun nativeAddTextAnnotation(
-        docPtr: Long,
-        pageIndex: Int,
-        text: String,
-        color: IntArray,
-        bound: IntArray,
-    ): Long
+    private external fun nativeGetPageAnnotationTable(pagePtr: Long): Array<Any?>?
+    private external fun nativeApplyAnnotationEdits(
+        pagePtr: Long,
+        edits: IntArray,
+        values: FloatArray,
+        texts: Array<String?>,
+    ): Array<Any?>?
 
     ///////////////////////////////////////
     // PDF Native Callbacks
     ///////////
-    private fun onAnnotationAdded(pageIndex: Int, pageNewPtr: Long) {}
-    private fun onAnnotationUpdated(pageIndex: Int, pageNewPtr: Long) {}
-    private fun onAnnotationRemoved(pageIndex: Int, pageNewPtr: Long) {}
+
+    private var documentSearchListener: DocumentSearchListener? = null
+
+    // matches holds (charIndex, charCount, rectCount) per match, rects 4 floats per rect
+    private fun onSearchPageResults(pageIndex: Int, matches: IntArray?, rects: FloatArray?): Boolean {
+        val listener = documentSearchListener ?: return false
+        if (matches == null || rects == null) return listener.onPageResults(pageIndex, emptyList())
+
+        var rect = 0
+        val results = List(matches.size / 3) { i ->
+            val rectCount = matches[i * 3 + 2]
+            val matchRects = List(rectCount) {
+                val o = (rect + it) * 4
+                RectF(rects[o], rects[o + 1], rects[o + 2], rects[o + 3])
+            }
+            rect += rectCount
+            SearchMatch(pageIndex, matches[i * 3], matches[i * 3 + 1], matchRects)
+        }
+        return listener.onPageResults(pageIndex, results)
+    }
+
+    ///////////////////////////////////////
+    // PDF Text extraction API
+    ///////////
+    private external fun nativeExtractText(
+        docPtr: Long,
+        fd: Int,
+        fromPage: Int,
+        toPage: Int,
+        separator: String?,
+    ): Long
+
+    private var textExtractionListener: TextExtractionListener? = null
+
+    private fun onTextExtractionProgress(pagesDone: Int, pageCount: Int): Boolean =
+        textExtractionListener?.onProgress(pagesDone, pageCount) ?: true
+
+    private external fun nativeSaveToFd(docPtr: Long, fd: Int, incremental: Boolean): LongArray?
 
     private external fun nativeGetLastError(docPtr: Long): Int
     private external fun nativeGetErrorMessage(errorCode: Int): String
@@ -225,6 +388,8 @@ class PdfiumCore : java.io.Closeable {
             throw IOException("Error opening PDF document. Code: $errorCode, Message: $errorMessage")
         }
         mNativeDocPtr = docPtr
+        mPageLinks.clear()
+        mPageLinksWithWebLinks.clear()
         return docPtr
     }
 
@@ -242,6 +407,8 @@ class PdfiumCore : java.io.Closeable {
             throw IOException("Error opening PDF document. Code: $errorCode, Message: $errorMessage")
         }
         mNativeDocPtr = docPtr
+        mPageLinks.clear()
+        mPageLinksWithWebLinks.clear()
         return docPtr
     }
 
@@ -268,7 +435,6 @@ class PdfiumCore : java.io.Closeable {
         }
 
         mNativePagesPtr[pageIndex] = pagePtr
-        prepareTextInfo(pageIndex)
         return pagePtr
     }
 
@@ -277,12 +443,8 @@ class PdfiumCore : java.io.Closeable {
      */
     fun openPage(fromIndex: Int, toIndex: Int): LongArray {
         val pagesPtr: LongArray = nativeLoadPages(mNativeDocPtr, fromIndex, toIndex)
-        var pageIndex = fromIndex
-        for (page in pagesPtr) {
-            if (pageIndex > toIndex) break
-            mNativePagesPtr[pageIndex] = page
-            pageIndex++
-            prepareTextInfo(pageIndex)
+        pagesPtr.forEachIndexed { offset, page ->
+            if (fromIndex + offset <= toIndex) mNativePagesPtr[fromIndex + offset] = page
         }
         return pagesPtr
     }
@@ -321,12 +483,117 @@ class PdfiumCore : java.io.Closeable {
      */
     fun getPageSize(index: Int): Size = nativeGetPageSizeByIndex(mNativeDocPtr, index, mCurrentDpi)
 
+    /**
+     * Get sizes of several pages in pixels in a single native call, as width and height pairs in
+     * the order of [indexes]. Pages whose size cannot be read are 0x0.<br></br>
+     * This method does not require given pages to be opened.
+     */
+    fun getPageSizes(indexes: IntArray): IntArray =
+        nativeGetPageSizes(mNativeDocPtr, indexes, mCurrentDpi)
+
+    /**
+     * Get the bounds of the content of several pages, with a small padding, as fractions of the
+     * displayed page size: left, top, right and bottom for each page in the order of [indexes].
+     * Pages that are blank, or whose margins are too thin to crop, get 0, 0, 1, 1.<br></br>
+     * Pages are loaded for the measurement and do not need to be opened.
+     *
+     * @param scanImages When true, pages covered by an image are rendered at a low resolution to
+     * find their ink, else they are not cropped.
+     */
+    fun getPageContentBounds(indexes: IntArray, scanImages: Boolean): FloatArray =
+        nativeGetPageContentBounds(mNativeDocPtr, indexes, scanImages)
+
+    /**
+     * Check whether an opened page is blank: it has no objects, or its only content is images,
+     * forms or paths that leave no visible ink in a low resolution render, like empty scanned
+     * separator pages. Pages with text are never blank and are not rendered for the check.<br></br>
+     * Returns false if the page is not opened.
+     *
+     * @param renderAnnot When true, pages with annotations are never blank.
+     */
+    fun isPageBlank(index: Int, renderAnnot: Boolean): Boolean {
+        val pagePtr = mNativePagesPtr[index] ?: return false
+        return nativeIsPageBlank(pagePtr, renderAnnot)
+    }
+
     /**
      * Get the rotation of page<br></br>
      */
     fun getPageRotation(index: Int): Int =
         mNativePagesPtr[index]?.let { nativeGetPageRotation(it) } ?: 0
 
+    /**
+     * Estimate the native memory held by an opened page, in bytes, see
+     * [PageComplexity.memoryEstimate]. Text pages are not included, they are held in a separate
+     * cache, see [setTextPageCacheBudget]. Callers that also need the complexity should read
+     * [getPageComplexity] once instead, both come from the same walk of the page.<br></br>
+     * Returns 0 if the page is not opened.
+     */
+    fun getPageMemoryEstimate(index: Int): Long = getPageComplexity(index)?.memoryEstimate ?: 0
+
+    /**
+     * Read the annotations of an opened page that a viewer can draw itself, above the page
+     * content rendered without annotations, see [AnnotationLayer].<br></br>
+     * Returns null if the page is not opened.
+     */
+    fun getPageAnnotationLayer(index: Int): AnnotationLayer? {
+        val pagePtr = mNativePagesPtr[index] ?: return null
+        val table = try {
+            nativeGetPageAnnotationTable(pagePtr)
+        } catch (e: Exception) {
+            logWriter?.writeLog("Error reading page annotations", TAG)
+            null
+        } ?: return null
+        return AnnotationLayer.fromTable(table[0] as IntArray, table[1] as FloatArray)
+    }
+
+    /**
+     * Apply the edits of [transaction] to an opened page in memory, in one call. The page stays
+     * opened and the document is not saved, rendering the page shows the edits. The cached links
+     * of the page are read again on the next [getPageLinks].<br></br>
+     * Returns null if the page is not opened.
+     */
+    fun applyAnnotationTransaction(
+        index: Int,
+        transaction: AnnotationTransaction,
+    ): AnnotationCommit? {
+        val pagePtr = mNativePagesPtr[index] ?: return null
+        val result = try {
+            nativeApplyAnnotationEdits(
+                pagePtr,
+                transaction.editTable(),
+                transaction.valueTable(),
+                transaction.textTable()
+            )
+        } catch (e: Exception) {
+            logWriter?.writeLog("Error applying annotation edits", TAG)
+            null
+        } ?: return null
+        val dirty = result[1] as FloatArray
+        // A link may have been moved or removed
+        if (dirty.size == 4) synchronized(this) {
+            mPageLinks.remove(index)
+            mPageLinksWithWebLinks.remove(index)
+        }
+        return AnnotationCommit(
+            indices = result[0] as IntArray,
+            dirtyBounds = when (dirty.size) {
+                4 -> RectF(dirty[0], dirty[1], dirty[2], dirty[3])
+                else -> null
+            }
+        )
+    }
+
+    /**
+     * Count the objects, path segments and image pixels of an opened page to estimate how
+     * expensive it is to render, see [PageComplexity.renderCost].<br></br>
+     * Returns null if the page is not opened.
+     */
+    fun getPageComplexity(index: Int): PageComplexity? {
+        val pagePtr = mNativePagesPtr[index] ?: return null
+        return PageComplexity.fromFields(nativeGetPageComplexity(pagePtr))
+    }
+
     /**
      * Render page fragment on [Surface]. This method allows to render annotations.<br></br>
      * Page must be opened before rendering.
@@ -359,16 +626,28 @@ class PdfiumCore : java.io.Closeable {
      *
      *
      * For more info see [PdfiumCore.renderPageBitmap]
+     *
+     * @param draft When true, the page is rendered without text, image and path smoothing and
+     * without keeping decoded images cached. Meant for short-lived previews while the view is
+     * moving quickly.
+     * @param clear When true, an ARGB_8888 [bitmap] is cleared to transparent before rendering.
+     * Required when the bitmap is reused and still holds a previous render.
+     * @param pixelPipeline Colour transforms applied to the rendered pixels, so that [bitmap] can
+     * be drawn without a colour filter.
      */
     fun renderPageBitmap(
         bitmap: Bitmap, pageIndex: Int,
         startX: Int, startY: Int, drawSizeX: Int, drawSizeY: Int,
         renderAnnot: Boolean = false,
+        draft: Boolean = false,
+        clear: Boolean = false,
+        pixelPipeline: PixelPipeline? = null,
     ) {
         try {
             nativeRenderPageBitmap(
                 mNativePagesPtr[pageIndex] ?: throw NullPointerException(), bitmap,
-                startX, startY, drawSizeX, drawSizeY, renderAnnot
+                startX, startY, drawSizeX, drawSizeY, renderAnnot, draft, clear,
+                pixelPipeline?.stages
             )
         } catch (e: NullPointerException) {
             logWriter?.writeLog("mContext may be null", TAG)
@@ -377,11 +656,20 @@ class PdfiumCore : java.io.Closeable {
         }
     }
 
+    /**
+     * Returns the ARGB [colors] as [pipeline] renders them, for example to paint the background of
+     * the view like a blank page.
+     */
+    fun applyPixelPipeline(pipeline: PixelPipeline, colors: IntArray): IntArray =
+        nativeApplyPixelPipeline(pipeline.stages, colors)
+
     /**
      * Release native page resources of given page
      */
     fun closePage(pageIndex: Int) {
         val pagePtr = mNativePagesPtr[pageIndex] ?: throw NullPointerException()
+        // The text page and its search handle depend on the page, they go first
+        closeTextPage(pageIndex)
         nativeClosePage(pagePtr)
         mNativePagesPtr.remove(pageIndex)
     }
@@ -417,26 +705,24 @@ class PdfiumCore : java.io.Closeable {
      */
     @Synchronized
     private fun closeDocument() = try {
-        // Close all native pages
-        mNativePagesPtr.values.forEach { pagePtr ->
-            if (isValidPointer(pagePtr)) nativeClosePage(pagePtr)
-        }
-
-        // Close all native text pages
-        mNativeTextPagesPtr.values.forEach { textPagePtr ->
-            if (isValidPointer(textPagePtr)) nativeCloseTextPage(textPagePtr)
-        }
-
         // Close all search handles
         mNativeSearchHandlePtr.values.forEach { searchHandle ->
             if (isValidPointer(searchHandle)) nativeSearchStop(searchHandle)
         }
+        mNativeSearchHandlePtr.clear()
+
+        // Close all native text pages and pages, a text page must be closed before its page
+        mNativePagesPtr.forEach { (pageIndex, pagePtr) ->
+            nativeCloseTextPage(mNativeDocPtr, pageIndex)
+            if (isValidPointer(pagePtr)) nativeClosePage(pagePtr)
+        }
 
         nativeCloseDocument(mNativeDocPtr)
     } finally {
         mNativePagesPtr.clear()
-        mNativeTextPagesPtr.clear()
         mNativeSearchHandlePtr.clear()
+        mPageLinks.clear()
+        mPageLinksWithWebLinks.clear()
         mNativeDocPtr = 0
 
         try {
@@ -490,21 +776,43 @@ class PdfiumCore : java.io.Closeable {
     }
 
     /**
-     * Get all links from given page
+     * Get all links from given page, read in a single native call and cached for the lifetime of
+     * the document. The page must be opened the first time.
+     *
+     * @param includeWebLinks also return URLs written as plain text, see [Link.isWebLink]. Off by
+     * default, so only the link annotations of the page are returned and its text is not scanned.
      */
-    fun getPageLinks(pageIndex: Int): List<Link> {
+    @Synchronized
+    fun getPageLinks(pageIndex: Int, includeWebLinks: Boolean = false): List<Link> {
         if (pageIndex < 0) return emptyList()
-        val links = mutableListOf<Link>()
-        val nativePagePtr = mNativePagesPtr[pageIndex] ?: return links
-
-        nativeGetPageLinks(nativePagePtr).forEach { linkPtr ->
-            val index = nativeGetDestPageIndex(mNativeDocPtr, linkPtr)
-            val uri = nativeGetLinkURI(mNativeDocPtr, linkPtr)
-            val rect = nativeGetLinkRect(linkPtr) ?: return@forEach
+        val cache = if (includeWebLinks) mPageLinksWithWebLinks else mPageLinks
+        return cache[pageIndex] ?: run {
+            val nativePagePtr = mNativePagesPtr[pageIndex] ?: return emptyList()
+            readPageLinkTable(pageIndex, nativePagePtr, includeWebLinks)
+                .also { cache[pageIndex] = it }
+        }
+    }
 
-            if (index != null || uri != null) links.add(Link(rect, index, uri))
+    private fun readPageLinkTable(pageIndex: Int, pagePtr: Long, webLinks: Boolean): List<Link> {
+        val table = try {
+            nativeGetPageLinkTable(mNativeDocPtr, pageIndex, pagePtr, webLinks)
+        } catch (e: Exception) {
+            logWriter?.writeLog("Error reading page links", TAG)
+            null
+        } ?: return emptyList()
+
+        val rects = table[0] as FloatArray
+        val destinations = table[1] as IntArray
+        @Suppress("UNCHECKED_CAST")
+        val uris = table[2] as Array<String?>
+        return List(destinations.size) { i ->
+            Link(
+                bounds = RectF(rects[i * 4], rects[i * 4 + 1], rects[i * 4 + 2], rects[i * 4 + 3]),
+                destPageIdx = destinations[i].takeIf { it >= 0 },
+                uri = uris[i],
+                isWebLink = destinations[i] == WEB_LINK_DESTINATION
+            )
         }
-        return links
     }
 
     /**
@@ -619,24 +927,36 @@ class PdfiumCore : java.io.Closeable {
     ///////////
     /**
      * Prepare information about all characters in a page.
-     * Application must call FPDFText_ClosePage to release the text page information.
+     *
+     * Text pages are kept in a native cache limited by [setTextPageCacheBudget]. The returned
+     * text page is pinned so that the cache does not release it, application must call
+     * [releaseTextInfo] to release it.
      *
      * @param pageIndex index of page.
      * @return A handle to the text page information structure. NULL if something goes wrong.
      */
     fun prepareTextInfo(pageIndex: Int): Long {
+        val textPagePtr = loadTextPage(pageIndex)
+        if (isValidPointer(textPagePtr)) nativePinTextPage(mNativeDocPtr, pageIndex, true)
+        return textPagePtr
+    }
+
+    /**
+     * Text pages are built on first use and kept in the native cache, least recently used pages
+     * are released first. The returned handle is only valid until the text page of another page
+     * is loaded: use it right away, under the lock of the caller, or pin the text page like a
+     * search does.
+     */
+    private fun loadTextPage(pageIndex: Int): Long {
         val pagePtr = mNativePagesPtr[pageIndex]
         if (!isValidPointer(pagePtr)) {
             throw IllegalStateException("Page at index $pageIndex not open. Ensure page is opened before preparing text info.")
         }
-        val textPagePtr = nativeLoadTextPage(
+        return nativeLoadTextPage(
             mNativeDocPtr,
+            pageIndex,
             pagePtr!!
         ) // pagePtr is checked for null by isValidPointer
-        if (isValidPointer(textPagePtr)) {
-            mNativeTextPagesPtr[pageIndex] = textPagePtr
-        }
-        return textPagePtr
     }
 
     /**
@@ -644,14 +964,32 @@ class PdfiumCore : java.io.Closeable {
      *
      * @param pageIndex index of page.
      */
-    fun releaseTextInfo(pageIndex: Int) {
-        val textPagePtr = mNativeTextPagesPtr[pageIndex]
-        if (validPtr(textPagePtr)) nativeCloseTextPage(textPagePtr ?: 0)
+    fun releaseTextInfo(pageIndex: Int) = closeTextPage(pageIndex)
+
+    private fun closeTextPage(pageIndex: Int) {
+        mNativeSearchHandlePtr.remove(pageIndex)?.let { searchHandle ->
+            if (isValidPointer(searchHandle)) nativeSearchStop(searchHandle)
+        }
+        nativeCloseTextPage(mNativeDocPtr, pageIndex)
     }
 
+    /**
+     * Sets the bytes that cached text pages of this document may hold (default 8 MB). Text pages
+     * in use by a search are never released to fit it.
+     */
+    fun setTextPageCacheBudget(budgetBytes: Long) =
+        nativeSetTextPageBudget(mNativeDocPtr, budgetBytes)
+
+    /**
+     * Estimated bytes held by the cached text pages of this document.
+     */
+    val textPageCacheBytes: Long
+        get() = nativeGetTextPagesBytes(mNativeDocPtr)
+
     /**
      * Prepare information about all characters in a range of pages.
-     * Application must call FPDFText_ClosePage to release the text page information.
+     * The text pages are pinned like in [prepareTextInfo], the whole range is kept even if it
+     * exceeds the cache budget. Application must call [releaseTextInfo] to release them.
      *
      * @param fromIndex start index of page.
      * @param toIndex   end index of page.
@@ -671,20 +1009,12 @@ class PdfiumCore : java.io.Closeable {
         }
 
         val pagePtrsArray = pagePtrsList.toLongArray()
-        val resultTextPagesPtrArray = nativeLoadTextPages(mNativeDocPtr, pagePtrsArray)
-
-        // The returned resultTextPagesPtrArray corresponds to the input pagePtrsArray.
-        // We need to map these back to their original page indices.
-        resultTextPagesPtrArray.forEachIndexed { resultIndex, textPagePtr ->
-            val originalPageIndex = fromIndex + resultIndex
-            // Ensure we don't go out of bounds if the returned array is somehow shorter (should not happen if native code is correct)
-            if (originalPageIndex <= toIndex) {
-                if (isValidPointer(textPagePtr)) {
-                    mNativeTextPagesPtr[originalPageIndex] = textPagePtr
-                }
-            }
+        // The returned array corresponds to the input pagePtrsArray, starting at fromIndex
+        val textPagePtrs = nativeLoadTextPages(mNativeDocPtr, fromIndex, pagePtrsArray)
+        textPagePtrs.forEachIndexed { i, textPagePtr ->
+            if (isValidPointer(textPagePtr)) nativePinTextPage(mNativeDocPtr, fromIndex + i, true)
         }
-        return resultTextPagesPtrArray
+        return textPagePtrs
     }
 
     /**
@@ -694,21 +1024,14 @@ class PdfiumCore : java.io.Closeable {
      * @param toIndex   end index of page.
      */
     fun releaseTextInfo(fromIndex: Int, toIndex: Int) {
-        // Iterate through the specified range and release valid text page pointers
         for (i in fromIndex..toIndex) {
-            val textPagePtr = mNativeTextPagesPtr[i]
-            if (validPtr(textPagePtr)) nativeCloseTextPage(textPagePtr ?: 0)
+            mNativeSearchHandlePtr.remove(i)?.let { if (isValidPointer(it)) nativeSearchStop(it) }
         }
+        nativeCloseTextPages(mNativeDocPtr, fromIndex, toIndex)
     }
 
-    private fun ensureTextPage(pageIndex: Int): Long {
-        // Check if the text page pointer is valid for the given page index
-        val ptr = mNativeTextPagesPtr[pageIndex]
-        if (validPtr(ptr)) return ptr ?: 0
-
-        // Prepare the text page if the pointer is invalid
-        return prepareTextInfo(pageIndex)
-    }
+    // The native cache returns the existing text page, or builds it on first use
+    private fun ensureTextPage(pageIndex: Int): Long = loadTextPage(pageIndex)
 
     fun countCharactersOnPage(pageIndex: Int): Int = try {
         val ptr = ensureTextPage(pageIndex)
@@ -727,28 +1050,93 @@ class PdfiumCore : java.io.Closeable {
      * @param pageIndex  index of page.
      * @param startIndex Index for the start characters.
      * @param length     Number of characters to be extracted.
-     * @return Number of characters written into the result buffer, including the trailing terminator.
+     * @return the extracted text, built by the native side straight from pdfium's UTF-16 output.
      */
     fun extractCharacters(pageIndex: Int, startIndex: Int, length: Int): String? = try {
         val ptr = ensureTextPage(pageIndex)
-        when {
-            validPtr(ptr) -> {
-                val buf = ShortArray(length + 1)
-                val r = nativeTextGetText(ptr, startIndex, length, buf)
-                val bytes = ByteArray((r - 1) * 2)
-                val bb = ByteBuffer.wrap(bytes)
-                bb.order(ByteOrder.LITTLE_ENDIAN)
-                for (i in 0 until r - 1) bb.putShort(buf[i])
-                String(bytes, charset("UTF-16LE"))
-            }
-
-            else -> null
-        }
+        if (validPtr(ptr)) nativeTextGetTextString(ptr, startIndex, length) else null
     } catch (e: Exception) {
         logWriter?.writeLog("Error extracting characters from page", TAG)
         null
     }
 
+    /**
+     * Extract unicode text from the page into a direct buffer, for bulk consumers that decode or
+     * scan the text themselves. The text is written as native order UTF-16 from the start of
+     * [buffer], followed by a NUL, so the buffer needs `(length + 1) * 2` bytes.
+     *
+     * @param pageIndex  index of page.
+     * @param startIndex Index for the start characters.
+     * @param length     Number of characters to be extracted.
+     * @param buffer     A direct buffer, see [ByteBuffer.allocateDirect].
+     * @return the number of characters written without the NUL, or -1 if the page has no text or
+     * the buffer is not direct or too small.
+     */
+    fun extractCharacters(pageIndex: Int, startIndex: Int, length: Int, buffer: ByteBuffer): Int =
+        try {
+            val ptr = ensureTextPage(pageIndex)
+            if (validPtr(ptr)) nativeTextGetTextDirect(ptr, startIndex, length, buffer) else -1
+        } catch (e: Exception) {
+            logWriter?.writeLog("Error extracting characters from page", TAG)
+            -1
+        }
+
+    /**
+     * Write the text of a range of pages to a file descriptor as UTF-8, in a single native call
+     * that needs no per page allocation on the Java side. The text is read from pdfium on the
+     * calling thread while a native writer thread encodes and writes the previous pages, with at
+     * most a few megabytes in flight whatever the document size. Writing starts at the current
+     * position of [fd], so several calls can append successive ranges to the same file.
+     *
+     * @param fd            The destination, open for writing. It is not closed.
+     * @param fromPage      index of the first page to extract.
+     * @param toPage        index of the last page to extract, inclusive.
+     * @param pageSeparator written after the text of every page, a form feed by default.
+     * @param listener      receives the progress after every page and may cancel the extraction.
+     * @return the number of bytes written, -1 if cancelled or -2 if the text could not be written.
+     */
+    @Synchronized
+    fun extractText(
+        fd: ParcelFileDescriptor,
+        fromPage: Int = 0,
+        toPage: Int = pageCount - 1,
+        pageSeparator: String = "\u000C",
+        listener: TextExtractionListener? = null,
+    ): Long {
+        textExtractionListener = listener
+        return try {
+            nativeExtractText(mNativeDocPtr, fd.fd, fromPage, toPage, pageSeparator)
+        } catch (e: Exception) {
+            logWriter?.writeLog("Error extracting text", TAG)
+            -2
+        } finally {
+            textExtractionListener = null
+        }
+    }
+
+    /**
+     * Save the document, with the annotation edits made since it was opened, to a file
+     * descriptor. Bytes are written through a fixed one megabyte buffer in whole chunks, so
+     * memory use does not grow with the document size.
+     *
+     * @param fd          The destination, open for writing and empty. It is not closed and must
+     * not be the file the document was opened from, which is read while saving.
+     * @param incremental When true the original file is copied as it is and only the changed
+     * objects are appended, which is fast and keeps signatures valid. Otherwise every object is
+     * written again, which can produce a smaller file.
+     * @return the bytes written and the time spent, or null if the document could not be saved.
+     */
+    @Synchronized
+    fun saveToFd(fd: ParcelFileDescriptor, incremental: Boolean = true): SaveResult? {
+        val stats = try {
+            nativeSaveToFd(mNativeDocPtr, fd.fd, incremental)
+        } catch (e: Exception) {
+            logWriter?.writeLog("Error saving document", TAG)
+            null
+        } ?: return null
+        return SaveResult(bytesWritten = stats[0], elapsedNanos = stats[1])
+    }
+
     /**
      * Get Unicode of a character in a page.
      *
@@ -786,6 +1174,34 @@ class PdfiumCore : java.io.Closeable {
         null
     }
 
+    /**
+     * Export every character of a page with its code, loose and tight boxes, origin and font
+     * metrics in a single native call. Prefer it over per character calls such as
+     * [measureCharacterBox] when hit-testing or selecting text.
+     *
+     * @param pageIndex index of page.
+     * @return the glyph table, or null if the page has no text page.
+     */
+    fun getGlyphTable(pageIndex: Int): GlyphTable? = try {
+        val ptr = ensureTextPage(pageIndex)
+        when {
+            validPtr(ptr) -> {
+                val count = nativeTextCountChars(ptr).coerceAtLeast(0)
+                val buffer = ByteBuffer.allocateDirect(GlyphTable.bytesFor(count))
+                    .order(ByteOrder.nativeOrder())
+                when (nativeGetGlyphTable(ptr, buffer)) {
+                    count -> GlyphTable(count, buffer)
+                    else -> null
+                }
+            }
+
+            else -> null
+        }
+    } catch (e: Exception) {
+        logWriter?.writeLog("Error exporting glyph table", TAG)
+        null
+    }
+
     /**
      * Get the index of a character at or nearby a certain position on the page
      *
@@ -795,6 +1211,9 @@ class PdfiumCore : java.io.Closeable {
      * @param xTolerance An x-axis tolerance value for character hit detection, in point unit.
      * @param yTolerance A y-axis tolerance value for character hit detection, in point unit.
      * @return The zero-based index of the character at, or nearby the point (x,y). If there is no character at or nearby the point, return value will be -1. If an error occurs, -3 will be returned.
+     *
+     * The lookup goes through a grid over the character boxes that is built once per text page,
+     * instead of pdfium scanning every character on each call.
      */
     fun getCharacterIndex(
         pageIndex: Int,
@@ -804,12 +1223,80 @@ class PdfiumCore : java.io.Closeable {
         yTolerance: Double,
     ): Int = try {
         val ptr = ensureTextPage(pageIndex)
-        if (validPtr(ptr)) nativeTextGetCharIndexAtPos(ptr, x, y, xTolerance, yTolerance) else -1
+        when {
+            !validPtr(ptr) -> -1
+            else -> nativeTextIndexCharAtPos(mNativeDocPtr, pageIndex, x, y, xTolerance, yTolerance)
+                .takeIf { it != -3 }
+                ?: nativeTextGetCharIndexAtPos(ptr, x, y, xTolerance, yTolerance)
+        }
     } catch (e: Exception) {
         logWriter?.writeLog("Error getting character index", TAG)
         -1
     }
 
+    /**
+     * Get the indexes of the characters whose box intersects a rectangle, in text order.
+     *
+     * @param pageIndex index of page.
+     * @param rect      the area in PDF "user space", with top greater than bottom.
+     * @return the character indexes, empty if none.
+     */
+    fun getCharacterIndexesInRect(pageIndex: Int, rect: RectF): IntArray = try {
+        val ptr = ensureTextPage(pageIndex)
+        when {
+            validPtr(ptr) -> nativeTextIndexCharsInRect(
+                mNativeDocPtr, pageIndex,
+                rect.left.toDouble(), rect.top.toDouble(),
+                rect.right.toDouble(), rect.bottom.toDouble()
+            ) ?: IntArray(0)
+
+            else -> IntArray(0)
+        }
+    } catch (e: Exception) {
+        logWriter?.writeLog("Error getting characters in rect", TAG)
+        IntArray(0)
+    }
+
+    /**
+     * Get the words, lines and blocks of a page. They are computed natively on first use and
+     * kept with the cached text page, later calls only copy the index arrays.
+     *
+     * @param pageIndex index of page.
+     * @return the text structure, or null if the page has no text page.
+     */
+    fun getTextStructure(pageIndex: Int): TextStructure? = try {
+        val ptr = ensureTextPage(pageIndex)
+        when {
+            validPtr(ptr) -> nativeGetTextStructure(mNativeDocPtr, pageIndex)?.let(::TextStructure)
+            else -> null
+        }
+    } catch (e: Exception) {
+        logWriter?.writeLog("Error getting text structure", TAG)
+        null
+    }
+
+    /**
+     * Get the rectangles covering a segment of text in one call, with the boxes of consecutive
+     * characters of a line merged. Meant for selection highlights, instead of [countTextRect]
+     * followed by one [getTextRect] call per rectangle.
+     *
+     * @param pageIndex index of page.
+     * @param charIndex Index for the start characters.
+     * @param count     Number of characters, -1 for all remaining characters.
+     * @return the rectangles in PDF "user space", empty if none.
+     */
+    fun getTextRects(pageIndex: Int, charIndex: Int, count: Int): List<RectF> = try {
+        val ptr = ensureTextPage(pageIndex)
+        val o = when {
+            validPtr(ptr) -> nativeTextIndexRangeRects(mNativeDocPtr, pageIndex, charIndex, count)
+            else -> null
+        } ?: FloatArray(0)
+        List(o.size / 4) { i -> RectF(o[i * 4], o[i * 4 + 1], o[i * 4 + 2], o[i * 4 + 3]) }
+    } catch (e: Exception) {
+        logWriter?.writeLog("Error getting text rectangles", TAG)
+        emptyList()
+    }
+
     /**
      * Count number of rectangular areas occupied by a segment of texts.
      *
@@ -874,34 +1361,177 @@ class PdfiumCore : java.io.Closeable {
             if (!validPtr(ptr)) {
                 return null
             }
-            val length = nativeTextGetBoundedTextLength(
+            nativeTextGetBoundedTextString(
                 textPagePtr = ptr,
                 left = rect.left.toDouble(),
                 top = rect.top.toDouble(),
                 right = rect.right.toDouble(),
                 bottom = rect.bottom.toDouble()
             )
-            if (length <= 0) return null
-            val buf = ShortArray(length + 1)
-            val r = nativeTextGetBoundedText(
-                textPagePtr = ptr,
-                left = rect.left.toDouble(),
-                top = rect.top.toDouble(),
-                right = rect.right.toDouble(),
-                bottom = rect.bottom.toDouble(),
-                arr = buf
-            )
-            val bytes = ByteArray((r - 1) * 2)
-            val bb = ByteBuffer.wrap(bytes)
-            bb.order(ByteOrder.LITTLE_ENDIAN)
-            for (i in 0 until r - 1) bb.putShort(buf[i])
-            String(bytes, charset("UTF-16LE"))
         } catch (e: Exception) {
             logWriter?.writeLog("Error extracting text", TAG)
             null
         }
     }
 
+    /**
+     * Search pages of the document in a single native call. Each page is reported to [listener]
+     * as soon as it is searched, with the character range and the highlight rects of every match.
+     * Pages with a cached text page reuse it, other pages are loaded only while being searched.
+     *
+     * @param query          A unicode match pattern.
+     * @param matchCase      match case
+     * @param matchWholeWord match the whole word
+     * @param fromPage       index of the first page to search.
+     * @param toPage         index of the last page to search, inclusive.
+     * @param listener       receives the results page by page and may cancel the search.
+     * @return the number of matches, or -1 if the search was cancelled.
+     */
+    @Synchronized
+    fun searchDocument(
+        query: String,
+        matchCase: Boolean = false,
+        matchWholeWord: Boolean = false,
+        fromPage: Int = 0,
+        toPage: Int = pageCount - 1,
+        listener: DocumentSearchListener,
+    ): Int {
+        if (query.isEmpty()) return 0
+        documentSearchListener = listener
+        return try {
+            nativeSearchDocument(mNativeDocPtr, query, matchCase, matchWholeWord, fromPage, toPage)
+        } catch (e: Exception) {
+            logWriter?.writeLog("Error searching document", TAG)
+            -1
+        } finally {
+            documentSearchListener = null
+        }
+    }
+
+    /**
+     * Start a search as you type session, see [IncrementalSearchSession]. The session must be
+     * closed to release the page texts it keeps.
+     *
+     * @param matchCase      match case
+     * @param matchWholeWord match the whole word
+     */
+    fun newIncrementalSearch(
+        matchCase: Boolean = false,
+        matchWholeWord: Boolean = false,
+    ): IncrementalSearchSession = IncrementalSearchSession(
+        core = this,
+        sessionPtr = nativeSearchSessionCreate(matchCase, matchWholeWord),
+        matchCase = matchCase,
+        matchWholeWord = matchWholeWord
+    )
+
+    @Synchronized
+    internal fun searchIncremental(
+        sessionPtr: Long,
+        query: String,
+        pageOrder: IntArray,
+        listener: DocumentSearchListener,
+    ): Int {
+        documentSearchListener = listener
+        return try {
+            nativeSearchSessionQuery(sessionPtr, mNativeDocPtr, query, pageOrder)
+        } catch (e: Exception) {
+            logWriter?.writeLog("Error searching document", TAG)
+            -1
+        } finally {
+            documentSearchListener = null
+        }
+    }
+
+    internal fun closeSearchSession(sessionPtr: Long) = nativeSearchSessionDestroy(sessionPtr)
+
+    /**
+     * The permanent identifier of the document, as a hex string, or null if the document has
+     * none. Full-text index files are named after it.
+     */
+    val documentIdentifier: String?
+        @Synchronized
+        get() = try {
+            nativeGetFileIdentifier(mNativeDocPtr, FILE_ID_PERMANENT)
+        } catch (e: Exception) {
+            logWriter?.writeLog("Error reading document identifier", TAG)
+            null
+        }
+
+    /**
+     * Identifies the revision of the document a full-text index is built for: the permanent and
+     * changing identifiers with the size and modification time of the file. A revised document
+     * keeps its permanent identifier, even when saved incrementally, but not all of these.
+     */
+    private val indexIdentity: String?
+        @Synchronized
+        get() {
+            val permanent = documentIdentifier ?: return null
+            val changing = try {
+                nativeGetFileIdentifier(mNativeDocPtr, FILE_ID_CHANGING)
+            } catch (e: Exception) {
+                null
+            }
+            val stat = try {
+                mFileDescriptor?.let { Os.fstat(it.fileDescriptor) }
+            } catch (e: ErrnoException) {
+                null
+            }
+            return "$permanent:${changing.orEmpty()}:${stat?.st_size ?: 0}:${stat?.st_mtime ?: 0}"
+        }
+
+    /**
+     * Opens the full-text index stored in [file], if it was built for the opened document.
+     *
+     * @return the index, or null if the file is missing, invalid, belongs to another document or
+     * the document has no identifier.
+     */
+    fun openFullTextIndex(file: File): FullTextIndex? {
+        val identity = indexIdentity ?: return null
+        val indexPtr = nativeFtsOpen(file.absolutePath, identity)
+        if (indexPtr == 0L) return null
+        val info = nativeFtsInfo(indexPtr)
+        if (info == null || info[0] != pageCount) {
+            nativeFtsClose(indexPtr)
+            return null
+        }
+        return FullTextIndex(this, indexPtr, pageCount = info[0], indexedPages = info[1])
+    }
+
+    /**
+     * Creates a builder writing the full-text index of the opened document to [file]. The
+     * builder resumes from the index already stored in [file] when it matches the document.
+     *
+     * @return the builder, or null if the document has no identifier to key the index with.
+     */
+    @Synchronized
+    fun newFullTextIndexBuilder(file: File): FullTextIndexBuilder? {
+        val identity = indexIdentity ?: return null
+        val pages = pageCount
+        val builderPtr = nativeFtsBuilderCreate(file.absolutePath, identity, pages)
+        return if (builderPtr == 0L) null else FullTextIndexBuilder(this, builderPtr, pages)
+    }
+
+    internal fun fullTextIndexBuilderIndexedPages(builderPtr: Long): Int =
+        nativeFtsBuilderIndexedPages(builderPtr)
+
+    @Synchronized
+    internal fun addFullTextIndexPages(builderPtr: Long, count: Int): Int =
+        nativeFtsBuilderAddPages(builderPtr, mNativeDocPtr, count)
+
+    internal fun saveFullTextIndex(builderPtr: Long): Boolean = nativeFtsBuilderSave(builderPtr)
+
+    internal fun destroyFullTextIndexBuilder(builderPtr: Long) = nativeFtsBuilderDestroy(builderPtr)
+
+    internal fun searchFullTextIndex(
+        indexPtr: Long,
+        query: String,
+        prefix: Boolean,
+        maxResults: Int,
+    ): IntArray? = nativeFtsSearch(indexPtr, query, prefix, maxResults)
+
+    internal fun closeFullTextIndex(indexPtr: Long) = nativeFtsClose(indexPtr)
+
     /**
      * A handle class for the search context. stopSearch must be called to release this handle.
      *
@@ -920,16 +1550,19 @@ class PdfiumCore : java.io.Closeable {
         object : FPDFTextSearchContext(pageIndex, query, matchCase, matchWholeWord) {
             private var mSearchHandlePtr: Long? = null
             override fun prepareSearch() {
-                val textPage = prepareTextInfo(pageIndex) // Ensures text page is loaded
+                val textPage = loadTextPage(pageIndex) // Ensures text page is loaded
                 // Stop any existing search on this page and remove its handle from the map
                 if (this@PdfiumCore.hasSearchHandle(pageIndex)) {
                     val oldSearchHandle = this@PdfiumCore.mNativeSearchHandlePtr.remove(pageIndex)
                     if (isValidPointer(oldSearchHandle)) {
                         nativeSearchStop(oldSearchHandle!!)
+                        nativePinTextPage(mNativeDocPtr, pageIndex, false)
                     }
                 }
                 mSearchHandlePtr = nativeSearchStart(textPage, query, matchCase, matchWholeWord)
                 if (isValidPointer(mSearchHandlePtr)) {
+                    // The search handle points into the text page, keep it cached while searching
+                    nativePinTextPage(mNativeDocPtr, pageIndex, true)
                     this@PdfiumCore.mNativeSearchHandlePtr[pageIndex] = mSearchHandlePtr!!
                 }
             }
@@ -968,11 +1601,15 @@ class PdfiumCore : java.io.Closeable {
 
             override fun stopSearch() {
                 super.stopSearch()
-                if (isValidPointer(mSearchHandlePtr)) {
+                // The handle may already have been stopped by a newer search or a page close
+                if (isValidPointer(mSearchHandlePtr) &&
+                    this@PdfiumCore.mNativeSearchHandlePtr[pageIndex] == mSearchHandlePtr
+                ) {
                     nativeSearchStop(mSearchHandlePtr!!)
+                    nativePinTextPage(mNativeDocPtr, pageIndex, false)
                     this@PdfiumCore.mNativeSearchHandlePtr.remove(pageIndex) // Remove from outer class map
-                    mSearchHandlePtr = null // Clear local handle
                 }
+                mSearchHandlePtr = null // Clear local handle
             }
         }
 
@@ -985,7 +1622,7 @@ class PdfiumCore : java.io.Closeable {
 
     fun hasPage(index: Int): Boolean = mNativePagesPtr.containsKey(index)
 
-    fun hasTextPage(index: Int): Boolean = mNativeTextPagesPtr.containsKey(index)
+    fun hasTextPage(index: Int): Boolean = nativeHasTextPage(mNativeDocPtr, index)
 
     fun hasSearchHandle(index: Int): Boolean = mNativeSearchHandlePtr.containsKey(index)
 
@@ -1016,6 +1653,13 @@ class PdfiumCore : java.io.Closeable {
     companion object {
         private const val TAG = "PdfiumCore"
 
+        /** Destination reported by nativeGetPageLinkTable for URLs found in the page text */
+        private const val WEB_LINK_DESTINATION = -2
+
+        /** Identifier types of nativeGetFileIdentifier */
+        private const val FILE_ID_PERMANENT = 0
+        private const val FILE_ID_CHANGING = 1
+
         init {
             System.loadLibrary("pdfium")
             System.loadLibrary("pdfium_jni")
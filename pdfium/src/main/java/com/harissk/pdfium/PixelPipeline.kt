@@ -0,0 +1,76 @@
+package com.harissk.pdfium
+
+import android.graphics.Color
+
+/**
+ * Colour transforms applied natively to rendered pixels by [PdfiumCore.renderPageBitmap], in the
+ * order they were added to the [Builder].
+ *
+ * Linear stages run as a single pass over the bitmap where possible, vectorized with SSE2 on x86
+ * and scalar on ARM. Only a [tone] with a gamma other than 1 takes a table pass of its own.
+ *
+ * Pipelines with the same stages are equal.
+ */
+class PixelPipeline private constructor(internal val stages: FloatArray) {
+
+    override fun equals(other: Any?): Boolean =
+        other is PixelPipeline && stages.contentEquals(other.stages)
+
+    override fun hashCode(): Int = stages.contentHashCode()
+
+    class Builder {
+        private var stages = FloatArray(0)
+
+        /** Inverts every channel, dark text on white pages turns light on black. */
+        fun invert(): Builder = stage(STAGE_INVERT)
+
+        /** Inverts lightness only, so that coloured content keeps its hue. */
+        fun invertLuminance(): Builder = stage(STAGE_INVERT_LUMINANCE)
+
+        /** Replaces colours by their luminance. */
+        fun grayscale(): Builder = stage(STAGE_GRAYSCALE)
+
+        /**
+         * Adjusts the tone curve of every channel.
+         *
+         * @param gamma Values below 1 darken the midtones, which brings out faint scans.
+         * @param contrast Scales the distance to mid gray, values above 1 increase contrast.
+         */
+        fun tone(gamma: Float = 1f, contrast: Float = 1f): Builder =
+            stage(STAGE_TONE, gamma, contrast)
+
+        /**
+         * Maps white to the ARGB [paper] colour and black to the [ink] colour, with the levels in
+         * between.
+         */
+        fun tint(paper: Int, ink: Int = Color.BLACK): Builder = stage(
+            STAGE_TINT,
+            Color.red(paper).toFloat(),
+            Color.green(paper).toFloat(),
+            Color.blue(paper).toFloat(),
+            Color.red(ink).toFloat(),
+            Color.green(ink).toFloat(),
+            Color.blue(ink).toFloat()
+        )
+
+        private fun stage(type: Int, vararg params: Float): Builder {
+            val offset = stages.size
+            stages = stages.copyOf(offset + STAGE_SIZE)
+            stages[offset] = type.toFloat()
+            params.copyInto(stages, offset + 1)
+            return this
+        }
+
+        fun build(): PixelPipeline = PixelPipeline(stages.copyOf())
+    }
+
+    private companion object {
+        // Type plus up to six parameters, must match PIXEL_STAGE_SIZE of the native code
+        const val STAGE_SIZE = 7
+        const val STAGE_INVERT = 1
+        const val STAGE_INVERT_LUMINANCE = 2
+        const val STAGE_GRAYSCALE = 3
+        const val STAGE_TONE = 4
+        const val STAGE_TINT = 5
+    }
+}
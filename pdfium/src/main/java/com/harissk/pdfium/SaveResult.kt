@@ -0,0 +1,16 @@
+package com.harissk.pdfium
+
+/**
+ * The outcome of saving a document.
+ *
+ * @param bytesWritten The size of the saved file.
+ * @param elapsedNanos The time spent saving, in nanoseconds.
+ */
+data class SaveResult(
+    val bytesWritten: Long,
+    val elapsedNanos: Long,
+) {
+
+    val elapsedMillis: Long
+        get() = elapsedNanos / 1_000_000
+}
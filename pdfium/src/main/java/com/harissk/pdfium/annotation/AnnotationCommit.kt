@@ -0,0 +1,21 @@
+package com.harissk.pdfium.annotation
+
+import android.graphics.RectF
+
+/**
+ * The outcome of an [AnnotationTransaction].
+ *
+ * @param indices The index of the annotation each edit added, updated or removed, in the order of
+ * the edits, -1 for the edits that failed.
+ * @param dirtyBounds The union of the rects of the annotations touched, before and after the
+ * edits, as fractions of the displayed page. Null if nothing changed.
+ */
+class AnnotationCommit(
+    val indices: IntArray,
+    val dirtyBounds: RectF?,
+) {
+
+    /** True if every edit was applied */
+    val isSuccessful: Boolean
+        get() = indices.none { it < 0 }
+}
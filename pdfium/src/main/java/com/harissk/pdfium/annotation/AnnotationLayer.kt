@@ -0,0 +1,70 @@
+package com.harissk.pdfium.annotation
+
+import android.graphics.RectF
+
+/**
+ * The annotations of a page that the viewer draws itself, above the page content rendered
+ * without annotations. Changing one of them then only redraws this layer, the rendered content
+ * stays valid.
+ *
+ * @param annotations The annotations, in drawing order.
+ * @param isComplete True when [annotations] holds every visible annotation of the page. Otherwise
+ * some annotation, like a form field, a stamp or any annotation with its own appearance stream,
+ * can only be rendered by pdfium together with the page content.
+ */
+class AnnotationLayer(
+    val annotations: List<PageAnnotation>,
+    val isComplete: Boolean,
+) {
+
+    /**
+     * Returns the union of the bounds of the annotations that are in only one of this layer and
+     * [previous], as fractions of the page, or null if both draw the same.
+     */
+    fun dirtyBounds(previous: AnnotationLayer?): RectF? {
+        val before = previous?.annotations.orEmpty()
+        var dirty: RectF? = null
+        val changed = (annotations - before.toSet()) + (before - annotations.toSet())
+        for (annotation in changed) {
+            dirty = dirty?.apply { union(annotation.bounds) } ?: RectF(annotation.bounds)
+        }
+        return dirty
+    }
+
+    companion object {
+        private const val INFO_SIZE = 5
+
+        /** Parses the table of nativeGetPageAnnotationTable */
+        internal fun fromTable(info: IntArray, geometry: FloatArray): AnnotationLayer {
+            val count = (info.size - 1) / INFO_SIZE
+            val annotations = List(count) { i ->
+                val at = 1 + i * INFO_SIZE
+                var offset = info[at + 4]
+                val bounds = RectF(
+                    geometry[offset],
+                    geometry[offset + 1],
+                    geometry[offset + 2],
+                    geometry[offset + 3]
+                )
+                val borderWidth = geometry[offset + 4]
+                val pathCount = geometry[offset + 5].toInt()
+                offset += 6
+                val paths = List(pathCount) {
+                    val points = geometry[offset].toInt()
+                    geometry.copyOfRange(offset + 1, offset + 1 + points * 2)
+                        .also { offset += 1 + points * 2 }
+                }
+                PageAnnotation(
+                    index = info[at],
+                    subtype = info[at + 1],
+                    color = info[at + 2],
+                    interiorColor = info[at + 3],
+                    bounds = bounds,
+                    borderWidth = borderWidth,
+                    paths = paths
+                )
+            }
+            return AnnotationLayer(annotations, isComplete = info.firstOrNull() == 1)
+        }
+    }
+}
@@ -0,0 +1,142 @@
+package com.harissk.pdfium.annotation
+
+import android.graphics.RectF
+
+/**
+ * A batch of annotation edits of one page, applied in memory in a single native call by
+ * PdfiumCore.applyAnnotationTransaction. The page stays open and the document is not saved, so
+ * hundreds of edits cost one call instead of a save and a page reload each.
+ *
+ * Edits are applied in order and indices refer to the annotations as the previous edits left
+ * them: removing annotation 2 makes annotation 3 the new annotation 2. Geometry is in fractions of
+ * the displayed page, like [PageAnnotation].
+ */
+class AnnotationTransaction {
+
+    private var edits = IntArray(INITIAL_CAPACITY * EDIT_SIZE)
+    private var values = FloatArray(INITIAL_CAPACITY * 8)
+    private val texts = ArrayList<String?>()
+    private var valueCount = 0
+
+    /** The number of edits recorded so far */
+    val size: Int
+        get() = texts.size
+
+    /**
+     * Adds an annotation with the subtype, colors, bounds, border width and paths of
+     * [annotation], its index is ignored. Markups take one quad per path and ink one stroke per
+     * path. Text notes, markups, ink, squares and circles can be added, pdfium cannot create the
+     * geometry of lines, polygons and polylines.
+     *
+     * @param contents The text of the annotation, shown in its popup.
+     */
+    fun add(annotation: PageAnnotation, contents: String? = null): AnnotationTransaction {
+        var fields = FIELD_COLOR or FIELD_BOUNDS or FIELD_BORDER or FIELD_PATHS
+        if (annotation.interiorColor != 0) fields = fields or FIELD_INTERIOR_COLOR
+        if (contents != null) fields = fields or FIELD_CONTENTS
+        val offset = valueCount
+        putBounds(annotation.bounds)
+        putValue(annotation.borderWidth)
+        putValue(annotation.paths.size.toFloat())
+        for (path in annotation.paths) {
+            putValue((path.size / 2).toFloat())
+            for (i in 0 until path.size / 2 * 2) putValue(path[i])
+        }
+        return edit(
+            EDIT_ADD, -1, annotation.subtype, annotation.color, annotation.interiorColor,
+            fields, offset, contents
+        )
+    }
+
+    /**
+     * Changes the given properties of the annotation at [index], null ones are left as they
+     * are. Changing anything but [contents] drops the appearance stream of the annotation, so it
+     * is drawn from its properties from now on. pdfium can only draw text notes, popups,
+     * markups, ink, squares and circles that way, such an edit of any other annotation fails
+     * and leaves it untouched.
+     */
+    fun update(
+        index: Int,
+        color: Int? = null,
+        interiorColor: Int? = null,
+        bounds: RectF? = null,
+        borderWidth: Float? = null,
+        contents: String? = null,
+    ): AnnotationTransaction {
+        var fields = 0
+        if (color != null) fields = fields or FIELD_COLOR
+        if (interiorColor != null) fields = fields or FIELD_INTERIOR_COLOR
+        if (contents != null) fields = fields or FIELD_CONTENTS
+        val offset = valueCount
+        if (bounds != null) {
+            fields = fields or FIELD_BOUNDS
+            putBounds(bounds)
+        }
+        if (borderWidth != null) {
+            fields = fields or FIELD_BORDER
+            putValue(borderWidth)
+        }
+        return edit(
+            EDIT_UPDATE, index, 0, color ?: 0, interiorColor ?: 0, fields, offset, contents
+        )
+    }
+
+    /** Removes the annotation at [index] */
+    fun remove(index: Int): AnnotationTransaction =
+        edit(EDIT_REMOVE, index, 0, 0, 0, 0, valueCount, null)
+
+    private fun edit(
+        kind: Int,
+        index: Int,
+        subtype: Int,
+        color: Int,
+        interiorColor: Int,
+        fields: Int,
+        valueOffset: Int,
+        contents: String?,
+    ): AnnotationTransaction {
+        val at = texts.size * EDIT_SIZE
+        if (at + EDIT_SIZE > edits.size) edits = edits.copyOf(edits.size * 2)
+        edits[at] = kind
+        edits[at + 1] = index
+        edits[at + 2] = subtype
+        edits[at + 3] = color
+        edits[at + 4] = interiorColor
+        edits[at + 5] = fields
+        edits[at + 6] = valueOffset
+        texts += contents
+        return this
+    }
+
+    private fun putBounds(bounds: RectF) {
+        putValue(bounds.left)
+        putValue(bounds.top)
+        putValue(bounds.right)
+        putValue(bounds.bottom)
+    }
+
+    private fun putValue(value: Float) {
+        if (valueCount == values.size) values = values.copyOf(values.size * 2)
+        values[valueCount++] = value
+    }
+
+    internal fun editTable(): IntArray = edits.copyOf(texts.size * EDIT_SIZE)
+    internal fun valueTable(): FloatArray = values.copyOf(valueCount)
+    internal fun textTable(): Array<String?> = texts.toTypedArray()
+
+    companion object {
+        private const val INITIAL_CAPACITY = 16
+
+        // Layout shared with nativeApplyAnnotationEdits
+        private const val EDIT_SIZE = 7
+        private const val EDIT_ADD = 0
+        private const val EDIT_UPDATE = 1
+        private const val EDIT_REMOVE = 2
+        private const val FIELD_COLOR = 1
+        private const val FIELD_INTERIOR_COLOR = 1 shl 1
+        private const val FIELD_BOUNDS = 1 shl 2
+        private const val FIELD_BORDER = 1 shl 3
+        private const val FIELD_CONTENTS = 1 shl 4
+        private const val FIELD_PATHS = 1 shl 5
+    }
+}
@@ -0,0 +1,63 @@
+package com.harissk.pdfium.annotation
+
+import android.graphics.RectF
+
+/**
+ * An annotation that the viewer draws itself from its properties, see [AnnotationLayer].
+ *
+ * Geometry is in fractions of the displayed page, so `top` is less than `bottom`. Two annotations
+ * are equal when they draw the same, whatever their [index].
+ *
+ * @param index The index of the annotation on its page.
+ * @param subtype The annotation subtype, one of the `SUBTYPE_` constants.
+ * @param color The stroke color, or the color of text markups, as ARGB.
+ * @param interiorColor The fill color of shapes as ARGB, 0 if they are not filled.
+ * @param bounds The annotation rect.
+ * @param borderWidth The border width as a fraction of the page width.
+ * @param paths x, y pairs of the quads of text markups (top left, top right, bottom left and
+ * bottom right corners), of the strokes of ink, of the line or of the vertices.
+ */
+class PageAnnotation(
+    val index: Int,
+    val subtype: Int,
+    val color: Int,
+    val interiorColor: Int,
+    val bounds: RectF,
+    val borderWidth: Float,
+    val paths: List<FloatArray>,
+) {
+
+    override fun equals(other: Any?): Boolean =
+        other is PageAnnotation &&
+                subtype == other.subtype &&
+                color == other.color &&
+                interiorColor == other.interiorColor &&
+                bounds == other.bounds &&
+                borderWidth == other.borderWidth &&
+                paths.size == other.paths.size &&
+                paths.indices.all { paths[it].contentEquals(other.paths[it]) }
+
+    override fun hashCode(): Int {
+        var result = subtype
+        result = 31 * result + color
+        result = 31 * result + interiorColor
+        result = 31 * result + bounds.hashCode()
+        result = 31 * result + borderWidth.hashCode()
+        paths.forEach { result = 31 * result + it.contentHashCode() }
+        return result
+    }
+
+    companion object {
+        const val SUBTYPE_TEXT = 1
+        const val SUBTYPE_LINE = 4
+        const val SUBTYPE_SQUARE = 5
+        const val SUBTYPE_CIRCLE = 6
+        const val SUBTYPE_POLYGON = 7
+        const val SUBTYPE_POLYLINE = 8
+        const val SUBTYPE_HIGHLIGHT = 9
+        const val SUBTYPE_UNDERLINE = 10
+        const val SUBTYPE_SQUIGGLY = 11
+        const val SUBTYPE_STRIKEOUT = 12
+        const val SUBTYPE_INK = 15
+    }
+}
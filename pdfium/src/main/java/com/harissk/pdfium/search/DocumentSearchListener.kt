@@ -0,0 +1,16 @@
+package com.harissk.pdfium.search
+
+/**
+ * Receives the results of a document wide search page by page, as soon as each page is searched.
+ */
+fun interface DocumentSearchListener {
+
+    /**
+     * Called once for every searched page, also when it has no match.
+     *
+     * @param pageIndex The index of the searched page.
+     * @param matches The matches found on the page, empty if none.
+     * @return true to continue with the next page, false to cancel the search.
+     */
+    fun onPageResults(pageIndex: Int, matches: List<SearchMatch>): Boolean
+}
@@ -0,0 +1,42 @@
+package com.harissk.pdfium.search
+
+import com.harissk.pdfium.PdfiumCore
+import java.io.Closeable
+
+/**
+ * Search as you type over the document opened in a [PdfiumCore].
+ *
+ * Each page text is read once per session. Results are kept per query, so extending the query
+ * only re-checks the matches of the previous one and deleting characters reuses the results of
+ * the shorter query. Pages are searched in the order given to [search], so the visible pages can
+ * be reported first.
+ *
+ * Matches are reported with highlight rects only for pages whose text page is already loaded,
+ * [PdfiumCore.getTextRects] measures the others when they are needed.
+ *
+ * A session is bound to its match options, start a new one when they change.
+ */
+class IncrementalSearchSession internal constructor(
+    private val core: PdfiumCore,
+    private var sessionPtr: Long,
+    val matchCase: Boolean,
+    val matchWholeWord: Boolean,
+) : Closeable {
+
+    /**
+     * Searches [pageOrder] for [query], reporting every page to [listener] in that order.
+     *
+     * @param pageOrder indexes of the pages to search, in the order they are searched.
+     * @return the number of matches, or -1 if the search was cancelled.
+     */
+    fun search(query: String, pageOrder: IntArray, listener: DocumentSearchListener): Int {
+        if (query.isEmpty() || sessionPtr == 0L) return 0
+        return core.searchIncremental(sessionPtr, query, pageOrder, listener)
+    }
+
+    override fun close() {
+        if (sessionPtr == 0L) return
+        core.closeSearchSession(sessionPtr)
+        sessionPtr = 0
+    }
+}
@@ -0,0 +1,18 @@
+package com.harissk.pdfium.search
+
+import android.graphics.RectF
+
+/**
+ * A match of a document wide search.
+ *
+ * @param pageIndex The index of the page holding the match.
+ * @param charIndex The index of the first matched character on the page.
+ * @param charCount The number of matched characters.
+ * @param rects The highlight rectangles of the match in PDF "user space", one per line.
+ */
+data class SearchMatch(
+    val pageIndex: Int,
+    val charIndex: Int,
+    val charCount: Int,
+    val rects: List<RectF>,
+)
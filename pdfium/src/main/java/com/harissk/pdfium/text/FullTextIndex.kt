@@ -0,0 +1,52 @@
+package com.harissk.pdfium.text
+
+import com.harissk.pdfium.PdfiumCore
+import java.io.Closeable
+
+/**
+ * A word index of a document, memory mapped from the sidecar file written by a
+ * [FullTextIndexBuilder]. Queries are answered from the file alone, the document pages are not
+ * loaded.
+ *
+ * Words are runs of letters and digits, matched case insensitively. A partially built index only
+ * answers for its first [indexedPages] pages.
+ */
+class FullTextIndex internal constructor(
+    private val core: PdfiumCore,
+    private var indexPtr: Long,
+    /** The number of pages of the document the index was built for. */
+    val pageCount: Int,
+    /** The number of pages indexed so far, starting from the first one. */
+    val indexedPages: Int,
+) : Closeable {
+
+    /** True once every page of the document is indexed. */
+    val isComplete: Boolean
+        get() = indexedPages >= pageCount
+
+    /**
+     * Finds the occurrences of the last word of [query] on pages that also contain every other
+     * word of it.
+     *
+     * @param query The words to look for.
+     * @param prefix When true, the last word also matches longer words starting with it.
+     * @param maxResults The maximum number of positions returned, negative for no limit.
+     * @return the positions of the last word, ordered by word then by page.
+     */
+    fun search(query: String, prefix: Boolean = true, maxResults: Int = -1): List<TextPosition> {
+        val triples = synchronized(this) {
+            if (indexPtr == 0L) return emptyList()
+            core.searchFullTextIndex(indexPtr, query, prefix, maxResults)
+        } ?: return emptyList()
+        return List(triples.size / 3) { i ->
+            TextPosition(triples[i * 3], triples[i * 3 + 1], triples[i * 3 + 2])
+        }
+    }
+
+    @Synchronized
+    override fun close() {
+        if (indexPtr == 0L) return
+        core.closeFullTextIndex(indexPtr)
+        indexPtr = 0
+    }
+}
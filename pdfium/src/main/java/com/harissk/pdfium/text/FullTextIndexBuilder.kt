@@ -0,0 +1,52 @@
+package com.harissk.pdfium.text
+
+import com.harissk.pdfium.PdfiumCore
+import java.io.Closeable
+
+/**
+ * Builds the [FullTextIndex] of the document opened in a [PdfiumCore], a few pages at a time.
+ *
+ * The builder resumes from the sidecar file when it already holds a partial index of the same
+ * document, so calling [indexPages] and [save] in batches spreads the work across sessions.
+ *
+ * Not thread safe. [indexPages] loads pages of the document and must not run concurrently with
+ * other calls on the same [PdfiumCore].
+ */
+class FullTextIndexBuilder internal constructor(
+    private val core: PdfiumCore,
+    private var builderPtr: Long,
+    /** The number of pages of the document. */
+    val pageCount: Int,
+) : Closeable {
+
+    /** The number of pages indexed so far, starting from the first one. */
+    val indexedPages: Int
+        get() = if (builderPtr == 0L) 0 else core.fullTextIndexBuilderIndexedPages(builderPtr)
+
+    /** True once every page of the document is indexed. */
+    val isComplete: Boolean
+        get() = indexedPages >= pageCount
+
+    /**
+     * Indexes the next [count] pages.
+     *
+     * @return the number of pages indexed so far.
+     */
+    fun indexPages(count: Int): Int {
+        check(builderPtr != 0L) { "Builder is closed" }
+        return core.addFullTextIndexPages(builderPtr, count)
+    }
+
+    /**
+     * Writes the index to its sidecar file, replacing the previous one atomically.
+     *
+     * @return true if the file was written.
+     */
+    fun save(): Boolean = builderPtr != 0L && core.saveFullTextIndex(builderPtr)
+
+    override fun close() {
+        if (builderPtr == 0L) return
+        core.destroyFullTextIndexBuilder(builderPtr)
+        builderPtr = 0
+    }
+}
@@ -0,0 +1,148 @@
+package com.harissk.pdfium.text
+
+import android.graphics.RectF
+import java.nio.ByteBuffer
+import java.nio.FloatBuffer
+import java.nio.IntBuffer
+import kotlin.math.abs
+
+/**
+ * Characters of a page with their boxes and font metrics, exported from the native text page in
+ * a single call. All queries are answered from memory without further native calls.
+ *
+ * Boxes are in PDF "user space", so `top` is greater than `bottom`. The loose box covers the
+ * full line height of the font and is the one to use for hit-testing and selection, the tight
+ * box only covers the glyph outline.
+ *
+ * The buffer holds one array per field (struct of arrays), in the order of the `FIELD_` constants.
+ *
+ * @param count The number of characters of the page.
+ */
+class GlyphTable internal constructor(val count: Int, buffer: ByteBuffer) {
+
+    private val ints: IntBuffer = buffer.asIntBuffer()
+    private val floats: FloatBuffer = buffer.asFloatBuffer()
+
+    private fun int(field: Int, index: Int): Int = ints.get(field * count + index)
+    private fun float(field: Int, index: Int): Float = floats.get(field * count + index)
+
+    /** Unicode code point of the character, 0 if it has none. */
+    fun unicode(index: Int): Int = int(FIELD_UNICODE, index)
+
+    fun looseLeft(index: Int): Float = float(FIELD_LOOSE_LEFT, index)
+    fun looseTop(index: Int): Float = float(FIELD_LOOSE_TOP, index)
+    fun looseRight(index: Int): Float = float(FIELD_LOOSE_RIGHT, index)
+    fun looseBottom(index: Int): Float = float(FIELD_LOOSE_BOTTOM, index)
+
+    /** Writes the loose box of the character into [out] and returns it. */
+    fun looseBox(index: Int, out: RectF = RectF()): RectF = out.apply {
+        set(looseLeft(index), looseTop(index), looseRight(index), looseBottom(index))
+    }
+
+    /** Writes the tight box of the character into [out] and returns it. */
+    fun charBox(index: Int, out: RectF = RectF()): RectF = out.apply {
+        set(
+            float(FIELD_LEFT, index),
+            float(FIELD_TOP, index),
+            float(FIELD_RIGHT, index),
+            float(FIELD_BOTTOM, index)
+        )
+    }
+
+    fun originX(index: Int): Float = float(FIELD_ORIGIN_X, index)
+    fun originY(index: Int): Float = float(FIELD_ORIGIN_Y, index)
+
+    /** Font size in points. */
+    fun fontSize(index: Int): Float = float(FIELD_FONT_SIZE, index)
+
+    /** Font weight, typically 400 for normal and 700 for bold, -1 if unknown. */
+    fun fontWeight(index: Int): Int = int(FIELD_FONT_WEIGHT, index)
+
+    /** Returns the text of [length] characters starting at [start]. */
+    fun text(start: Int, length: Int): String {
+        val end = (start + length).coerceAtMost(count)
+        return buildString((end - start).coerceAtLeast(0)) {
+            for (i in start.coerceAtLeast(0) until end) {
+                val codePoint = unicode(i)
+                if (codePoint > 0) appendCodePoint(codePoint)
+            }
+        }
+    }
+
+    /**
+     * Returns the index of the character whose loose box contains the point, grown by the
+     * tolerances, or -1. When several boxes match, the one whose center is the closest wins.
+     */
+    fun indexAt(x: Float, y: Float, xTolerance: Float = 0f, yTolerance: Float = 0f): Int {
+        var found = -1
+        var foundDistance = Float.MAX_VALUE
+        for (i in 0 until count) {
+            val left = looseLeft(i) - xTolerance
+            val right = looseRight(i) + xTolerance
+            val bottom = looseBottom(i) - yTolerance
+            val top = looseTop(i) + yTolerance
+            if (x < left || x > right || y < bottom || y > top) continue
+
+            val distance = abs((left + right) / 2 - x) + abs((bottom + top) / 2 - y)
+            if (distance < foundDistance) {
+                found = i
+                foundDistance = distance
+            }
+        }
+        return found
+    }
+
+    /**
+     * Returns the boxes covering [length] characters from [start], with the loose boxes of
+     * consecutive characters on the same line merged into one rect.
+     */
+    fun rangeRects(start: Int, length: Int): List<RectF> {
+        val rects = mutableListOf<RectF>()
+        var current: RectF? = null
+        val end = (start + length).coerceAtMost(count)
+        for (i in start.coerceAtLeast(0) until end) {
+            val left = looseLeft(i)
+            val right = looseRight(i)
+            // Generated characters such as line breaks have empty boxes
+            if (right <= left) continue
+            val top = looseTop(i)
+            val bottom = looseBottom(i)
+            val line = current
+            if (line != null && sameLine(line, top, bottom) && left >= line.left) {
+                // RectF.union expects top < bottom, PDF boxes are the other way round
+                line.right = maxOf(line.right, right)
+                line.top = maxOf(line.top, top)
+                line.bottom = minOf(line.bottom, bottom)
+            } else {
+                current = RectF(left, top, right, bottom).also { rects += it }
+            }
+        }
+        return rects
+    }
+
+    // PDF boxes have top > bottom, overlap of more than half the height means the same line
+    private fun sameLine(line: RectF, top: Float, bottom: Float): Boolean {
+        val overlap = minOf(line.top, top) - maxOf(line.bottom, bottom)
+        return overlap > minOf(line.top - line.bottom, top - bottom) / 2
+    }
+
+    companion object {
+        internal const val FIELD_UNICODE = 0
+        internal const val FIELD_LOOSE_LEFT = 1
+        internal const val FIELD_LOOSE_TOP = 2
+        internal const val FIELD_LOOSE_RIGHT = 3
+        internal const val FIELD_LOOSE_BOTTOM = 4
+        internal const val FIELD_LEFT = 5
+        internal const val FIELD_TOP = 6
+        internal const val FIELD_RIGHT = 7
+        internal const val FIELD_BOTTOM = 8
+        internal const val FIELD_ORIGIN_X = 9
+        internal const val FIELD_ORIGIN_Y = 10
+        internal const val FIELD_FONT_SIZE = 11
+        internal const val FIELD_FONT_WEIGHT = 12
+        internal const val FIELD_COUNT = 13
+
+        /** Bytes needed to hold the table of [count] characters. */
+        internal fun bytesFor(count: Int): Int = count * FIELD_COUNT * 4
+    }
+}
@@ -0,0 +1,16 @@
+package com.harissk.pdfium.text
+
+/**
+ * Receives the progress of a document text extraction.
+ */
+fun interface TextExtractionListener {
+
+    /**
+     * Called after every extracted page.
+     *
+     * @param pagesDone The number of pages extracted so far.
+     * @param pageCount The number of pages to extract.
+     * @return true to continue with the next page, false to cancel the extraction.
+     */
+    fun onProgress(pagesDone: Int, pageCount: Int): Boolean
+}
@@ -0,0 +1,14 @@
+package com.harissk.pdfium.text
+
+/**
+ * A run of characters on a page, as found by a [FullTextIndex].
+ *
+ * @param pageIndex The index of the page.
+ * @param charIndex The index of the first character on the page.
+ * @param charCount The number of characters.
+ */
+data class TextPosition(
+    val pageIndex: Int,
+    val charIndex: Int,
+    val charCount: Int,
+)
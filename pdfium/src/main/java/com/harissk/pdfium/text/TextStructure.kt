@@ -0,0 +1,78 @@
+package com.harissk.pdfium.text
+
+/**
+ * Words, lines and blocks of a page, computed natively once per text page from the glyph boxes
+ * and the reading order of pdfium.
+ *
+ * Each unit is a range of character indexes, in reading order. Words are runs of letters and
+ * digits. Lines end at line breaks or where the text leaves the line. Blocks are successive
+ * lines of similar height without a large gap between them, typically paragraphs.
+ *
+ * The lookups are binary searches over arrays and make no native call.
+ */
+class TextStructure internal constructor(data: IntArray) {
+
+    private val words: IntArray
+    private val lines: IntArray
+    private val blocks: IntArray
+
+    init {
+        val wordEnd = 3 + data[0] * 2
+        val lineEnd = wordEnd + data[1] * 2
+        words = data.copyOfRange(3, wordEnd)
+        lines = data.copyOfRange(wordEnd, lineEnd)
+        blocks = data.copyOfRange(lineEnd, lineEnd + data[2] * 2)
+    }
+
+    val wordCount: Int get() = words.size / 2
+    val lineCount: Int get() = lines.size / 2
+    val blockCount: Int get() = blocks.size / 2
+
+    /** Character range of the word at [index], in reading order. */
+    fun word(index: Int): IntRange = range(words, index)
+
+    /** Character range of the line at [index], in reading order. */
+    fun line(index: Int): IntRange = range(lines, index)
+
+    /** Character range of the block at [index], in reading order. */
+    fun block(index: Int): IntRange = range(blocks, index)
+
+    /** Returns the index of the word holding [charIndex], or -1 if it is not part of a word. */
+    fun wordIndexAt(charIndex: Int): Int = indexAt(words, charIndex)
+
+    /** Returns the index of the line holding [charIndex], or -1 if it is not part of a line. */
+    fun lineIndexAt(charIndex: Int): Int = indexAt(lines, charIndex)
+
+    /** Returns the index of the block holding [charIndex], or -1 if it is not part of a block. */
+    fun blockIndexAt(charIndex: Int): Int = indexAt(blocks, charIndex)
+
+    /** Character range of the word holding [charIndex], for double tap selection. */
+    fun wordAt(charIndex: Int): IntRange? = wordIndexAt(charIndex).takeIf { it >= 0 }?.let(::word)
+
+    /** Character range of the line holding [charIndex]. */
+    fun lineAt(charIndex: Int): IntRange? = lineIndexAt(charIndex).takeIf { it >= 0 }?.let(::line)
+
+    /** Character range of the block holding [charIndex], for triple tap selection. */
+    fun blockAt(charIndex: Int): IntRange? =
+        blockIndexAt(charIndex).takeIf { it >= 0 }?.let(::block)
+
+    private fun range(ranges: IntArray, index: Int): IntRange =
+        ranges[index * 2] until ranges[index * 2 + 1]
+
+    // Ranges are sorted and disjoint, find the last one starting at or before charIndex
+    private fun indexAt(ranges: IntArray, charIndex: Int): Int {
+        var low = 0
+        var high = ranges.size / 2 - 1
+        var found = -1
+        while (low <= high) {
+            val mid = (low + high) ushr 1
+            if (ranges[mid * 2] <= charIndex) {
+                found = mid
+                low = mid + 1
+            } else {
+                high = mid - 1
+            }
+        }
+        return if (found >= 0 && charIndex < ranges[found * 2 + 1]) found else -1
+    }
+}
@@ -0,0 +1,214 @@
+/**
+ * Copyright [2025] [Haris Kumar R](https://github.com/rhariskumar3)
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ * */
+
+/**
+ * JVM benchmark of the part lookups of CacheManager: the hash index keyed by page, quantized
+ * bounds and zoom level with its sorted eviction set, against the two priority queues scanned by
+ * page and bounds that it replaced.
+ *
+ * Both are driven like PagesLoader drives the cache: every pass starts a new set, then asks for
+ * the cells around the current position, moving found parts back to the active set and caching
+ * the missing ones, evicting the oldest parts once the cache is full. Android types are not
+ * available on the JVM, bitmaps are left out and RectF is replaced by a data class with the same
+ * equality. Without evictions both caches must find and keep the same parts. Evictions differ on
+ * purpose, the index evicts older sets first.
+ *
+ * Run with the Kotlin command line tools: kotlin CacheLookupBenchmark.main.kts
+ */
+
+import java.util.PriorityQueue
+import java.util.TreeSet
+import kotlin.math.roundToInt
+
+data class Bounds(val left: Float, val top: Float, val right: Float, val bottom: Float)
+
+class Part(val page: Int, val bounds: Bounds, val zoomLevel: Int, var cacheOrder: Int)
+
+interface PartCache {
+    fun makeANewSet()
+    fun upPartIfContained(page: Int, bounds: Bounds, zoomLevel: Int, toOrder: Int): Boolean
+    fun cachePart(part: Part)
+    fun partKeys(): Set<Triple<Int, Bounds, Int>>
+}
+
+/** The lookups CacheManager had before the index: priority queues scanned by page and bounds */
+class QueueCache(private val maxParts: Int) : PartCache {
+    private val comparator = Comparator<Part> { a, b -> a.cacheOrder.compareTo(b.cacheOrder) }
+    private val passive = PriorityQueue(maxParts, comparator)
+    private val active = PriorityQueue(maxParts, comparator)
+
+    override fun makeANewSet() {
+        passive.addAll(active)
+        active.clear()
+    }
+
+    override fun upPartIfContained(
+        page: Int,
+        bounds: Bounds,
+        zoomLevel: Int,
+        toOrder: Int,
+    ): Boolean {
+        fun matches(part: Part) =
+            part.page == page && part.bounds == bounds && part.zoomLevel == zoomLevel
+        if (active.any(::matches)) return true
+        val part = passive.firstOrNull(::matches) ?: return false
+        passive.remove(part)
+        part.cacheOrder = toOrder
+        active.offer(part)
+        return true
+    }
+
+    override fun cachePart(part: Part) {
+        while (active.size + passive.size >= maxParts) passive.poll() ?: active.poll()
+        active.offer(part)
+    }
+
+    override fun partKeys() =
+        (active + passive).map { Triple(it.page, it.bounds, it.zoomLevel) }.toSet()
+}
+
+/** The index of CacheManager, see PartKey and CACHED_PART_COMPARATOR there */
+class IndexedCache(private val maxParts: Int) : PartCache {
+    private data class PartKey(
+        val page: Int,
+        val left: Int,
+        val top: Int,
+        val right: Int,
+        val bottom: Int,
+        val zoomLevel: Int,
+    )
+
+    private class CachedPart(val part: Part, var generation: Int, val sequence: Long)
+
+    private val partIndex = HashMap<PartKey, CachedPart>()
+    private val evictionQueue = TreeSet(Comparator<CachedPart> { a, b ->
+        when {
+            a.generation != b.generation -> a.generation.compareTo(b.generation)
+            a.part.cacheOrder != b.part.cacheOrder ->
+                a.part.cacheOrder.compareTo(b.part.cacheOrder)
+
+            else -> a.sequence.compareTo(b.sequence)
+        }
+    })
+    private var generation = 0
+    private var sequence = 0L
+
+    private fun keyOf(page: Int, bounds: Bounds, zoomLevel: Int) = PartKey(
+        page = page,
+        left = (bounds.left * BOUNDS_QUANTUM).roundToInt(),
+        top = (bounds.top * BOUNDS_QUANTUM).roundToInt(),
+        right = (bounds.right * BOUNDS_QUANTUM).roundToInt(),
+        bottom = (bounds.bottom * BOUNDS_QUANTUM).roundToInt(),
+        zoomLevel = zoomLevel
+    )
+
+    override fun makeANewSet() {
+        generation++
+    }
+
+    override fun upPartIfContained(
+        page: Int,
+        bounds: Bounds,
+        zoomLevel: Int,
+        toOrder: Int,
+    ): Boolean {
+        val cachedPart = partIndex[keyOf(page, bounds, zoomLevel)] ?: return false
+        if (cachedPart.generation == generation) return true
+        evictionQueue.remove(cachedPart)
+        cachedPart.generation = generation
+        cachedPart.part.cacheOrder = toOrder
+        evictionQueue.add(cachedPart)
+        return true
+    }
+
+    override fun cachePart(part: Part) {
+        while (partIndex.size >= maxParts) {
+            val oldest = evictionQueue.pollFirst() ?: break
+            partIndex.remove(keyOf(oldest.part.page, oldest.part.bounds, oldest.part.zoomLevel))
+        }
+        val cachedPart = CachedPart(part, generation, sequence++)
+        partIndex[keyOf(part.page, part.bounds, part.zoomLevel)] = cachedPart
+        evictionQueue.add(cachedPart)
+    }
+
+    override fun partKeys() =
+        partIndex.values.map { Triple(it.part.page, it.part.bounds, it.part.zoomLevel) }.toSet()
+
+    private companion object {
+        const val BOUNDS_QUANTUM = 65536f
+    }
+}
+
+/** Cells of a pass: a grid over the pages around [position], like PagesLoader asks for them */
+fun passCells(position: Int, cellsPerSide: Int, pages: Int): List<Triple<Int, Bounds, Int>> {
+    val step = 1f / cellsPerSide
+    val cells = ArrayList<Triple<Int, Bounds, Int>>()
+    for (page in position until position + pages) {
+        for (row in 0 until cellsPerSide) {
+            for (column in 0 until cellsPerSide) {
+                val left = column * step
+                val top = row * step
+                cells += Triple(page, Bounds(left, top, left + step, top + step), 0)
+            }
+        }
+    }
+    return cells
+}
+
+/** Scrolls through [passes] passes, one cell row further each time, and returns ns per pass */
+fun scroll(cache: PartCache, passes: Int, cellsPerSide: Int, check: PartCache?): Double {
+    val start = System.nanoTime()
+    for (pass in 0 until passes) {
+        cache.makeANewSet()
+        check?.makeANewSet()
+        passCells(pass / cellsPerSide, cellsPerSide, 3).forEachIndexed { order, cell ->
+            val (page, bounds, zoomLevel) = cell
+            val found = cache.upPartIfContained(page, bounds, zoomLevel, order)
+            if (!found) cache.cachePart(Part(page, bounds, zoomLevel, order))
+            if (check != null) {
+                val checkFound = check.upPartIfContained(page, bounds, zoomLevel, order)
+                if (!checkFound) check.cachePart(Part(page, bounds, zoomLevel, order))
+                require(found == checkFound) { "Lookups differ in pass $pass" }
+            }
+        }
+        if (check != null) require(cache.partKeys() == check.partKeys()) {
+            "Cached parts differ after pass $pass"
+        }
+    }
+    return (System.nanoTime() - start).toDouble() / passes
+}
+
+// Large enough to never evict, the index must then find and keep the same parts as the queues
+scroll(IndexedCache(100_000), 400, 8, QueueCache(100_000))
+println("Index and queues find the same parts")
+
+for (maxParts in intArrayOf(64, 256, 1024)) {
+    // Cells per page side, so that the three pages of a pass fill about half the cache
+    val cellsPerSide = maxOf(2, Math.sqrt(maxParts / 6.0).toInt())
+    val passes = 2000
+    // Warm up the JIT before measuring
+    repeat(3) {
+        scroll(QueueCache(maxParts), passes, cellsPerSide, null)
+        scroll(IndexedCache(maxParts), passes, cellsPerSide, null)
+    }
+    val queueNs = scroll(QueueCache(maxParts), passes, cellsPerSide, null)
+    val indexNs = scroll(IndexedCache(maxParts), passes, cellsPerSide, null)
+    println(
+        "%4d parts, %3d cells per pass: queues %8.1f us, index %8.1f us per pass".format(
+            maxParts, cellsPerSide * cellsPerSide * 3, queueNs / 1000, indexNs / 1000
+        )
+    )
+}
@@ -0,0 +1,277 @@
+package com.harissk.pdfpreview
+
+import android.graphics.Canvas
+import android.graphics.Color
+import android.graphics.Paint
+import android.graphics.Path
+import android.graphics.PorterDuff
+import android.graphics.PorterDuffXfermode
+import android.graphics.RectF
+import android.util.SparseArray
+import com.harissk.pdfium.annotation.AnnotationLayer
+import com.harissk.pdfium.annotation.PageAnnotation
+import kotlin.math.hypot
+
+/**
+ * Copyright [2025] [Haris Kumar R](https://github.com/rhariskumar3)
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ * */
+
+/**
+ * Draws the [AnnotationLayer] of each page above its tiles, which were rendered without these
+ * annotations. Geometry is scaled at draw time, so the layer stays sharp at any zoom and a
+ * changed annotation only needs a redraw, never a render.
+ *
+ * Colours go through [mapColors] like the tiles go through the pixel pipeline, call
+ * [remapColors] when it changes.
+ *
+ * Must be used from the main thread.
+ */
+internal class AnnotationOverlay(private val mapColors: (IntArray) -> IntArray) {
+
+    private val layers = SparseArray<AnnotationLayer>()
+
+    /** Stroke and interior colours of each annotation of [layers], as [mapColors] gives them */
+    private val colors = SparseArray<IntArray>()
+
+    /** Markups darken the page like ink, or lighten it when the pipeline turns pages dark */
+    private var markupMode = PorterDuffXfermode(PorterDuff.Mode.MULTIPLY)
+
+    private val path = Path()
+    private val shapeBounds = RectF()
+    private val paint = Paint(Paint.ANTI_ALIAS_FLAG).apply {
+        strokeCap = Paint.Cap.ROUND
+        strokeJoin = Paint.Join.ROUND
+    }
+
+    val isEmpty: Boolean
+        get() = layers.size() == 0
+
+    /**
+     * Sets the layer of a page and returns the part of the page to redraw, as fractions of the
+     * page, or null if nothing changed.
+     */
+    fun setLayer(page: Int, layer: AnnotationLayer): RectF? {
+        val previous = layers[page]
+        layers.put(page, layer)
+        colors.put(page, mapLayerColors(layer))
+        return layer.dirtyBounds(previous)
+    }
+
+    /** Forgets the layer of a page and returns the part of the page to redraw, if any */
+    fun removeLayer(page: Int): RectF? {
+        val previous = layers[page] ?: return null
+        layers.remove(page)
+        colors.remove(page)
+        return AnnotationLayer(emptyList(), previous.isComplete).dirtyBounds(previous)
+    }
+
+    /** Maps the colours of every layer again, after the pixel pipeline changed */
+    fun remapColors() {
+        val white = mapColors(intArrayOf(Color.WHITE))[0]
+        val luminance = 0.299f * Color.red(white) + 0.587f * Color.green(white) +
+                0.114f * Color.blue(white)
+        val mode = if (luminance < 128f) PorterDuff.Mode.SCREEN else PorterDuff.Mode.MULTIPLY
+        markupMode = PorterDuffXfermode(mode)
+        for (i in 0 until layers.size()) colors.setValueAt(i, mapLayerColors(layers.valueAt(i)))
+    }
+
+    fun clear() {
+        layers.clear()
+        colors.clear()
+    }
+
+    // Pipelines work on opaque pixels, the alpha of the annotation is kept as it is
+    private fun mapLayerColors(layer: AnnotationLayer): IntArray {
+        val original = IntArray(layer.annotations.size * 2)
+        layer.annotations.forEachIndexed { i, annotation ->
+            original[i * 2] = annotation.color
+            original[i * 2 + 1] = annotation.interiorColor
+        }
+        if (original.isEmpty()) return original
+        val mapped = mapColors(original.copyOf())
+        for (i in original.indices) {
+            mapped[i] = (original[i] and ALPHA_MASK) or (mapped[i] and ALPHA_MASK.inv())
+        }
+        return mapped
+    }
+
+    /**
+     * Draws the layer of a page whose full, uncropped size on screen is [fullWidth] by
+     * [fullHeight] with its top left corner at [left], [top].
+     */
+    fun draw(
+        canvas: Canvas,
+        page: Int,
+        left: Float,
+        top: Float,
+        fullWidth: Float,
+        fullHeight: Float,
+    ) {
+        val layer = layers[page] ?: return
+        val layerColors = colors[page] ?: return
+        layer.annotations.forEachIndexed { i, annotation ->
+            val color = layerColors[i * 2]
+            val interiorColor = layerColors[i * 2 + 1]
+            val strokeWidth = annotation.borderWidth * fullWidth
+            val bounds = annotation.bounds
+            shapeBounds.set(
+                left + bounds.left * fullWidth,
+                top + bounds.top * fullHeight,
+                left + bounds.right * fullWidth,
+                top + bounds.bottom * fullHeight
+            )
+            // Shapes are inside their rect, half of the border would fall outside it
+            if (annotation.subtype == PageAnnotation.SUBTYPE_SQUARE ||
+                annotation.subtype == PageAnnotation.SUBTYPE_CIRCLE
+            ) shapeBounds.inset(strokeWidth / 2, strokeWidth / 2)
+
+            when (annotation.subtype) {
+                PageAnnotation.SUBTYPE_HIGHLIGHT -> {
+                    path.rewind()
+                    for (quad in annotation.paths) {
+                        if (quad.size < 8) continue
+                        // Corners are top left, top right, bottom left and bottom right
+                        path.moveTo(left + quad[0] * fullWidth, top + quad[1] * fullHeight)
+                        path.lineTo(left + quad[2] * fullWidth, top + quad[3] * fullHeight)
+                        path.lineTo(left + quad[6] * fullWidth, top + quad[7] * fullHeight)
+                        path.lineTo(left + quad[4] * fullWidth, top + quad[5] * fullHeight)
+                        path.close()
+                    }
+                    paint.xfermode = markupMode
+                    fill(canvas, color)
+                    paint.xfermode = null
+                }
+
+                PageAnnotation.SUBTYPE_UNDERLINE,
+                PageAnnotation.SUBTYPE_STRIKEOUT,
+                PageAnnotation.SUBTYPE_SQUIGGLY -> {
+                    for (quad in annotation.paths) {
+                        if (quad.size < 8) continue
+                        drawTextMarkup(
+                            canvas, annotation.subtype, quad,
+                            left, top, fullWidth, fullHeight, color
+                        )
+                    }
+                }
+
+                PageAnnotation.SUBTYPE_SQUARE -> {
+                    path.rewind()
+                    path.addRect(shapeBounds, Path.Direction.CW)
+                    fill(canvas, interiorColor)
+                    stroke(canvas, color, strokeWidth)
+                }
+
+                PageAnnotation.SUBTYPE_CIRCLE -> {
+                    path.rewind()
+                    path.addOval(shapeBounds, Path.Direction.CW)
+                    fill(canvas, interiorColor)
+                    stroke(canvas, color, strokeWidth)
+                }
+
+                else -> {
+                    val closed = annotation.subtype == PageAnnotation.SUBTYPE_POLYGON
+                    path.rewind()
+                    for (points in annotation.paths) {
+                        if (points.size < 2) continue
+                        path.moveTo(left + points[0] * fullWidth, top + points[1] * fullHeight)
+                        for (p in 2 until points.size - 1 step 2) {
+                            path.lineTo(
+                                left + points[p] * fullWidth,
+                                top + points[p + 1] * fullHeight
+                            )
+                        }
+                        if (closed) path.close()
+                    }
+                    if (closed) fill(canvas, interiorColor)
+                    stroke(canvas, color, strokeWidth)
+                }
+            }
+        }
+    }
+
+    private fun drawTextMarkup(
+        canvas: Canvas,
+        subtype: Int,
+        quad: FloatArray,
+        left: Float,
+        top: Float,
+        fullWidth: Float,
+        fullHeight: Float,
+        color: Int,
+    ) {
+        val x1 = left + quad[0] * fullWidth
+        val y1 = top + quad[1] * fullHeight
+        val x2 = left + quad[2] * fullWidth
+        val y2 = top + quad[3] * fullHeight
+        val x3 = left + quad[4] * fullWidth
+        val y3 = top + quad[5] * fullHeight
+        val x4 = left + quad[6] * fullWidth
+        val y4 = top + quad[7] * fullHeight
+        val lineHeight = hypot(x3 - x1, y3 - y1)
+        val strokeWidth = (lineHeight / MARKUP_STROKE_RATIO).coerceAtLeast(1f)
+        path.rewind()
+        when (subtype) {
+            PageAnnotation.SUBTYPE_STRIKEOUT -> {
+                path.moveTo((x1 + x3) / 2, (y1 + y3) / 2)
+                path.lineTo((x2 + x4) / 2, (y2 + y4) / 2)
+            }
+
+            PageAnnotation.SUBTYPE_UNDERLINE -> {
+                // Just above the bottom edge, so the line stays inside the quad
+                val inset = strokeWidth / 2 / lineHeight.coerceAtLeast(1f)
+                path.moveTo(x3 + (x1 - x3) * inset, y3 + (y1 - y3) * inset)
+                path.lineTo(x4 + (x2 - x4) * inset, y4 + (y2 - y4) * inset)
+            }
+
+            else -> {
+                // A zigzag along the bottom of the line, one wave per quarter of its height
+                val length = hypot(x4 - x3, y4 - y3)
+                val wave = (lineHeight / 4).coerceAtLeast(1f)
+                val steps = (length / wave).toInt().coerceAtLeast(1)
+                val upX = (x1 - x3) / lineHeight.coerceAtLeast(1f) * wave / 2
+                val upY = (y1 - y3) / lineHeight.coerceAtLeast(1f) * wave / 2
+                path.moveTo(x3, y3)
+                for (step in 1..steps) {
+                    val t = step.toFloat() / steps
+                    val up = if (step % 2 == 1) 1f else 0f
+                    path.lineTo(x3 + (x4 - x3) * t + upX * up, y3 + (y4 - y3) * t + upY * up)
+                }
+            }
+        }
+        stroke(canvas, color, strokeWidth)
+    }
+
+    private fun fill(canvas: Canvas, color: Int) {
+        if (Color.alpha(color) == 0) return
+        paint.style = Paint.Style.FILL
+        paint.color = color
+        canvas.drawPath(path, paint)
+    }
+
+    private fun stroke(canvas: Canvas, color: Int, strokeWidth: Float) {
+        if (Color.alpha(color) == 0 || strokeWidth <= 0f) return
+        paint.style = Paint.Style.STROKE
+        paint.strokeWidth = strokeWidth
+        paint.color = color
+        canvas.drawPath(path, paint)
+    }
+
+    companion object {
+        private const val ALPHA_MASK = 0xFF000000.toInt()
+
+        /** Text markups are drawn with a stroke of this fraction of the line height */
+        private const val MARKUP_STROKE_RATIO = 14f
+    }
+}
@@ -0,0 +1,114 @@
+package com.harissk.pdfpreview
+
+import android.graphics.Bitmap
+
+/**
+ * Copyright [2025] [Haris Kumar R](https://github.com/rhariskumar3)
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ * */
+
+/**
+ * Keeps the bitmaps of evicted tiles so that new tiles of the same size and config can be rendered
+ * into them instead of allocating a new bitmap.
+ *
+ * Bitmaps are bucketed by width, height and config. Buckets hand out the most recently released
+ * bitmap first, while [evictOne] drops the eldest one. Bitmaps returned to a full pool are
+ * recycled.
+ *
+ * Bitmaps are released on the main thread and taken on the rendering thread, so all access is
+ * synchronized.
+ *
+ * @param maxPooledBitmaps The maximum number of bitmaps kept for reuse.
+ */
+internal class BitmapPool(private val maxPooledBitmaps: Int) : MemoryGovernor.Tier {
+
+    private data class BucketKey(val width: Int, val height: Int, val config: Bitmap.Config)
+
+    private val buckets = LinkedHashMap<BucketKey, ArrayDeque<Bitmap>>()
+    private var pooledCount = 0
+    private var pooledBytes = 0L
+
+    /** Number of [get] calls served from the pool */
+    var hits = 0L
+        private set
+
+    /** Number of [get] calls that found no matching bitmap */
+    var misses = 0L
+        private set
+
+    /** Share of [get] calls served from the pool, between 0 and 1 */
+    val hitRate: Float
+        get() = synchronized(this) {
+            val requests = hits + misses
+            if (requests == 0L) 0f else hits.toFloat() / requests
+        }
+
+    /**
+     * Returns a pooled bitmap of the given size and config, or null if none is available. The
+     * returned bitmap still holds its previous content.
+     */
+    fun get(width: Int, height: Int, config: Bitmap.Config): Bitmap? = synchronized(this) {
+        val bitmap = buckets[BucketKey(width, height, config)]?.removeLastOrNull()
+        if (bitmap == null) {
+            misses++
+            return null
+        }
+        hits++
+        pooledCount--
+        pooledBytes -= bitmap.allocationByteCount
+        bitmap
+    }
+
+    /** Gives a bitmap that is no longer displayed back to the pool, or recycles it. */
+    fun put(bitmap: Bitmap) {
+        if (bitmap.isRecycled) return
+        synchronized(this) {
+            if (bitmap.isMutable && pooledCount < maxPooledBitmaps) {
+                buckets.getOrPut(BucketKey(bitmap.width, bitmap.height, bitmap.config)) {
+                    ArrayDeque()
+                }.addLast(bitmap)
+                pooledCount++
+                pooledBytes += bitmap.allocationByteCount
+                return
+            }
+        }
+        bitmap.recycle()
+    }
+
+    override val sizeBytes: Long
+        get() = synchronized(this) { pooledBytes }
+
+    override fun evictOne(aggressive: Boolean): Long {
+        val bitmap = synchronized(this) {
+            val bucket = buckets.values.firstOrNull { it.isNotEmpty() } ?: return 0
+            pooledCount--
+            bucket.removeFirst().also { pooledBytes -= it.allocationByteCount }
+        }
+        val bytes = bitmap.allocationByteCount.toLong()
+        bitmap.recycle()
+        return bytes
+    }
+
+    /** Recycles every pooled bitmap, the statistics are kept. */
+    fun clear() {
+        val bitmaps = synchronized(this) {
+            val all = buckets.values.flatten()
+            buckets.clear()
+            pooledCount = 0
+            pooledBytes = 0
+            all
+        }
+        bitmaps.forEach { it.recycle() }
+    }
+}
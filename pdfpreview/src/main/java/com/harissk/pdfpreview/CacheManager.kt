@@ -4,7 +4,9 @@ import android.graphics.RectF
 import android.util.LruCache
 import com.harissk.pdfpreview.model.PagePart
 import com.harissk.pdfpreview.request.PdfViewerConfiguration
-import java.util.PriorityQueue
+import java.util.TreeSet
+import kotlin.math.abs
+import kotlin.math.roundToInt
 
 /**
  * Copyright [2025] [Haris Kumar R](https://github.com/rhariskumar3)
@@ -25,56 +27,153 @@ import java.util.PriorityQueue
 /**
  * Manages the caching of rendered PDF pages and thumbnails.
  *
- * This class utilizes two priority queues for caching page parts:
- * - **activeCache:** Stores recently used page parts.
- * - **passiveCache:** Stores less frequently used page parts.
+ * Page parts are split in two sets:
+ * - **active:** Parts requested by the current [makeANewSet] pass.
+ * - **passive:** Parts of previous passes, kept for reuse until space is needed.
+ *
+ * Every part is found through a hash index keyed by page, quantized bounds and tile pyramid
+ * level, so lookups do not depend on the cache size. Eviction order is kept in a sorted set
+ * (passive parts first, then lowest `cacheOrder`), which allows moving a part back to the active
+ * set in O(log n). A new pass only bumps a generation counter instead of moving every part.
  *
  * It also uses an LruCache for storing thumbnails.
  *
  * The cache size is determined by the `RenderOptions` provided during initialization.
  *
- * Cache eviction is managed by prioritizing page parts based on a `cacheOrder` property.
- * When the cache reaches its capacity, the least recently used parts (with the lowest `cacheOrder`)
- * are removed to make space for new ones.
+ * Tiles of other zoom levels stay cached and are drawn scaled underneath the current level until
+ * it has been rendered.
+ *
+ * Parts rendered while flinging are flagged as drafts. A draft stays visible until a full quality
+ * part with the same bounds is cached, which then replaces it in place.
+ *
+ * Both the parts and the thumbnails are exposed as [MemoryGovernor.Tier]s so their bitmap bytes
+ * count against the viewer memory budget.
+ *
+ * Bitmaps of parts evicted to make room for new ones go to [bitmapPool] to be rendered into again.
  */
 internal class CacheManager(private val pdfViewerConfiguration: PdfViewerConfiguration) {
 
-    private val passiveCache: PriorityQueue<PagePart> by lazy {
-        PriorityQueue(pdfViewerConfiguration.maxCachedBitmaps, PAGE_PART_COMPARATOR)
-    }
-    private val activeCache: PriorityQueue<PagePart> by lazy {
-        PriorityQueue(pdfViewerConfiguration.maxCachedBitmaps, PAGE_PART_COMPARATOR)
+    private val partIndex = HashMap<PartKey, CachedPart>()
+    private val pageIndex = HashMap<Int, MutableSet<PartKey>>()
+    private val evictionQueue = TreeSet(CACHED_PART_COMPARATOR)
+
+    /** Bytes of the bitmaps in [thumbnails], kept up to date as they are put and removed */
+    private var thumbnailsBytes = 0L
+
+    private val thumbnails = object : LruCache<Int, PagePart>(
+        pdfViewerConfiguration.maxCachedThumbnails
+    ) {
+        override fun entryRemoved(
+            evicted: Boolean,
+            key: Int,
+            oldValue: PagePart,
+            newValue: PagePart?,
+        ) {
+            val bitmap = oldValue.renderedBitmap ?: return
+            thumbnailsBytes -= bitmap.allocationByteCount.toLong()
+            // Thumbnails evicted to make room are rendered into again like evicted parts
+            if (evicted) bitmapPool.put(bitmap)
+        }
     }
-    private val thumbnails = LruCache<Int, PagePart>(pdfViewerConfiguration.maxCachedThumbnails)
 
-    // Comparator for prioritizing page parts in the cache.  Now a constant
+    /** Render targets of evicted parts, reused by the rendering thread */
+    val bitmapPool = BitmapPool(pdfViewerConfiguration.maxPooledBitmaps)
+
+    /** Parts tagged with the current generation form the active set */
+    private var generation = 0
+    private var sequence = 0L
+    private var partsBytes = 0L
+
+    /** Identifies a part. Bounds are quantized so that equal grid cells always share a key */
+    private data class PartKey(
+        val page: Int,
+        val left: Int,
+        val top: Int,
+        val right: Int,
+        val bottom: Int,
+        val zoomLevel: Int,
+    )
+
+    /** Cache entry, its ordering fields must only change while it is out of [evictionQueue] */
+    private class CachedPart(
+        val key: PartKey,
+        val part: PagePart,
+        var generation: Int,
+        val sequence: Long,
+        val bytes: Long,
+    )
+
     private companion object {
-        val PAGE_PART_COMPARATOR = Comparator<PagePart> { part1, part2 ->
-            (part1?.cacheOrder ?: 0).compareTo(part2?.cacheOrder ?: 0)
+        const val BOUNDS_QUANTUM = 65536f
+
+        // Older sets first, then the lowest cache order, then insertion order to keep entries unique
+        val CACHED_PART_COMPARATOR = Comparator<CachedPart> { part1, part2 ->
+            when {
+                part1.generation != part2.generation -> part1.generation.compareTo(part2.generation)
+                part1.part.cacheOrder != part2.part.cacheOrder ->
+                    part1.part.cacheOrder.compareTo(part2.part.cacheOrder)
+
+                else -> part1.sequence.compareTo(part2.sequence)
+            }
         }
+
+        fun keyOf(page: Int, bounds: RectF, zoomLevel: Int) = PartKey(
+            page = page,
+            left = (bounds.left * BOUNDS_QUANTUM).roundToInt(),
+            top = (bounds.top * BOUNDS_QUANTUM).roundToInt(),
+            right = (bounds.right * BOUNDS_QUANTUM).roundToInt(),
+            bottom = (bounds.bottom * BOUNDS_QUANTUM).roundToInt(),
+            zoomLevel = zoomLevel
+        )
     }
 
     fun cachePart(part: PagePart) {
         val bitmap = part.renderedBitmap
         if (bitmap == null || bitmap.isRecycled) return
 
+        val key = keyOf(part.page, part.pageRelativeBounds, part.zoomLevel)
         synchronized(passiveActiveLock) {
+            val existing = partIndex[key]
+            if (existing != null) when {
+                // A late draft must not replace a part that has already been refined
+                part.isDraft && !existing.part.isDraft -> {
+                    bitmapPool.put(bitmap)
+                    return
+                }
+
+                else -> removePart(existing)
+            }
             makeAFreeSpace()
-            activeCache.offer(part)
+            val cachedPart =
+                CachedPart(key, part, generation, sequence++, bitmap.allocationByteCount.toLong())
+            partsBytes += cachedPart.bytes
+            partIndex[key] = cachedPart
+            pageIndex.getOrPut(part.page) { HashSet() }.add(key)
+            evictionQueue.add(cachedPart)
         }
     }
 
     fun makeANewSet() = synchronized(passiveActiveLock) {
-        passiveCache.addAll(activeCache)
-        activeCache.clear()
+        generation++
     }
 
     private fun makeAFreeSpace() = synchronized(passiveActiveLock) {
-        while ((activeCache.size + passiveCache.size) >= pdfViewerConfiguration.maxCachedBitmaps) {
-            // Remove from passive first, then active if needed
-            passiveCache.poll()?.renderedBitmap?.recycle()
-                ?: activeCache.poll()?.renderedBitmap?.recycle()
+        // Remove from passive first, then active if needed
+        while (partIndex.size >= pdfViewerConfiguration.maxCachedBitmaps) {
+            removePart(evictionQueue.firstOrNull() ?: break)
+        }
+    }
+
+    /** Removes a part from every index, its bitmap goes to the pool unless [release] is set */
+    private fun removePart(cachedPart: CachedPart, release: Boolean = false) {
+        evictionQueue.remove(cachedPart)
+        if (partIndex.remove(cachedPart.key) != null) partsBytes -= cachedPart.bytes
+        pageIndex[cachedPart.key.page]?.let { keys ->
+            keys.remove(cachedPart.key)
+            if (keys.isEmpty()) pageIndex.remove(cachedPart.key.page)
         }
+        val bitmap = cachedPart.part.renderedBitmap ?: return
+        if (release) bitmap.recycle() else bitmapPool.put(bitmap)
     }
 
     fun cacheThumbnail(part: PagePart) {
@@ -82,29 +181,35 @@ internal class CacheManager(private val pdfViewerConfiguration: PdfViewerConfigu
         if (bitmap == null || bitmap.isRecycled) return
 
         thumbnails.put(part.page, part)
+        thumbnailsBytes += bitmap.allocationByteCount.toLong()
     }
 
-    // Returns true if any part of 'page' is already in the active or passive caches
-    fun upPartIfContained(page: Int, pageRelativeBounds: RectF, toOrder: Int): Boolean {
-        val fakePart = PagePart(page, null, pageRelativeBounds, false, 0)
-
+    /**
+     * Returns true if the part of 'page' is already in the active or passive caches, moving it to
+     * the active cache with the given order. Draft parts only count when [acceptDraft] is true, so
+     * a full quality pass re-renders them.
+     */
+    fun upPartIfContained(
+        page: Int,
+        pageRelativeBounds: RectF,
+        zoomLevel: Int,
+        toOrder: Int,
+        acceptDraft: Boolean = false,
+    ): Boolean {
+        val key = keyOf(page, pageRelativeBounds, zoomLevel)
         synchronized(passiveActiveLock) {
-            // Check if the fake part (page and bounds match) exists in the active cache.
-            // If it is found in the active cache return true, otherwise continue.
-            val partInActiveCache =
-                activeCache.firstOrNull { it.page == fakePart.page && it.pageRelativeBounds == fakePart.pageRelativeBounds }
-            if (partInActiveCache != null) return true
-
-            // If the page part is in passiveCache
-            val partInPassiveCache =
-                passiveCache.firstOrNull { it.page == fakePart.page && it.pageRelativeBounds == fakePart.pageRelativeBounds }
-            if (partInPassiveCache != null) {
-                passiveCache.remove(partInPassiveCache) // Remove the existing part
-                passiveCache.offer(fakePart.copy(cacheOrder = toOrder)) // Add it back with a new order
-                return true
-            }
+            val cachedPart = partIndex[key] ?: return false
+            if (cachedPart.part.isDraft && !acceptDraft) return false
+
+            // Parts already in the active set keep their order
+            if (cachedPart.generation == generation) return true
+
+            evictionQueue.remove(cachedPart)
+            cachedPart.generation = generation
+            cachedPart.part.cacheOrder = toOrder
+            evictionQueue.add(cachedPart)
         }
-        return false
+        return true
     }
 
     fun containsThumbnail(page: Int, bounds: RectF): Boolean {
@@ -114,34 +219,73 @@ internal class CacheManager(private val pdfViewerConfiguration: PdfViewerConfigu
 
     fun clearPageCache(page: Int) {
         synchronized(passiveActiveLock) {
-            // Remove from active cache
-            activeCache.removeAll { it.page == page }
-            // Remove from passive cache
-            passiveCache.removeAll { it.page == page }
+            pageIndex[page]?.toList()?.forEach { key -> partIndex[key]?.let(::removePart) }
         }
         // Remove thumbnail
         thumbnails.remove(page)
     }
 
-    fun getPageParts(): List<PagePart> = synchronized(passiveActiveLock) {
-        return buildList {
-            addAll(passiveCache)
-            addAll(activeCache)
+    /** Drops the parts of a page intersecting [bounds], relative to the page, and its thumbnail */
+    fun clearPageRegion(page: Int, bounds: RectF) {
+        synchronized(passiveActiveLock) {
+            pageIndex[page]?.toList()?.forEach { key ->
+                val cachedPart = partIndex[key] ?: return@forEach
+                if (RectF.intersects(cachedPart.part.pageRelativeBounds, bounds))
+                    removePart(cachedPart)
+            }
         }
+        thumbnails.remove(page)
+    }
+
+    /**
+     * Returns the cached parts in drawing order: parts of the pyramid level furthest from
+     * [zoomLevel] first, so that the nearest level and finally the current one end up on top.
+     */
+    fun getPageParts(zoomLevel: Int): List<PagePart> = synchronized(passiveActiveLock) {
+        return evictionQueue.map { it.part }.sortedByDescending { abs(it.zoomLevel - zoomLevel) }
     }
 
     fun getThumbnails(): List<PagePart> = thumbnails.snapshot().values.toList()
 
+    /** Page parts, passive ones are released first and active ones only when aggressive */
+    val partsTier = object : MemoryGovernor.Tier {
+        override val sizeBytes: Long
+            get() = synchronized(passiveActiveLock) { partsBytes }
+
+        override fun evictOne(aggressive: Boolean): Long = synchronized(passiveActiveLock) {
+            val eldest = evictionQueue.firstOrNull() ?: return 0
+            if (eldest.generation == generation && !aggressive) return 0
+            removePart(eldest, release = true)
+            eldest.bytes
+        }
+    }
+
+    /** Thumbnails, released least recently used first */
+    val thumbnailsTier = object : MemoryGovernor.Tier {
+        override val sizeBytes: Long
+            get() = thumbnailsBytes
+
+        override fun evictOne(aggressive: Boolean): Long {
+            val (page, part) = thumbnails.snapshot().entries.firstOrNull() ?: return 0
+            val bytes = part.renderedBitmap?.allocationByteCount?.toLong() ?: 0L
+            thumbnails.remove(page)
+            part.renderedBitmap?.recycle()
+            return bytes
+        }
+    }
+
     fun recycle() {
         synchronized(passiveActiveLock) {
-            passiveCache.forEach { it.renderedBitmap?.recycle() }
-            passiveCache.clear()
-            activeCache.forEach { it.renderedBitmap?.recycle() }
-            activeCache.clear()
+            evictionQueue.forEach { it.part.renderedBitmap?.recycle() }
+            evictionQueue.clear()
+            partIndex.clear()
+            pageIndex.clear()
+            partsBytes = 0
         }
 
-        thumbnails.evictAll()  // Recycle bitmaps in LruCache
+        thumbnails.evictAll()  // Bitmaps go to the pool, which recycles them when cleared
+        bitmapPool.clear()
     }
 
     private val passiveActiveLock = Any()
-}
\ No newline at end of file
+}
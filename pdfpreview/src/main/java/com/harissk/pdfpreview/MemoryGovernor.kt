@@ -0,0 +1,118 @@
+package com.harissk.pdfpreview
+
+import android.app.ActivityManager
+import android.content.ComponentCallbacks2
+import android.content.Context
+
+/**
+ * Copyright [2025] [Haris Kumar R](https://github.com/rhariskumar3)
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ * */
+
+/**
+ * Keeps the memory held by the viewer caches under a single byte budget.
+ *
+ * Each cache registers as a [Tier] with a reuse value that reflects how expensive its entries are
+ * to recreate. When the budget is exceeded, entries are evicted from the tier holding the most
+ * bytes per unit of reuse value, one at a time, until the total fits again. Tiers evict their own
+ * least valuable entry first.
+ *
+ * Must be used from the main thread.
+ */
+internal class MemoryGovernor(var budgetBytes: Long) {
+
+    /** A cache whose memory is accounted by the governor. */
+    interface Tier {
+
+        /** Bytes currently held by this tier. */
+        val sizeBytes: Long
+
+        /**
+         * Releases the least valuable entry of this tier.
+         *
+         * @param aggressive When true, entries that are currently displayed may be released too.
+         * @return the number of bytes released, or 0 if nothing could be released.
+         */
+        fun evictOne(aggressive: Boolean): Long
+    }
+
+    private class Registration(val tier: Tier, val reuseValue: Float)
+
+    private val registrations = mutableListOf<Registration>()
+
+    val usedBytes: Long
+        get() = registrations.sumOf { it.tier.sizeBytes }
+
+    /**
+     * Registers a tier. Higher [reuseValue] means its entries are kept longer relative to their size.
+     */
+    fun register(tier: Tier, reuseValue: Float) {
+        registrations += Registration(tier, reuseValue.coerceAtLeast(MIN_REUSE_VALUE))
+    }
+
+    /**
+     * Evicts entries across tiers until the accounted memory fits in [limit].
+     */
+    fun enforce(limit: Long = budgetBytes, aggressive: Boolean = false) {
+        var used = usedBytes
+        if (used <= limit) return
+
+        val candidates = registrations.toMutableList()
+        while (used > limit) {
+            val victim = candidates
+                .filter { it.tier.sizeBytes > 0 }
+                .maxByOrNull { it.tier.sizeBytes / it.reuseValue }
+                ?: break
+            val released = victim.tier.evictOne(aggressive)
+            if (released <= 0) candidates.remove(victim) else used -= released
+        }
+    }
+
+    /**
+     * Shrinks the caches according to an [ComponentCallbacks2.onTrimMemory] level.
+     */
+    fun onTrimMemory(level: Int) {
+        when {
+            level >= ComponentCallbacks2.TRIM_MEMORY_COMPLETE -> enforce(0, aggressive = true)
+            level >= ComponentCallbacks2.TRIM_MEMORY_BACKGROUND ->
+                enforce(budgetBytes / 8, aggressive = true)
+
+            // Higher levels never keep more than lower ones, hidden UI included
+            level >= ComponentCallbacks2.TRIM_MEMORY_RUNNING_CRITICAL ->
+                enforce(budgetBytes / 4, aggressive = true)
+
+            level >= ComponentCallbacks2.TRIM_MEMORY_RUNNING_LOW -> enforce(budgetBytes / 2)
+            level >= ComponentCallbacks2.TRIM_MEMORY_RUNNING_MODERATE -> enforce(budgetBytes * 3 / 4)
+        }
+    }
+
+    companion object {
+        private const val MIN_REUSE_VALUE = 0.01f
+
+        /**
+         * Derives a budget from the per-app memory class: a quarter of it, or an eighth on low RAM
+         * devices. That is about 32–48 MB on 2 GB devices and 64–128 MB on high end ones.
+         */
+        fun defaultBudget(context: Context): Long {
+            val activityManager =
+                context.getSystemService(Context.ACTIVITY_SERVICE) as? ActivityManager
+                    ?: return 32L * 1024 * 1024
+            val memoryClassBytes = activityManager.memoryClass * 1024L * 1024L
+            return when {
+                activityManager.isLowRamDevice -> memoryClassBytes / 8
+                else -> memoryClassBytes / 4
+            }
+        }
+    }
+}
@@ -1,25 +1,34 @@
 package com.harissk.pdfpreview
 
+import android.content.ComponentCallbacks2
 import android.content.Context
+import android.content.res.Configuration
 import android.graphics.Canvas
 import android.graphics.Color
-import android.graphics.ColorMatrix
-import android.graphics.ColorMatrixColorFilter
 import android.graphics.Paint
 import android.graphics.PaintFlagsDrawFilter
 import android.graphics.PointF
 import android.graphics.Rect
 import android.graphics.RectF
 import android.os.HandlerThread
+import android.os.ParcelFileDescriptor
 import android.util.AttributeSet
 import android.view.MotionEvent
 import android.widget.RelativeLayout
 import com.harissk.pdfium.Bookmark
+import com.harissk.pdfium.ColorMode
 import com.harissk.pdfium.Link
 import com.harissk.pdfium.Meta
 import com.harissk.pdfium.PdfiumCore
+import com.harissk.pdfium.PixelPipeline
+import com.harissk.pdfium.SaveResult
+import com.harissk.pdfium.annotation.AnnotationCommit
+import com.harissk.pdfium.annotation.AnnotationLayer
+import com.harissk.pdfium.annotation.AnnotationTransaction
 import com.harissk.pdfium.exception.IncorrectPasswordException
 import com.harissk.pdfium.exception.PageRenderingException
+import com.harissk.pdfium.search.SearchMatch
+import com.harissk.pdfium.text.TextPosition
 import com.harissk.pdfium.listener.LogWriter
 import com.harissk.pdfium.util.Size
 import com.harissk.pdfium.util.SizeF
@@ -32,8 +41,10 @@ import com.harissk.pdfpreview.request.PdfViewConfiguration
 import com.harissk.pdfpreview.request.PdfViewerConfiguration
 import com.harissk.pdfpreview.scroll.ScrollHandle
 import com.harissk.pdfpreview.source.DocumentSource
+import com.harissk.pdfpreview.thumbnail.PDFThumbnailGenerator
 import com.harissk.pdfpreview.utils.FitPolicy
 import com.harissk.pdfpreview.utils.SnapEdge
+import com.harissk.pdfpreview.utils.TilePyramid
 import com.harissk.pdfpreview.utils.toPx
 import kotlinx.coroutines.CoroutineScope
 import kotlinx.coroutines.Dispatchers
@@ -41,7 +52,11 @@ import kotlinx.coroutines.Job
 import kotlinx.coroutines.SupervisorJob
 import kotlinx.coroutines.async
 import kotlinx.coroutines.cancel
+import kotlinx.coroutines.delay
+import kotlinx.coroutines.isActive
+import kotlinx.coroutines.launch
 import kotlinx.coroutines.withContext
+import java.io.File
 
 /**
  * Copyright [2025] [Haris Kumar R](https://github.com/rhariskumar3)
@@ -75,6 +90,9 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
     private var currentLoadingJob: Job? = null
     private var isCurrentlyLoading: Boolean = false
 
+    // Reads the real page sizes of a document loaded with estimated ones
+    private var pageSizeJob: Job? = null
+
     // Configuration approach
     private var viewConfiguration: PdfViewConfiguration = PdfViewConfiguration.DEFAULT
     private var pendingLoadRequest: PdfLoadRequest? = null
@@ -100,6 +118,34 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
     /** Rendered parts go to the cache manager  */
     internal val cacheManager = CacheManager(pdfViewerConfiguration)
 
+    /** Keeps tiles, thumbnails and opened pages within one memory budget  */
+    internal val memoryGovernor = MemoryGovernor(MemoryGovernor.defaultBudget(getContext())).apply {
+        register(cacheManager.partsTier, reuseValue = 1f)
+        register(cacheManager.thumbnailsTier, reuseValue = 2f)
+        register(cacheManager.bitmapPool, reuseValue = 0.5f)
+        register(object : MemoryGovernor.Tier {
+            override val sizeBytes: Long
+                get() = _pdfFile?.openedPagesBytes ?: 0L
+
+            override fun evictOne(aggressive: Boolean): Long =
+                _pdfFile?.requestPageRelease(aggressive) ?: 0L
+        }, reuseValue = 4f)
+    }
+
+    private val trimMemoryCallbacks = object : ComponentCallbacks2 {
+        override fun onTrimMemory(level: Int) {
+            memoryGovernor.onTrimMemory(level)
+            PDFThumbnailGenerator.trimMemory(level)
+            renderingHandler?.releasePages()
+            redraw()
+        }
+
+        override fun onConfigurationChanged(newConfig: Configuration) = Unit
+
+        @Deprecated("Deprecated in Java")
+        override fun onLowMemory() = onTrimMemory(ComponentCallbacks2.TRIM_MEMORY_COMPLETE)
+    }
+
     /** Animation manager manage all offset and zoom animation  */
     private val pdfAnimator: PdfAnimator = PdfAnimator(this)
 
@@ -128,6 +174,14 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
     var zoom: Float = 1f
         private set
 
+    /** The tile pyramid level that parts are rendered at for the current [zoom]  */
+    internal val zoomLevel: Int
+        get() = TilePyramid.levelFor(zoom, pdfViewerConfiguration.zoomLevelStep)
+
+    /** Share of rendered tiles that reused a pooled bitmap instead of allocating one, 0 to 1  */
+    val bitmapPoolHitRate: Float
+        get() = cacheManager.bitmapPool.hitRate
+
     /** True if the PDFView has been Recycling  */
     internal var isRecycling = false
 
@@ -162,7 +216,15 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
     internal var isSwipeVertical: Boolean = true
     var isSwipeEnabled: Boolean = true
     internal var isDoubleTapEnabled: Boolean = true
-    private var nightMode: Boolean = false
+
+    /** Colour transforms applied to tiles when they are rendered */
+    internal var pixelPipeline: PixelPipeline? = null
+        private set
+
+    /** Colours of a blank page and of scroll placeholders under [pixelPipeline] */
+    private var pageBackgroundColor: Int = Color.WHITE
+    private var placeholderColor: Int = PLACEHOLDER_COLOR
+    private var placeholderBorderColor: Int = PLACEHOLDER_BORDER_COLOR
     var isPageSnap: Boolean = true
 
     /** Pdfium core for loading and rendering PDFs  */
@@ -209,6 +271,19 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
         strokeWidth = 2f
     }
 
+    /** Paint for filling blank pages, which have no tiles */
+    private val blankPagePaint = Paint().apply {
+        style = Paint.Style.FILL
+    }
+
+    /** Position of a page in the strip, reused by every draw call */
+    private val pageOrigin = PointF()
+
+    /** Annotations drawn above the tiles, see [PdfViewerConfiguration.annotationOverlay] */
+    internal val annotationOverlay = AnnotationOverlay { colors ->
+        pixelPipeline?.let { pdfiumCore.applyPixelPipeline(it, colors) } ?: colors
+    }
+
     /** Spacing between pages, in px  */
     private var spacingPx: Int = 0
 
@@ -252,7 +327,14 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
 
     private fun applyViewConfiguration() {
         isSwipeEnabled = viewConfiguration.enableSwipe
-        setNightMode(viewConfiguration.nightMode)
+        setPixelPipeline(
+            when {
+                viewConfiguration.pixelPipeline != null -> viewConfiguration.pixelPipeline
+                viewConfiguration.colorMode != ColorMode.NONE -> viewConfiguration.colorMode.pipeline
+                viewConfiguration.nightMode -> ColorMode.NIGHT.pipeline
+                else -> null
+            }
+        )
         isDoubleTapEnabled = viewConfiguration.enableDoubleTap
         isSwipeVertical = !viewConfiguration.swipeHorizontal
         isAnnotationRendering = viewConfiguration.annotationRendering
@@ -267,6 +349,10 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
         isScrollOptimizationEnabled = viewConfiguration.scrollOptimization
         if (viewConfiguration.disableLongPress) dragPinchManager.disableLongPress()
         isBestQuality = false
+        memoryGovernor.budgetBytes = when {
+            pdfViewerConfiguration.memoryBudgetBytes > 0 -> pdfViewerConfiguration.memoryBudgetBytes
+            else -> MemoryGovernor.defaultBudget(context)
+        }
     }
 
     /**
@@ -370,7 +456,9 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
                     autoSpacing = isAutoSpacingEnabled,
                     fitEachPage = isFitEachPage,
                     maxPageCacheSize = pdfViewerConfiguration.maxCachedPages,
-                    singlePageMode = viewConfiguration.singlePageMode
+                    singlePageMode = viewConfiguration.singlePageMode,
+                    lazyPageSizeThreshold = pdfViewerConfiguration.lazyPageSizeThreshold,
+                    cropPolicy = viewConfiguration.cropPolicy
                 )
             }
 
@@ -491,23 +579,24 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
     val pageCount: Int
         get() = _pdfFile?.pagesCount ?: 0
 
-    private fun setNightMode(nightMode: Boolean) {
-        this.nightMode = nightMode
-        when {
-            nightMode -> {
-                val colorMatrixInverted = ColorMatrix(
-                    floatArrayOf(
-                        -1f, 0f, 0f, 0f, 255f,
-                        0f, -1f, 0f, 0f, 255f,
-                        0f, 0f, -1f, 0f, 255f,
-                        0f, 0f, 0f, 1f, 0f
-                    )
-                )
-                paint.setColorFilter(ColorMatrixColorFilter(colorMatrixInverted))
-            }
-
-            else -> paint.setColorFilter(null)
-        }
+    /**
+     * Tiles are transformed by [pixelPipeline] when they are rendered and drawn as they are, so
+     * cached tiles of the previous pipeline are dropped. The background and placeholders take the
+     * colours the pipeline gives to a blank page.
+     */
+    private fun setPixelPipeline(pixelPipeline: PixelPipeline?) {
+        if (this.pixelPipeline == pixelPipeline) return
+        this.pixelPipeline = pixelPipeline
+        val colors = intArrayOf(Color.WHITE, PLACEHOLDER_COLOR, PLACEHOLDER_BORDER_COLOR)
+        val mapped = pixelPipeline?.let { pdfiumCore.applyPixelPipeline(it, colors) } ?: colors
+        pageBackgroundColor = mapped[0]
+        placeholderColor = mapped[1]
+        placeholderBorderColor = mapped[2]
+        annotationOverlay.remapColors()
+        if (_pdfFile == null) return
+        renderingHandler?.removeMessages(RenderingHandler.MSG_RENDER_TASK)
+        cacheManager.recycle()
+        if (state == State.SHOWN) loadPages()
     }
 
     internal fun onPageError(ex: PageRenderingException) {
@@ -519,6 +608,8 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
     private fun recycle(isRemoveRequest: Boolean = true) {
         currentLoadingJob?.cancelSafely()
         currentLoadingJob = null
+        pageSizeJob?.cancelSafely()
+        pageSizeJob = null
 
         isRecycling = true
         isLoading = false
@@ -543,6 +634,7 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
             }
 
             cacheManager.recycle()
+            annotationOverlay.clear()
             if (isScrollHandleInit && isRemoveRequest) {
                 try {
                     scrollHandle?.destroyLayout()
@@ -585,7 +677,13 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
         pdfAnimator.performFling()
     }
 
+    override fun onAttachedToWindow() {
+        super.onAttachedToWindow()
+        context.applicationContext.registerComponentCallbacks(trimMemoryCallbacks)
+    }
+
     override fun onDetachedFromWindow() {
+        context.applicationContext.unregisterComponentCallbacks(trimMemoryCallbacks)
         currentLoadingJob?.cancelSafely()
         currentLoadingJob = null
         scope.cancel()
@@ -758,7 +856,7 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
         // Draws background
         if (isAntialiasing) canvas.setDrawFilter(antialiasFilter)
         when (background) {
-            null -> canvas.drawColor(if (nightMode) Color.BLACK else Color.WHITE)
+            null -> canvas.drawColor(pageBackgroundColor)
             else -> background.draw(canvas)
         }
         if (state != State.SHOWN) return
@@ -773,12 +871,14 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
         if (isScrollOptimizationEnabled && isActivelyScrolling()) {
             drawScrollPlaceholders(canvas)
         }
+        drawBlankPages(canvas)
 
         // Draws thumbnails
         for (part in cacheManager.getThumbnails()) drawPart(canvas, part)
 
         // Draws parts
-        for (part in cacheManager.getPageParts()) drawPart(canvas, part)
+        for (part in cacheManager.getPageParts(zoomLevel)) drawPart(canvas, part)
+        if (isAnnotationRendering && !annotationOverlay.isEmpty) drawAnnotations(canvas)
         if (pdfViewerConfiguration.isDebugEnabled && viewConfiguration.renderingEventListener != null)
             drawWithListener(canvas, currentPage)
 
@@ -793,8 +893,8 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
         if (_pdfFile == null) return
 
         // Update paint colors based on current night mode
-        placeholderPaint.color = if (nightMode) 0xFF2E2E2E.toInt() else 0xFFF5F5F5.toInt()
-        placeholderBorderPaint.color = if (nightMode) 0xFF505050.toInt() else 0xFFDDDDDD.toInt()
+        placeholderPaint.color = placeholderColor
+        placeholderBorderPaint.color = placeholderBorderColor
 
         // Calculate visible area
         val visibleLeft = -currentXOffset
@@ -802,8 +902,12 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
         val visibleRight = visibleLeft + width
         val visibleBottom = visibleTop + height
 
-        // Draw placeholders for all pages that intersect with visible area
-        for (pageIndex in 0 until pageCount) {
+        // Draw placeholders for the pages that intersect with visible area
+        val visiblePages = when {
+            isSwipeVertical -> pdfFile.getPagesInRange(visibleTop, visibleBottom, zoom)
+            else -> pdfFile.getPagesInRange(visibleLeft, visibleRight, zoom)
+        }
+        for (pageIndex in visiblePages) {
             val pageSize = pdfFile.getPageSize(pageIndex) ?: continue
             val scaledWidth = toCurrentScale(pageSize.width)
             val scaledHeight = toCurrentScale(pageSize.height)
@@ -838,6 +942,79 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
         }
     }
 
+    /** Fills the visible blank pages with the page background, they are never rendered */
+    private fun drawBlankPages(canvas: Canvas) {
+        val pdfFile = _pdfFile ?: return
+        blankPagePaint.color = pageBackgroundColor
+        for (page in getVisiblePages(pdfFile)) {
+            if (!pdfFile.isPageBlank(page)) continue
+            val size = pdfFile.getPageSize(page) ?: continue
+            val origin = getPageOrigin(page, size, pageOrigin)
+            canvas.drawRect(
+                origin.x,
+                origin.y,
+                origin.x + toCurrentScale(size.width),
+                origin.y + toCurrentScale(size.height),
+                blankPagePaint
+            )
+        }
+    }
+
+    /** Draws the annotation layer of the visible pages, clipped to each page */
+    private fun drawAnnotations(canvas: Canvas) {
+        val pdfFile = _pdfFile ?: return
+        for (page in getVisiblePages(pdfFile)) {
+            val size = pdfFile.getPageSize(page) ?: continue
+            val origin = getPageOrigin(page, size, pageOrigin)
+            val width = toCurrentScale(size.width)
+            val height = toCurrentScale(size.height)
+            // Annotations are placed on the full page, the displayed page may be cropped
+            val crop = pdfFile.getPageCrop(page) ?: PdfFile.FULL_PAGE
+            val fullWidth = width / crop.width()
+            val fullHeight = height / crop.height()
+            val saveCount = canvas.save()
+            canvas.clipRect(origin.x, origin.y, origin.x + width, origin.y + height)
+            annotationOverlay.draw(
+                canvas = canvas,
+                page = page,
+                left = origin.x - crop.left * fullWidth,
+                top = origin.y - crop.top * fullHeight,
+                fullWidth = fullWidth,
+                fullHeight = fullHeight
+            )
+            canvas.restoreToCount(saveCount)
+        }
+    }
+
+    /** Pages intersecting the screen, or the current page in single page mode */
+    private fun getVisiblePages(pdfFile: PdfFile): IntRange {
+        if (singlePageMode) return currentPage..currentPage
+        val visibleStart = if (isSwipeVertical) -currentYOffset else -currentXOffset
+        val visibleEnd = visibleStart + if (isSwipeVertical) height else width
+        return pdfFile.getPagesInRange(visibleStart, visibleEnd, zoom)
+    }
+
+    /** Sets [out] to the position of the page of the given size in the strip, as parts are drawn */
+    private fun getPageOrigin(page: Int, size: SizeF, out: PointF): PointF {
+        when {
+            isSwipeVertical -> {
+                // Limit horizontal centering to prevent overlap in landscape mode
+                val maxCenterOffset = (width - toCurrentScale(size.width)) / 2f
+                out.x = minOf(
+                    toCurrentScale(pdfFile.maxPageWidth - size.width) / 2,
+                    maxCenterOffset
+                ).coerceAtLeast(0f)
+                out.y = pdfFile.getPageOffset(page, zoom)
+            }
+
+            else -> {
+                out.x = pdfFile.getPageOffset(page, zoom)
+                out.y = toCurrentScale(pdfFile.maxPageHeight - size.height) / 2
+            }
+        }
+        return out
+    }
+
     private fun drawWithListener(canvas: Canvas, page: Int) {
         val translateX: Float
         val translateY: Float
@@ -871,25 +1048,10 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
         if (renderedBitmap.isRecycled) return
 
         // Move to the target page
-        val localTranslationX: Float
-        val localTranslationY: Float
         val size: SizeF = pdfFile.getPageSize(part.page) ?: SizeF(0f, 0f)
-        when {
-            isSwipeVertical -> {
-                localTranslationY = pdfFile.getPageOffset(part.page, zoom)
-                // Limit horizontal centering to prevent overlap in landscape mode
-                val maxCenterOffset = (width - toCurrentScale(size.width)) / 2f
-                localTranslationX = minOf(
-                    toCurrentScale(pdfFile.maxPageWidth - size.width) / 2,
-                    maxCenterOffset
-                ).coerceAtLeast(0f)
-            }
-
-            else -> {
-                localTranslationX = pdfFile.getPageOffset(part.page, zoom)
-                localTranslationY = toCurrentScale(pdfFile.maxPageHeight - size.height) / 2
-            }
-        }
+        val origin = getPageOrigin(part.page, size, pageOrigin)
+        val localTranslationX = origin.x
+        val localTranslationY = origin.y
         canvas.translate(localTranslationX, localTranslationY)
         val srcRect = Rect(0, 0, renderedBitmap.width, renderedBitmap.height)
         val offsetX = toCurrentScale(pageRelativeBounds.left * size.width)
@@ -961,6 +1123,19 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
         redraw()
     }
 
+    /**
+     * Queue reduced quality drafts for the parts that are visible while a fling is in progress.
+     * The regular [loadPages] call made when the fling stops refines the visible drafts.
+     */
+    internal fun loadDraftPages() {
+        if (_pdfFile == null || renderingHandler == null || isRecycled || isRecycling) return
+        if (!pdfViewerConfiguration.draftRendering) return
+
+        renderingHandler?.removeMessages(RenderingHandler.MSG_RENDER_TASK)
+        cacheManager.makeANewSet()
+        pagesLoader.loadPages(draft = true)
+    }
+
     /** Called when the PDF is loaded  */
     private fun loadComplete(pdfFile: PdfFile) {
         logWriter?.writeLog(
@@ -1017,6 +1192,7 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
                     }
                     logWriter?.writeLog("Performing initial jump to page $targetPage", "PDFView")
                     jumpTo(page = targetPage, withAnimation = false)
+                    resolvePageSizes(pdfFile)
                 }
             }, initDelay)
         } catch (e: Exception) {
@@ -1024,6 +1200,59 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
         }
     }
 
+    /**
+     * Replaces the estimated page sizes and crops of a document by the real ones, in chunks read on
+     * a background thread starting around the current page.
+     */
+    private fun resolvePageSizes(pdfFile: PdfFile) {
+        if (!pdfFile.hasUnresolvedPageSizes) return
+        pageSizeJob?.cancelSafely()
+        pageSizeJob = scope.launch {
+            while (isActive && !isRecycling && !isRecycled && _pdfFile === pdfFile) {
+                val chunkPages = when {
+                    pdfFile.cropsPages -> PAGE_CROP_CHUNK_PAGES
+                    else -> PAGE_SIZE_CHUNK_PAGES
+                }
+                val pages = pdfFile.nextUnresolvedPages(currentPage, chunkPages)
+                if (pages.isEmpty()) break
+                val batch = withContext(Dispatchers.IO) { pdfFile.readPageSizes(pages) }
+                // A fling keeps its own position, patching under it would jump
+                while (pdfAnimator.isFlinging) delay(PAGE_SIZE_FLING_WAIT_MS)
+                if (!isActive || isRecycling || isRecycled || _pdfFile !== pdfFile) break
+                applyPageSizes(pdfFile, batch)
+            }
+        }
+    }
+
+    /**
+     * Patches the layout with resolved page sizes and moves the strip so that the current page
+     * stays where it is on screen, even when pages before it changed size. Tiles of pages whose
+     * size or crop changed are dropped.
+     */
+    private fun applyPageSizes(pdfFile: PdfFile, batch: PdfFile.PageSizeBatch) {
+        val anchorPage = currentPage
+        val primaryOffset = if (isSwipeVertical) currentYOffset else currentXOffset
+        val anchorDistance = primaryOffset + pdfFile.getPageOffset(anchorPage, zoom)
+        var pageChanged = false
+        val changed = pdfFile.applyPageSizes(batch) { page ->
+            cacheManager.clearPageCache(page)
+            pageChanged = true
+        }
+        if (!changed) {
+            if (pageChanged) loadPages()
+            return
+        }
+
+        val newOffset = anchorDistance - pdfFile.getPageOffset(anchorPage, zoom)
+        when {
+            isSwipeVertical -> moveTo(currentXOffset, newOffset, moveHandle = false)
+            else -> moveTo(newOffset, currentYOffset, moveHandle = false)
+        }
+        currentPage = anchorPage
+        loadPages()
+        updateScrollUIElements()
+    }
+
     private fun loadError(t: Throwable): Nothing? {
         logWriter?.writeLog("loadError: ${t.message}", "PDFView")
 
@@ -1051,6 +1280,27 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
         invalidate()
     }
 
+    /** Drops whatever was cached for a page found blank, it is drawn as a fill from now on */
+    internal fun onPageBlank(page: Int) {
+        if (isRecycled || isRecycling) return
+        cacheManager.clearPageCache(page)
+        redraw()
+    }
+
+    /** Schedules the tiles of a page whose complexity was just measured, see [PagesLoader] */
+    internal fun onPageProfiled() {
+        when {
+            pdfAnimator.isFlinging -> loadDraftPages()
+            else -> loadPages()
+        }
+    }
+
+    /** Shows the annotations read for a page, its tiles are rendered without them */
+    internal fun onAnnotationLayerLoaded(page: Int, layer: AnnotationLayer) {
+        if (isRecycled || isRecycling) return
+        if (annotationOverlay.setLayer(page, layer) != null) redraw()
+    }
+
     /**
      * Called when a rendering task is over and
      * a PagePart has been freshly created.
@@ -1072,6 +1322,10 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
             part.isThumbnail -> cacheManager.cacheThumbnail(part)
             else -> cacheManager.cachePart(part)
         }
+        if (memoryGovernor.usedBytes > memoryGovernor.budgetBytes) {
+            memoryGovernor.enforce()
+            renderingHandler?.releasePages()
+        }
         redraw()
     }
 
@@ -1466,6 +1720,9 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
 
     fun getPageSize(pageIndex: Int): SizeF = pdfFile.getPageSize(pageIndex) ?: SizeF(0F, 0F)
 
+    /** Crop of a page of the current document, see [PdfFile.getPageCrop] */
+    internal fun getPageCrop(page: Int): RectF? = _pdfFile?.getPageCrop(page)
+
     internal fun toCurrentScale(size: Float): Float = size * zoom
 
     internal val isZooming: Boolean
@@ -1503,6 +1760,204 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
     /** Will be empty until document is loaded  */
     fun getLinks(page: Int): List<Link> = _pdfFile?.getPageLinks(page).orEmpty()
 
+    /**
+     * Searches the whole document for [query] on a background thread. Cancelling the calling
+     * coroutine stops the search after the page being searched.
+     *
+     * @param onPageResults Called on the main thread with the matches of each page as soon as
+     * the page has been searched, before the whole search completes.
+     * @return all matches in page order, with highlight rects in PDF page coordinates.
+     */
+    suspend fun searchDocument(
+        query: String,
+        matchCase: Boolean = false,
+        matchWholeWord: Boolean = false,
+        onPageResults: ((page: Int, matches: List<SearchMatch>) -> Unit)? = null,
+    ): List<SearchMatch> {
+        val pdfFile = _pdfFile ?: return emptyList()
+        return withContext(Dispatchers.IO) {
+            val results = mutableListOf<SearchMatch>()
+            pdfFile.searchDocument(
+                query = query,
+                matchCase = matchCase,
+                matchWholeWord = matchWholeWord,
+                isCancelled = { !isActive || isRecycling || isRecycled }
+            ) { page, matches ->
+                results += matches
+                onPageResults?.let { callback -> post { callback(page, matches) } }
+            }
+            results
+        }
+    }
+
+    /**
+     * Searches the document for [query] as the user types, on a background thread. Results of
+     * the previous queries are reused: extending the query only re-checks the previous matches,
+     * and deleting characters goes back to the results of the shorter query. Pages are searched
+     * outwards from the current page. Cancel the previous call before starting the next one.
+     *
+     * @param onPageResults Called on the main thread with the matches of each page as soon as
+     * the page has been searched.
+     * @return all matches, in search order. Matches on pages whose text is not loaded have no
+     * rects, [getSearchMatchRects] measures them.
+     */
+    suspend fun searchIncremental(
+        query: String,
+        matchCase: Boolean = false,
+        matchWholeWord: Boolean = false,
+        onPageResults: ((page: Int, matches: List<SearchMatch>) -> Unit)? = null,
+    ): List<SearchMatch> {
+        val pdfFile = _pdfFile ?: return emptyList()
+        val centerPage = currentPage
+        return withContext(Dispatchers.IO) {
+            val results = mutableListOf<SearchMatch>()
+            pdfFile.searchIncremental(
+                query = query,
+                matchCase = matchCase,
+                matchWholeWord = matchWholeWord,
+                centerPage = centerPage,
+                isCancelled = { !isActive || isRecycling || isRecycled }
+            ) { page, matches ->
+                results += matches
+                onPageResults?.let { callback -> post { callback(page, matches) } }
+            }
+            results
+        }
+    }
+
+    /**
+     * Returns the highlight rects of [match], measuring them when the search did not. Measuring
+     * opens the page of the match if it is not open yet.
+     */
+    fun getSearchMatchRects(match: SearchMatch): List<RectF> = when {
+        match.rects.isNotEmpty() -> match.rects
+        else -> _pdfFile?.getTextRects(match.pageIndex, match.charIndex, match.charCount).orEmpty()
+    }
+
+    /**
+     * Writes the text of the whole document to [fd] as UTF-8 on a background thread, pages in
+     * document order and each followed by a form feed. Memory use does not grow with the document
+     * size. Cancelling the calling coroutine stops the export after the page being extracted.
+     *
+     * @param fd The destination, open for writing. It is not closed.
+     * @param onProgress Called on the main thread with the number of pages written so far.
+     * @return the number of bytes written, -1 if cancelled or -2 if writing failed.
+     */
+    suspend fun exportText(
+        fd: ParcelFileDescriptor,
+        onProgress: ((pagesDone: Int, pageCount: Int) -> Unit)? = null,
+    ): Long {
+        val pdfFile = _pdfFile ?: return -2
+        return withContext(Dispatchers.IO) {
+            pdfFile.extractText(
+                fd = fd,
+                isCancelled = { !isActive || isRecycling || isRecycled }
+            ) { pagesDone, pageCount ->
+                onProgress?.let { callback -> post { callback(pagesDone, pageCount) } }
+            }
+        }
+    }
+
+    /**
+     * Saves the document, with the edits made by [commitAnnotations], to [fd] on a background
+     * thread. Rendering waits while the document is written.
+     *
+     * @param fd The destination, open for writing and empty. It is not closed and must not be the
+     * file the document was loaded from.
+     * @param incremental When true the original file is copied as it is and only the changed
+     * objects are appended, otherwise every object is written again.
+     * @return the bytes written and the time spent, or null if the document could not be saved.
+     */
+    suspend fun saveDocument(fd: ParcelFileDescriptor, incremental: Boolean = true): SaveResult? {
+        val pdfFile = _pdfFile ?: return null
+        return withContext(Dispatchers.IO) { pdfFile.saveTo(fd, incremental) }
+    }
+
+    /**
+     * Builds the full-text index of the document on a background thread, or opens the one built
+     * in a previous session. The index is stored in [directory], in a file named after the
+     * document identifier, and is rebuilt only when the document changes. A cancelled build
+     * resumes where it stopped.
+     *
+     * @return true once the index is complete and [searchFullTextIndex] can use it. False if the
+     * document has no identifier, the index could not be written or the coroutine was cancelled.
+     */
+    suspend fun buildFullTextIndex(
+        directory: File = File(context.cacheDir, FULL_TEXT_INDEX_DIRECTORY),
+    ): Boolean {
+        val pdfFile = _pdfFile ?: return false
+        return withContext(Dispatchers.IO) {
+            val identifier = pdfFile.documentIdentifier ?: return@withContext false
+            if (!directory.isDirectory && !directory.mkdirs()) return@withContext false
+            pdfFile.buildFullTextIndex(File(directory, "$identifier.fti")) {
+                !isActive || isRecycling || isRecycled
+            }
+        }
+    }
+
+    /**
+     * Looks words up in the full-text index built by [buildFullTextIndex], without loading any
+     * page. Words are matched case insensitively and every word of [query] must be on the page.
+     *
+     * @param prefix When true, the last word of [query] also matches longer words, for search as
+     * you type.
+     * @return the positions of the last word of [query], empty if no index is available.
+     */
+    fun searchFullTextIndex(query: String, prefix: Boolean = true): List<TextPosition> =
+        _pdfFile?.searchFullTextIndex(query, prefix).orEmpty()
+
+    /**
+     * Applies the annotation edits of [transaction] to [page] on a background thread, in memory
+     * and without saving the document, then redraws only what changed: the annotation layer when
+     * the page draws its annotations above the tiles, otherwise the tiles under the edited
+     * annotations.
+     *
+     * @return the outcome of each edit, null if the page could not be opened.
+     */
+    suspend fun commitAnnotations(
+        page: Int,
+        transaction: AnnotationTransaction,
+    ): AnnotationCommit? {
+        val pdfFile = _pdfFile ?: return null
+        val edit = withContext(Dispatchers.IO) {
+            pdfFile.applyAnnotationTransaction(page, transaction)
+        } ?: return null
+        if (pdfFile === _pdfFile && !isRecycled && !isRecycling) onAnnotationsEdited(page, edit)
+        return edit.commit
+    }
+
+    private fun onAnnotationsEdited(page: Int, edit: PdfFile.AnnotationEdit) {
+        val dirty = edit.commit.dirtyBounds ?: return
+        val layer = edit.layer
+        when (layer) {
+            null -> annotationOverlay.removeLayer(page)
+            else -> annotationOverlay.setLayer(page, layer)
+        }
+        if (isAnnotationRendering) {
+            val previousLayer = edit.previousLayer
+            when {
+                // Annotations moved between the tiles and the overlay
+                layer != null && previousLayer != null &&
+                        layer.isComplete != previousLayer.isComplete ->
+                    cacheManager.clearPageCache(page)
+
+                // The tiles draw the annotations
+                layer == null || !layer.isComplete -> {
+                    val crop = pdfFile.getPageCrop(page) ?: PdfFile.FULL_PAGE
+                    val bounds = RectF(
+                        (dirty.left - crop.left) / crop.width(),
+                        (dirty.top - crop.top) / crop.height(),
+                        (dirty.right - crop.left) / crop.width(),
+                        (dirty.bottom - crop.top) / crop.height()
+                    )
+                    cacheManager.clearPageRegion(page, bounds)
+                }
+            }
+        }
+        redraw()
+        loadPages()
+    }
+
     internal fun callOnTap(e: MotionEvent): Boolean =
         viewConfiguration.gestureEventListener?.onTap(e) ?: false
 
@@ -1548,5 +2003,12 @@ class PDFView(context: Context?, attrs: AttributeSet?) : RelativeLayout(context,
         const val DEFAULT_MAX_SCALE = 3.0f
         const val DEFAULT_MID_SCALE = 1.75f
         const val DEFAULT_MIN_SCALE = 1.0f
+        private const val FULL_TEXT_INDEX_DIRECTORY = "pdf_text_index"
+        private const val PAGE_SIZE_CHUNK_PAGES = 256
+        private const val PAGE_CROP_CHUNK_PAGES = 16
+        private const val PAGE_SIZE_FLING_WAIT_MS = 50L
+
+        private const val PLACEHOLDER_COLOR = 0xFFF5F5F5.toInt()
+        private const val PLACEHOLDER_BORDER_COLOR = 0xFFDDDDDD.toInt()
     }
 }
\ No newline at end of file
@@ -3,6 +3,7 @@ package com.harissk.pdfpreview
 import android.graphics.RectF
 import com.harissk.pdfium.exception.PageRenderingException
 import com.harissk.pdfium.util.SizeF
+import com.harissk.pdfpreview.utils.TilePyramid
 import com.harissk.pdfpreview.utils.toPx
 import java.util.LinkedList
 import kotlin.math.abs
@@ -40,6 +41,17 @@ internal class PagesLoader(private val pdfView: PDFView) {
     private var pageRelativePartHeight = 0f
     private var partRenderWidth = 0f
     private var partRenderHeight = 0f
+    private var isDraftPass = false
+
+    /** Pages on screen in the current pass, heavy pages are not prefetched outside of them */
+    private var visiblePages = IntRange.EMPTY
+
+    /** Pages whose thumbnail was queued by the current pass before their complexity is known */
+    private val profilingPages = HashSet<Int>()
+
+    /** Pyramid level of the current pass, and the zoom its tiles are rendered at */
+    private var zoomLevel = 0
+    private var levelZoom = 1f
 
     private val thumbnailRect = RectF(0f, 0f, 1f, 1f)
     private val preloadOffset: Int =
@@ -75,19 +87,11 @@ internal class PagesLoader(private val pdfView: PDFView) {
         val ratioX: Float = 1f / size.width
         val ratioY: Float = 1f / size.height
 
-        // Maintain tile size at higher zoom levels to prevent blur
-        // Use a more aggressive scaling approach for better quality
-        val zoomFactor = pdfView.zoom.coerceAtLeast(1f)
-        val effectiveTileSize = pdfView.pdfViewerConfiguration.renderTileSize *
-                when {
-                    zoomFactor >= 3f -> zoomFactor * 1.5f  // Extra quality at high zoom
-                    zoomFactor >= 2f -> zoomFactor * 1.25f // Good quality at medium zoom
-                    zoomFactor > 1f -> zoomFactor          // Standard scaling
-                    else -> 1f                              // Base quality
-                }
-
-        val partHeight: Float = effectiveTileSize * ratioY / pdfView.zoom
-        val partWidth: Float = effectiveTileSize * ratioX / pdfView.zoom
+        // The grid follows the pyramid level rather than the exact zoom, so every zoom value
+        // within a level maps to the same tiles
+        val effectiveTileSize = effectiveTileSize(pageIndex)
+        val partHeight: Float = effectiveTileSize * ratioY / levelZoom
+        val partWidth: Float = effectiveTileSize * ratioX / levelZoom
 
         // Ensure valid calculations and prevent NaN/infinite values
         val calculatedRows = if (partHeight > 0f && !partHeight.isNaN()) {
@@ -102,7 +106,7 @@ internal class PagesLoader(private val pdfView: PDFView) {
         grid.cols = calculatedCols
     }
 
-    private fun calculatePartSize(grid: GridSize) {
+    private fun calculatePartSize(grid: GridSize, pageIndex: Int) {
         // Ensure grid size is valid
         val validCols = grid.cols.coerceAtLeast(1)
         val validRows = grid.rows.coerceAtLeast(1)
@@ -111,14 +115,7 @@ internal class PagesLoader(private val pdfView: PDFView) {
         pageRelativePartHeight = 1f / validRows.toFloat()
 
         // Use effective tile size that maintains quality at higher zoom levels
-        val zoomFactor = pdfView.zoom.coerceAtLeast(1f)
-        val effectiveTileSize = pdfView.pdfViewerConfiguration.renderTileSize *
-                when {
-                    zoomFactor >= 3f -> zoomFactor * 1.5f  // Extra quality at high zoom
-                    zoomFactor >= 2f -> zoomFactor * 1.25f // Good quality at medium zoom
-                    zoomFactor > 1f -> zoomFactor          // Standard scaling
-                    else -> 1f                              // Base quality
-                }
+        val effectiveTileSize = effectiveTileSize(pageIndex)
 
         // Validate that pageRelativePartWidth and pageRelativePartHeight are not zero
         val safePageRelativePartWidth = pageRelativePartWidth.takeIf { it > 0f } ?: 1f
@@ -134,6 +131,24 @@ internal class PagesLoader(private val pdfView: PDFView) {
         }
     }
 
+    /**
+     * Size of the tiles of [pageIndex] at the current pyramid level. Heavy pages walk all their
+     * objects for every tile, so they get fewer and larger tiles.
+     */
+    private fun effectiveTileSize(pageIndex: Int): Float {
+        val zoomFactor = levelZoom.coerceAtLeast(1f)
+        val pageScale = if (isHeavyPage(pageIndex)) HEAVY_PAGE_TILE_SCALE else 1f
+        return pdfView.pdfViewerConfiguration.renderTileSize * pageScale *
+                when {
+                    // Maintain tile size at higher zoom levels to prevent blur
+                    // Use a more aggressive scaling approach for better quality
+                    zoomFactor >= 3f -> zoomFactor * 1.5f  // Extra quality at high zoom
+                    zoomFactor >= 2f -> zoomFactor * 1.25f // Good quality at medium zoom
+                    zoomFactor > 1f -> zoomFactor          // Standard scaling
+                    else -> 1f                              // Base quality
+                }
+    }
+
     /**
      * Calculates the render range of each page.
      */
@@ -328,7 +343,7 @@ internal class PagesLoader(private val pdfView: PDFView) {
             pdfView.singlePageMode -> {
                 // In single page mode, only load the current page
                 try {
-                    loadThumbnail(pdfView.currentPage)
+                    if (loadThumbnail(pdfView.currentPage)) profilingPages += pdfView.currentPage
                 } catch (e: Exception) {
                     pdfView.logWriter?.writeLog(
                         "Failed to load thumbnail for current page ${pdfView.currentPage}: ${e.message}",
@@ -339,7 +354,7 @@ internal class PagesLoader(private val pdfView: PDFView) {
                 try {
                     val gridSize = GridSize(0, 0)
                     getPageColsRows(gridSize, pdfView.currentPage)
-                    calculatePartSize(gridSize)
+                    calculatePartSize(gridSize, pdfView.currentPage)
                     val partsToLoad = pdfView.pdfViewerConfiguration.maxCachedBitmaps
                     loadPage(
                         page = pdfView.currentPage,
@@ -372,7 +387,7 @@ internal class PagesLoader(private val pdfView: PDFView) {
 
                 for (range in limitedRangeList)
                     try {
-                        loadThumbnail(range.page)
+                        if (loadThumbnail(range.page)) profilingPages += range.page
                     } catch (e: Exception) {
                         pdfView.logWriter?.writeLog(
                             "Failed to load thumbnail for page ${range.page}: ${e.message}",
@@ -387,7 +402,7 @@ internal class PagesLoader(private val pdfView: PDFView) {
 
                 for (range in limitedRangeList)
                     try {
-                        calculatePartSize(range.gridSize)
+                        calculatePartSize(range.gridSize, range.page)
                         val partsToLoad = minOf(
                             pdfView.pdfViewerConfiguration.maxCachedBitmaps - loadedParts,
                             maxPartsPerCall - loadedParts
@@ -426,6 +441,14 @@ internal class PagesLoader(private val pdfView: PDFView) {
         page: Int, firstRow: Int, lastRow: Int, firstCol: Int, lastCol: Int,
         nbOfPartsLoadable: Int,
     ): Int {
+        // Blank pages are drawn as a fill without tiles
+        if (pdfView.pdfFile.isPageBlank(page)) return 0
+        // Rendering the thumbnail measures the page, its tiles are sized once that is known
+        if (page in profilingPages && pdfView.pdfFile.getPageComplexity(page) == null) return 0
+        // A draft of a heavy page costs nearly as much as the real tile, and prefetching one
+        // delays the screen, its thumbnail stands in meanwhile
+        if (isHeavyPage(page) && (isDraftPass || page !in visiblePages)) return 0
+
         // Calculate screen center in page coordinates for prioritized loading
         val screenCenterRow = (firstRow + lastRow) / 2f
         val screenCenterCol = (firstCol + lastCol) / 2f
@@ -472,36 +495,51 @@ internal class PagesLoader(private val pdfView: PDFView) {
             relY + pageRelativePartHeight > 1 -> 1 - relY
             else -> pageRelativePartHeight
         }
-        val renderWidth = partRenderWidth * relWidth
-        val renderHeight = partRenderHeight * relHeight
+        val renderScale = when {
+            isDraftPass -> pdfView.pdfViewerConfiguration.draftRenderScale.coerceIn(0.1f, 1f)
+            else -> 1f
+        }
+        val renderWidth = partRenderWidth * relWidth * renderScale
+        val renderHeight = partRenderHeight * relHeight * renderScale
 
         // Don't proceed if the render dimensions are zero
         if (renderWidth <= 0 || renderHeight <= 0) return false
 
         val pageRelativeBounds = RectF(relX, relY, relX + relWidth, relY + relHeight)
-        if (!pdfView.cacheManager.upPartIfContained(page, pageRelativeBounds, cacheOrder))
-            pdfView.renderingHandler?.addRenderingTask(
+        if (!pdfView.cacheManager.upPartIfContained(
                 page = page,
-                width = renderWidth,
-                height = renderHeight,
-                bounds = pageRelativeBounds,
-                thumbnail = false,
-                cacheOrder = cacheOrder,
-                bestQuality = pdfView.isBestQuality,
-                annotationRendering = pdfView.isAnnotationRendering
+                pageRelativeBounds = pageRelativeBounds,
+                zoomLevel = zoomLevel,
+                toOrder = cacheOrder,
+                acceptDraft = isDraftPass
             )
+        ) pdfView.renderingHandler?.addRenderingTask(
+            page = page,
+            width = renderWidth,
+            height = renderHeight,
+            bounds = pageRelativeBounds,
+            thumbnail = false,
+            cacheOrder = cacheOrder,
+            bestQuality = pdfView.isBestQuality,
+            annotationRendering = pdfView.isAnnotationRendering,
+            draft = isDraftPass,
+            zoomLevel = zoomLevel,
+            pixelPipeline = pdfView.pixelPipeline
+        )
         cacheOrder++
         return true
     }
 
-    private fun loadThumbnail(page: Int) {
+    /** Queues the thumbnail of the page unless it is cached, @return true if it was queued */
+    private fun loadThumbnail(page: Int): Boolean {
         // Validate page index
         if (page < 0 || page >= pdfView.pageCount) {
             pdfView.logWriter?.writeLog("Invalid page index for thumbnail: $page", TAG)
-            return
+            return false
         }
 
-        val pageSize: SizeF = pdfView.pdfFile.getPageSize(page) ?: return
+        if (pdfView.pdfFile.isPageBlank(page)) return false
+        val pageSize: SizeF = pdfView.pdfFile.getPageSize(page) ?: return false
 
         // Validate page size for thumbnails
         if (pageSize.width <= 0f || pageSize.height <= 0f) {
@@ -509,7 +547,7 @@ internal class PagesLoader(private val pdfView: PDFView) {
                 "Invalid page size for thumbnail page $page: width=${pageSize.width}, height=${pageSize.height}",
                 TAG
             )
-            return
+            return false
         }
 
         val thumbWidth = pageSize.width * pdfView.pdfViewerConfiguration.thumbnailQuality
@@ -521,30 +559,60 @@ internal class PagesLoader(private val pdfView: PDFView) {
                 "Invalid thumbnail dimensions for page $page: width=$thumbWidth, height=$thumbHeight",
                 TAG
             )
-            return
+            return false
         }
 
-        if (!pdfView.cacheManager.containsThumbnail(page, thumbnailRect))
-            pdfView.renderingHandler?.addRenderingTask(
-                page = page,
-                width = thumbWidth,
-                height = thumbHeight,
-                bounds = thumbnailRect,
-                thumbnail = true,
-                cacheOrder = 0,
-                bestQuality = pdfView.isBestQuality,
-                annotationRendering = pdfView.isAnnotationRendering
-            )
+        if (pdfView.cacheManager.containsThumbnail(page, thumbnailRect)) return false
+        val handler = pdfView.renderingHandler ?: return false
+        handler.addRenderingTask(
+            page = page,
+            width = thumbWidth,
+            height = thumbHeight,
+            bounds = thumbnailRect,
+            thumbnail = true,
+            cacheOrder = 0,
+            bestQuality = pdfView.isBestQuality,
+            annotationRendering = pdfView.isAnnotationRendering,
+            pixelPipeline = pdfView.pixelPipeline
+        )
+        return true
+    }
+
+    /** True for pages expensive enough to be scheduled apart, see heavyPageCost */
+    private fun isHeavyPage(page: Int): Boolean {
+        val heavyPageCost = pdfView.pdfViewerConfiguration.heavyPageCost
+        if (heavyPageCost <= 0) return false
+        val complexity = pdfView.pdfFile.getPageComplexity(page) ?: return false
+        return complexity.renderCost >= heavyPageCost
     }
 
-    fun loadPages() {
+    /**
+     * Queues the visible parts for rendering.
+     *
+     * @param draft When true, missing parts are rendered as reduced quality drafts and existing
+     * drafts are kept. Otherwise drafts are treated as missing so they get refined.
+     */
+    fun loadPages(draft: Boolean = false) {
+        isDraftPass = draft
+        zoomLevel = pdfView.zoomLevel
+        levelZoom = TilePyramid.zoomFor(zoomLevel, pdfView.pdfViewerConfiguration.zoomLevelStep)
         cacheOrder = 1
         xOffset = -pdfView.currentXOffset.coerceIn(-Float.MAX_VALUE, 0f)
         yOffset = -pdfView.currentYOffset.coerceIn(-Float.MAX_VALUE, 0f)
+        val visibleStart = if (pdfView.isSwipeVertical) yOffset else xOffset
+        val visibleEnd = visibleStart + if (pdfView.isSwipeVertical) pdfView.height else pdfView.width
+        visiblePages = when {
+            pdfView.singlePageMode -> pdfView.currentPage..pdfView.currentPage
+            else -> pdfView.pdfFile.getPagesInRange(visibleStart, visibleEnd, pdfView.zoom)
+        }
+        profilingPages.clear()
         loadVisible()
     }
 
     companion object {
         private const val TAG = "PagesLoader"
+
+        /** Tile size of heavy pages relative to the configured one */
+        private const val HEAVY_PAGE_TILE_SCALE = 2f
     }
 }
\ No newline at end of file
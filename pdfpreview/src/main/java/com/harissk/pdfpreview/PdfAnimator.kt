@@ -34,6 +34,7 @@ internal class PdfAnimator(private val pdfView: PDFView) {
     private val flingScroller = OverScroller(pdfView.context)
     private var flinging = false
     private var isPageAnimating = false
+    private var lastDraftLoadTime = 0L
 
     fun animateHorizontal(startX: Float, targetX: Float) = animate(startX, targetX, false)
 
@@ -54,6 +55,7 @@ internal class PdfAnimator(private val pdfView: PDFView) {
                     if (isAnimatingVertically) animationValue else pdfView.currentYOffset,
                     moveHandle = true
                 )
+                if (isPageAnimating) loadDraftPages()
             }
             addListener(object : AnimatorListenerAdapter() {
                 override fun onAnimationEnd(animation: Animator) = handleAnimationEnd()
@@ -153,6 +155,7 @@ internal class PdfAnimator(private val pdfView: PDFView) {
                     offsetY = flingScroller.currY.toFloat(),
                     moveHandle = true,
                 )
+                loadDraftPages()
                 pdfView.invalidate()
             }
 
@@ -169,6 +172,14 @@ internal class PdfAnimator(private val pdfView: PDFView) {
         }
     }
 
+    // Drafts are requested at a fixed interval so the renderer is not flooded while moving
+    private fun loadDraftPages() {
+        val currentTime = System.currentTimeMillis()
+        if (currentTime - lastDraftLoadTime < DRAFT_LOAD_INTERVAL_MS) return
+        lastDraftLoadTime = currentTime
+        pdfView.loadDraftPages()
+    }
+
     fun cancelAllAnimations() {
         activeAnimation?.cancel()
         activeAnimation = null
@@ -182,4 +193,8 @@ internal class PdfAnimator(private val pdfView: PDFView) {
 
     val isFlinging: Boolean
         get() = flinging || isPageAnimating
+
+    private companion object {
+        const val DRAFT_LOAD_INTERVAL_MS = 100L
+    }
 }
\ No newline at end of file
@@ -3,20 +3,38 @@ package com.harissk.pdfpreview
 import android.graphics.Bitmap
 import android.graphics.Rect
 import android.graphics.RectF
+import android.os.ParcelFileDescriptor
+import android.util.SparseArray
 import android.util.SparseBooleanArray
+import android.util.SparseIntArray
+import android.util.SparseLongArray
 import androidx.core.util.getOrDefault
 import com.harissk.pdfium.Bookmark
 import com.harissk.pdfium.Link
 import com.harissk.pdfium.Meta
+import com.harissk.pdfium.PageComplexity
 import com.harissk.pdfium.PdfiumCore
+import com.harissk.pdfium.PixelPipeline
+import com.harissk.pdfium.SaveResult
+import com.harissk.pdfium.annotation.AnnotationCommit
+import com.harissk.pdfium.annotation.AnnotationLayer
+import com.harissk.pdfium.annotation.AnnotationTransaction
 import com.harissk.pdfium.exception.PageRenderingException
+import com.harissk.pdfium.search.IncrementalSearchSession
+import com.harissk.pdfium.search.SearchMatch
+import com.harissk.pdfium.text.FullTextIndex
+import com.harissk.pdfium.text.TextPosition
 import com.harissk.pdfium.util.Size
 import com.harissk.pdfium.util.SizeF
+import com.harissk.pdfpreview.utils.CropPolicy
 import com.harissk.pdfpreview.utils.FitPolicy
+import com.harissk.pdfpreview.utils.PageLayoutIndex
 import com.harissk.pdfpreview.utils.PageSizeCalculator
+import java.io.File
 import java.util.LinkedList
 import java.util.Queue
 import kotlin.math.max
+import kotlin.math.roundToInt
 
 /**
  * Copyright [2025] [Haris Kumar R](https://github.com/rhariskumar3)
@@ -49,6 +67,10 @@ import kotlin.math.max
  * FitPolicy}, else the largest page fits and other pages scale relatively.
  * @param maxPageCacheSize The maximum number of pages that can be kept in the view
  * @param singlePageMode When true, positions each page individually for single-page-at-a-time viewing
+ * @param lazyPageSizeThreshold Documents with more pages start from estimated page sizes, which
+ * are replaced by [applyPageSizes]. 0 reads every size up front.
+ * @param cropPolicy How the margins of pages are cropped. Pages after the first are shown in full
+ * until [applyPageSizes] crops them.
  */
 class PdfFile(
     private val pdfiumCore: PdfiumCore,
@@ -61,6 +83,8 @@ class PdfFile(
     private val fitEachPage: Boolean,
     private val maxPageCacheSize: Int,
     private val singlePageMode: Boolean = false,
+    private val lazyPageSizeThreshold: Int = 0,
+    private val cropPolicy: CropPolicy = CropPolicy.NONE,
 ) {
     var pagesCount = 0
         private set
@@ -74,9 +98,31 @@ class PdfFile(
     /** Opened pages with indicator whether opening was successful  */
     private val openedPages = SparseBooleanArray()
 
-    /** Opened pages queue **/
+    /** Opened document pages queue, eldest first **/
     private val openedPageQueue: Queue<Int> = LinkedList()
 
+    /** Estimated native memory held by each opened document page */
+    private val openedPageBytes = SparseLongArray()
+
+    /**
+     * Complexity of each document page, measured the first time it is opened. Written by the
+     * rendering thread and read by the main thread, entries are immutable once set.
+     */
+    private var pageComplexity = arrayOfNulls<PageComplexity>(0)
+
+    /** Annotations of document pages drawn above their content, guarded by this file */
+    private val annotationLayers = SparseArray<AnnotationLayer>()
+
+    /** Document pages released by the memory governor, closed by the rendering thread */
+    private val pendingReleasePages = LinkedHashSet<Int>()
+
+    /** Word index of the document, null until [buildFullTextIndex] found or built one */
+    @Volatile
+    private var fullTextIndex: FullTextIndex? = null
+
+    /** Search as you type session of [searchIncremental], guarded by this file */
+    private var incrementalSearch: IncrementalSearchSession? = null
+
     /** Page with maximum width  */
     private var originalMaxWidthPageSize: Size = Size(0, 0)
 
@@ -89,25 +135,48 @@ class PdfFile(
     /** Scaled page with maximum width  */
     private var maxWidthPageSize: SizeF? = SizeF(0F, 0F)
 
-    /** Calculated offsets for pages  */
-    private val pageOffsets = arrayListOf<Float>()
-
     /** Calculated auto spacing for pages  */
     private val pageSpacing = arrayListOf<Float>()
 
-    /** Calculated document length (width or height, depending on swipe mode)  */
-    private var documentLength = 0f
+    /** Page lengths plus the spacing after them, summed to find page offsets  */
+    private var layoutIndex = PageLayoutIndex(FloatArray(0))
 
     /** Current view size for calculations */
     private var currentViewSize: Size? = null
 
+    /** Scales original page sizes for the current view, reused when page sizes are resolved */
+    private var pageSizeCalculator: PageSizeCalculator? = null
+
+    /** Pages whose real size and crop are known, null once every page is resolved */
+    private var resolvedPages: BooleanArray? = null
+    private var unresolvedCount = 0
+
+    /** Part of each page that is shown, as fractions of its size, null entries show it in full */
+    private var pageCrops: Array<RectF?>? = null
+
+    /**
+     * Whether each page is blank, see [checkPageBlank]. Written by the rendering thread, which
+     * then posts to the main thread, so reads on the main thread see it.
+     */
+    private var pageBlankness = ByteArray(0)
+
     /**
      * The pages the user want to display in order (ex: 0, 2, 2, 8, 8, 1, 1, 1)
      */
     private var originalUserPages: List<Int>?
 
+    /** First user page showing each document page of [originalUserPages], see [userPage] */
+    private var firstUserPages: SparseIntArray? = null
+
     init {
         this.originalUserPages = originalUserPages
+        firstUserPages = originalUserPages?.let { userPages ->
+            SparseIntArray(userPages.size).apply {
+                userPages.forEachIndexed { userPage, documentPage ->
+                    if (indexOfKey(documentPage) < 0) put(documentPage, userPage)
+                }
+            }
+        }
         setup(viewSize)
     }
 
@@ -121,17 +190,213 @@ class PdfFile(
             originalUserPages != null -> originalUserPages!!.size
             else -> pdfiumCore.pageCount
         }
+        pageBlankness = ByteArray(pagesCount)
+        pageComplexity = arrayOfNulls(pdfiumCore.pageCount)
+        val isLazy = lazyPageSizeThreshold in 1 until pagesCount && LAZY_SAMPLE_PAGES < pagesCount
+        val readCount = if (isLazy) LAZY_SAMPLE_PAGES else pagesCount
+        val sizes = pdfiumCore.getPageSizes(IntArray(readCount) { documentPage(it) })
+        val fullSizes = List(readCount) { Size(sizes[it * 2], sizes[it * 2 + 1]) }
+        // The remaining pages take the most common size of the sample until resolved
+        val estimatedSize =
+            fullSizes.groupingBy { it }.eachCount().maxByOrNull { it.value }?.key ?: Size(0, 0)
+
+        // Cropping loads and may scan every page, only the first page is cropped before the
+        // document is shown. The others are shown in full until their crops are read in the
+        // background, a guessed crop could hide their content.
+        val exactCount = when (cropPolicy) {
+            CropPolicy.NONE -> readCount
+            else -> minOf(1, pagesCount)
+        }
+        if (cropPolicy != CropPolicy.NONE) {
+            val crops = readPageCrops(IntArray(exactCount) { it })
+            pageCrops = Array(pagesCount) { crops.getOrNull(it) }
+        }
+
         for (i in 0 until pagesCount) {
-            val pageSize: Size = pdfiumCore.getPageSize(documentPage(i))
-            if (pageSize.width > originalMaxWidthPageSize.width)
-                originalMaxWidthPageSize = pageSize
-            if (pageSize.height > originalMaxHeightPageSize.height)
-                originalMaxHeightPageSize = pageSize
+            val pageSize = croppedSize(fullSizes.getOrElse(i) { estimatedSize }, getPageCrop(i))
+            updateMaxPageSizes(pageSize)
             originalPageSizes.add(pageSize)
         }
+        if (exactCount < pagesCount) {
+            resolvedPages = BooleanArray(pagesCount) { it < exactCount }
+            unresolvedCount = pagesCount - exactCount
+        }
         recalculatePageSizes(viewSize)
     }
 
+    /** Crops of user pages read from their content, null for pages shown in full */
+    private fun readPageCrops(pages: IntArray): Array<RectF?> {
+        val bounds = pdfiumCore.getPageContentBounds(
+            indexes = IntArray(pages.size) { documentPage(pages[it]) },
+            scanImages = cropPolicy == CropPolicy.CONTENT_AND_SCANS
+        )
+        return Array(pages.size) { i ->
+            val crop = RectF(bounds[i * 4], bounds[i * 4 + 1], bounds[i * 4 + 2], bounds[i * 4 + 3])
+            if (crop == FULL_PAGE) null else crop
+        }
+    }
+
+    private fun croppedSize(size: Size, crop: RectF?): Size = when (crop) {
+        null -> size
+        else -> Size(
+            (size.width * crop.width()).roundToInt().coerceAtLeast(1),
+            (size.height * crop.height()).roundToInt().coerceAtLeast(1)
+        )
+    }
+
+    /** Part of the page that is shown, as fractions of its size, or null if it is shown in full */
+    fun getPageCrop(pageIndex: Int): RectF? = pageCrops?.getOrNull(pageIndex)
+
+    /** Bounds of the whole page when its [crop] is drawn in [bounds] */
+    private fun uncroppedBounds(bounds: Rect, crop: RectF?): Rect {
+        if (crop == null) return bounds
+        val width = bounds.width() / crop.width()
+        val height = bounds.height() / crop.height()
+        val left = bounds.left - crop.left * width
+        val top = bounds.top - crop.top * height
+        return Rect(
+            left.roundToInt(),
+            top.roundToInt(),
+            (left + width).roundToInt(),
+            (top + height).roundToInt()
+        )
+    }
+
+    /** @return true if [pageSize] is wider or taller than every page seen so far */
+    private fun updateMaxPageSizes(pageSize: Size): Boolean {
+        var changed = false
+        if (pageSize.width > originalMaxWidthPageSize.width) {
+            originalMaxWidthPageSize = pageSize
+            changed = true
+        }
+        if (pageSize.height > originalMaxHeightPageSize.height) {
+            originalMaxHeightPageSize = pageSize
+            changed = true
+        }
+        return changed
+    }
+
+    /** Largest page sizes found again from scratch, @return true if they changed */
+    private fun resetMaxPageSizes(): Boolean {
+        val maxWidthPageSize = originalMaxWidthPageSize
+        val maxHeightPageSize = originalMaxHeightPageSize
+        originalMaxWidthPageSize = Size(0, 0)
+        originalMaxHeightPageSize = Size(0, 0)
+        originalPageSizes.forEach(::updateMaxPageSizes)
+        return maxWidthPageSize != originalMaxWidthPageSize ||
+                maxHeightPageSize != originalMaxHeightPageSize
+    }
+
+    /** True while some pages are laid out with an estimated size or crop */
+    val hasUnresolvedPageSizes: Boolean
+        get() = resolvedPages != null
+
+    /**
+     * Returns up to [count] pages whose size or crop is still estimated, nearest to [centerPage]
+     * first, alternating after and before it.
+     */
+    fun nextUnresolvedPages(centerPage: Int, count: Int): IntArray {
+        val resolved = resolvedPages ?: return IntArray(0)
+        val pages = IntArray(minOf(count, unresolvedCount))
+        var found = 0
+        var after = centerPage.coerceIn(0, pagesCount - 1)
+        var before = after - 1
+        while (found < pages.size && (after < pagesCount || before >= 0)) {
+            if (after < pagesCount) {
+                if (!resolved[after]) pages[found++] = after
+                after++
+            }
+            if (found < pages.size && before >= 0) {
+                if (!resolved[before]) pages[found++] = before
+                before--
+            }
+        }
+        return pages
+    }
+
+    /** Real sizes, as width and height pairs, and crops of [pages], see [readPageSizes] */
+    internal class PageSizeBatch(
+        val pages: IntArray,
+        val sizes: IntArray,
+        val crops: Array<RectF?>?,
+    )
+
+    /** True if resolving page sizes also reads crops, which loads every page */
+    internal val cropsPages: Boolean
+        get() = cropPolicy != CropPolicy.NONE
+
+    /**
+     * Reads the real sizes and crops of [pages] from the document for [applyPageSizes]. Safe to
+     * call from a background thread. Crops are read one page per lock hold so that rendering is
+     * not held up by the whole batch.
+     */
+    internal fun readPageSizes(pages: IntArray): PageSizeBatch {
+        val sizes = synchronized(this) {
+            pdfiumCore.getPageSizes(IntArray(pages.size) { documentPage(pages[it]) })
+        }
+        val crops = if (cropsPages) {
+            Array(pages.size) { synchronized(this) { readPageCrops(intArrayOf(pages[it]))[0] } }
+        } else null
+        return PageSizeBatch(pages = pages, sizes = sizes, crops = crops)
+    }
+
+    /**
+     * Replaces the estimated sizes and crops of pages by the ones read by [readPageSizes] and
+     * patches the layout in place. The whole layout is only recalculated when the largest page
+     * size changes. Must be called on the thread that uses the layout.
+     *
+     * @param onPageChanged Called for every page whose size or crop changed, its rendered parts
+     * no longer match.
+     * @return true if the layout changed.
+     */
+    internal fun applyPageSizes(
+        batch: PageSizeBatch,
+        onPageChanged: (pageIndex: Int) -> Unit = {},
+    ): Boolean {
+        val resolved = resolvedPages ?: return false
+        var changed = false
+        var maxChanged = false
+        batch.pages.forEachIndexed { i, page ->
+            if (page !in 0 until pagesCount || resolved[page]) return@forEachIndexed
+            resolved[page] = true
+            unresolvedCount--
+            val crops = pageCrops
+            val crop = batch.crops?.get(i)
+            val recropped = crops != null && crop != crops[page]
+            if (recropped) crops?.set(page, crop)
+            val fullSize = Size(batch.sizes[i * 2], batch.sizes[i * 2 + 1])
+            val pageSize = croppedSize(fullSize, crop)
+            if (pageSize == originalPageSizes[page]) {
+                if (recropped) onPageChanged(page)
+                return@forEachIndexed
+            }
+            onPageChanged(page)
+            originalPageSizes[page] = pageSize
+            if (updateMaxPageSizes(pageSize)) maxChanged = true
+            changed = true
+        }
+        if (unresolvedCount == 0) {
+            resolvedPages = null
+            // Estimates may have raised the largest page size above every real page
+            if (changed && resetMaxPageSizes()) maxChanged = true
+        }
+        if (!changed) return false
+
+        val viewSize = currentViewSize
+        val calculator = pageSizeCalculator
+        if (maxChanged || viewSize == null || calculator == null) {
+            currentViewSize?.let(::recalculatePageSizes)
+            return true
+        }
+        batch.pages.forEach { page ->
+            if (page !in 0 until pagesCount) return@forEach
+            pageSizes[page] = calculator.calculate(originalPageSizes[page])
+            if (autoSpacing) pageSpacing[page] = autoSpacingOf(page, viewSize)
+            layoutIndex[page] = pageExtent(page)
+        }
+        return true
+    }
+
     /**
      * Recalculates the page sizes, offsets, and document length based on the current view size.
      *
@@ -147,12 +412,12 @@ class PdfFile(
             viewSize = viewSize,
             fitEachPage = fitEachPage
         )
+        pageSizeCalculator = calculator
         maxWidthPageSize = calculator.optimalMaxWidthPageSize
         maxHeightPageSize = calculator.optimalMaxHeightPageSize
         for (size in originalPageSizes) pageSizes.add(calculator.calculate(size))
         if (autoSpacing) prepareAutoSpacing(viewSize)
-        prepareDocLen()
-        preparePagesOffset()
+        prepareLayoutIndex()
     }
 
     fun getPageSize(pageIndex: Int): SizeF? = when {
@@ -181,78 +446,58 @@ class PdfFile(
 
     private fun prepareAutoSpacing(viewSize: Size) {
         pageSpacing.clear()
-        for (i in 0 until pagesCount) {
-            val pageSize: SizeF = pageSizes[i]
-            var spacing: Float = max(
-                0F,
-                if (isVertical) viewSize.height - pageSize.height else viewSize.width - pageSize.width
-            )
-            if (i < pagesCount - 1) spacing += spacingPx.toFloat()
-            pageSpacing.add(spacing)
-        }
+        for (i in 0 until pagesCount) pageSpacing.add(autoSpacingOf(i, viewSize))
     }
 
-    private fun prepareDocLen() {
-        when {
-            singlePageMode -> {
-                // In single page mode, document length is the size of one page
-                val pageSize: SizeF = pageSizes.getOrNull(0) ?: SizeF(0F, 0F)
-                documentLength = if (isVertical) pageSize.height else pageSize.width
-            }
+    private fun autoSpacingOf(pageIndex: Int, viewSize: Size): Float {
+        val pageSize: SizeF = pageSizes[pageIndex]
+        var spacing: Float = max(
+            0F,
+            if (isVertical) viewSize.height - pageSize.height else viewSize.width - pageSize.width
+        )
+        if (pageIndex < pagesCount - 1) spacing += spacingPx.toFloat()
+        return spacing
+    }
 
-            else -> {
-                // Original continuous document length calculation
-                var length = 0f
-                for (i in 0 until pagesCount) {
-                    val pageSize: SizeF = pageSizes[i]
-                    length += if (isVertical) pageSize.height else pageSize.width
-                    when {
-                        autoSpacing -> length += pageSpacing[i]
-                        i < pagesCount - 1 -> length += spacingPx.toFloat()
-                    }
-                }
-                documentLength = length
-            }
-        }
+    private fun prepareLayoutIndex() {
+        layoutIndex = PageLayoutIndex(FloatArray(pagesCount) { pageExtent(it) })
     }
 
-    private fun preparePagesOffset() {
-        pageOffsets.clear()
-        when {
+    /** Length of a page along the scroll axis plus the spacing that follows it, unzoomed */
+    private fun pageExtent(pageIndex: Int): Float {
+        val pageSize: SizeF = pageSizes[pageIndex]
+        val length = if (isVertical) pageSize.height else pageSize.width
+        return length + if (autoSpacing) pageSpacing[pageIndex] else spacingPx.toFloat()
+    }
+
+    /**
+     * Unzoomed primary offset of a page in the continuous strip. With auto spacing a page is
+     * centered in its spacing, and the first and last pages give up half of [spacingPx] as the
+     * strip has no spacing before or after them. A single page is only shifted as the first one.
+     */
+    private fun unzoomedPageOffset(pageIndex: Int): Float {
+        val offset = layoutIndex.prefixSum(pageIndex).toFloat()
+        if (!autoSpacing) return offset
+        val edge = if (pageIndex > 0 && pageIndex == pagesCount - 1) spacingPx / 2f else 0f
+        return offset + pageSpacing[pageIndex] / 2f - spacingPx / 2f + edge
+    }
+
+    fun getDocLen(zoom: Float): Float {
+        val documentLength = when {
+            // In single page mode, document length is the size of one page
             singlePageMode -> {
-                // In single page mode, each page is positioned at offset 0 (screen center)
-                for (i in 0 until pagesCount) pageOffsets.add(0f)
+                val pageSize: SizeF = pageSizes.getOrNull(0) ?: SizeF(0F, 0F)
+                if (isVertical) pageSize.height else pageSize.width
             }
 
-            else -> {
-                // Original continuous strip positioning
-                var offset = 0f
-                for (i in 0 until pagesCount) {
-                    val pageSize: SizeF = pageSizes[i]
-                    val size: Float = if (isVertical) pageSize.height else pageSize.width
-                    when {
-                        autoSpacing -> {
-                            offset += pageSpacing[i] / 2f
-                            when (i) {
-                                0 -> offset -= spacingPx / 2f
-                                pagesCount - 1 -> offset += spacingPx / 2f
-                            }
-                            pageOffsets.add(offset)
-                            offset += size + pageSpacing[i] / 2f
-                        }
-
-                        else -> {
-                            pageOffsets.add(offset)
-                            offset += size + spacingPx
-                        }
-                    }
-                }
-            }
+            pagesCount == 0 -> 0f
+            // Auto spacing already leaves out spacingPx after the last page
+            autoSpacing -> layoutIndex.total.toFloat()
+            else -> (layoutIndex.total - spacingPx).toFloat()
         }
+        return documentLength * zoom
     }
 
-    fun getDocLen(zoom: Float): Float = documentLength * zoom
-
     /**
      * Get the page's height if swiping vertical, or width if swiping horizontal.
      */
@@ -268,7 +513,9 @@ class PdfFile(
     fun getPageOffset(pageIndex: Int, zoom: Float): Float {
         return when {
             documentPage(pageIndex) < 0 -> 0F
-            else -> pageOffsets[pageIndex] * zoom
+            // In single page mode, each page is positioned at offset 0 (screen center)
+            singlePageMode -> 0F
+            else -> unzoomedPageOffset(pageIndex) * zoom
         }
     }
 
@@ -288,14 +535,44 @@ class PdfFile(
         }
     }
 
+    /**
+     * Returns the page at a primary offset, that is the last page whose start, half of its
+     * spacing included, lies before [offset]. Takes O(log n) in the continuous strip.
+     */
     fun getPageAtOffset(offset: Float, zoom: Float): Int {
-        var currentPage = 0
-        for (i in 0 until pagesCount) {
-            val off = pageOffsets[i] * zoom - getPageSpacing(i, zoom) / 2f
-            if (off >= offset) break
-            currentPage++
+        val pagesBefore = when {
+            // Every page shares offset 0, only their spacing tells them apart
+            singlePageMode -> (0 until pagesCount).count { i ->
+                -getPageSpacing(i, zoom) / 2f < offset
+            }
+
+            else -> countPagesStartingBefore(offset / zoom)
         }
-        return if (--currentPage >= 0) currentPage else 0
+        return (pagesBefore - 1).coerceAtLeast(0)
+    }
+
+    /**
+     * Pages whose start, half of their spacing included, is before an unzoomed [offset]. The
+     * start of page i is the sum of the extents before it minus half of [spacingPx], except for
+     * the last page with auto spacing, which starts half of [spacingPx] later.
+     */
+    private fun countPagesStartingBefore(offset: Float): Int {
+        val target = offset.toDouble() + spacingPx / 2.0
+        if (pagesCount == 0 || target <= 0.0) return 0
+        val count = minOf(layoutIndex.countBelow(target) + 1, pagesCount)
+        if (count == pagesCount && autoSpacing &&
+            layoutIndex.prefixSum(pagesCount - 1) >= offset
+        ) return pagesCount - 1
+        return count
+    }
+
+    /**
+     * Pages overlapping the primary offsets from [startOffset] to [endOffset]. In single page
+     * mode every page lies at offset 0, so all of them are returned.
+     */
+    fun getPagesInRange(startOffset: Float, endOffset: Float, zoom: Float): IntRange = when {
+        singlePageMode -> 0 until pagesCount
+        else -> getPageAtOffset(startOffset, zoom)..getPageAtOffset(endOffset, zoom)
     }
 
     @Throws(PageRenderingException::class)
@@ -307,7 +584,10 @@ class PdfFile(
                 openedPages.indexOfKey(docPage) < 0 -> try {
                     pdfiumCore.openPage(docPage)
                     openedPages.put(docPage, true)
-                    openedPageQueue.add(pageIndex)
+                    val complexity = pdfiumCore.getPageComplexity(docPage)
+                    openedPageBytes.put(docPage, complexity?.memoryEstimate ?: 0)
+                    if (docPage < pageComplexity.size) pageComplexity[docPage] = complexity
+                    openedPageQueue.add(docPage)
                     if (openedPageQueue.size > maxPageCacheSize)
                         openedPageQueue.poll()?.let { closePage(it) }
                     true
@@ -321,15 +601,145 @@ class PdfFile(
         }
     }
 
-    private fun closePage(pageIndex: Int) {
+    private fun closePage(docPage: Int) {
+        synchronized(lock) {
+            if (openedPages.indexOfKey(docPage) >= 0) {
+                pdfiumCore.closePage(docPage)
+                openedPages.delete(docPage)
+            }
+            openedPageBytes.delete(docPage)
+            pendingReleasePages.remove(docPage)
+        }
+    }
+
+    /** Estimated native memory of the opened pages, excluding those waiting to be closed */
+    val openedPagesBytes: Long
+        get() = synchronized(lock) {
+            var bytes = 0L
+            for (i in 0 until openedPageBytes.size()) {
+                if (openedPageBytes.keyAt(i) !in pendingReleasePages)
+                    bytes += openedPageBytes.valueAt(i)
+            }
+            bytes
+        }
+
+    /**
+     * Marks the eldest opened page to be closed by the next [closeReleasedPages] call. Unless
+     * [aggressive], the most recently opened page is kept since it is likely still on screen.
+     *
+     * @return the estimated bytes that closing it will release, or 0 if no page is left.
+     */
+    fun requestPageRelease(aggressive: Boolean): Long = synchronized(lock) {
+        val candidates = when {
+            aggressive -> openedPageQueue
+            else -> openedPageQueue.take(openedPageQueue.size - 1)
+        }
+        val docPage = candidates.firstOrNull { it !in pendingReleasePages } ?: return 0
+        pendingReleasePages.add(docPage)
+        openedPageBytes.get(docPage)
+    }
+
+    /**
+     * Closes the pages marked by [requestPageRelease]. Must be called while holding the document,
+     * like rendering does, so that a page is never closed while it is being rendered.
+     */
+    fun closeReleasedPages() {
         synchronized(lock) {
-            if (openedPages.indexOfKey(pageIndex) >= 0) {
-                pdfiumCore.closePage(pageIndex)
-                openedPages.delete(pageIndex)
+            if (pendingReleasePages.isEmpty()) return
+            pendingReleasePages.toList().forEach { docPage ->
+                openedPageQueue.remove(docPage)
+                closePage(docPage)
             }
         }
     }
 
+    /** True once [loadAnnotationLayer] read the annotations of the page */
+    fun hasAnnotationLayer(pageIndex: Int): Boolean = synchronized(this) {
+        annotationLayers.indexOfKey(documentPage(pageIndex)) >= 0
+    }
+
+    /**
+     * Annotations of an opened page that are drawn above its content, read the first time and
+     * kept until [invalidateAnnotationLayer]. Must be called while holding the document, like
+     * rendering does.
+     */
+    fun loadAnnotationLayer(pageIndex: Int): AnnotationLayer? = synchronized(this) {
+        val docPage = documentPage(pageIndex)
+        if (docPage < 0) return null
+        annotationLayers[docPage] ?: pdfiumCore.getPageAnnotationLayer(docPage)
+            ?.also { annotationLayers.put(docPage, it) }
+    }
+
+    /** Forgets the annotations read for the page, the next [loadAnnotationLayer] reads them again */
+    fun invalidateAnnotationLayer(pageIndex: Int) = synchronized(this) {
+        annotationLayers.remove(documentPage(pageIndex))
+    }
+
+    /** Result of [applyAnnotationTransaction], with the annotation layer before and after it */
+    internal class AnnotationEdit(
+        val commit: AnnotationCommit,
+        val previousLayer: AnnotationLayer?,
+        val layer: AnnotationLayer?,
+    )
+
+    /**
+     * Applies [transaction] to the page in memory, see [PdfiumCore.applyAnnotationTransaction],
+     * and reads its annotation layer again if one was loaded. Returns null if the page cannot be
+     * opened.
+     */
+    internal fun applyAnnotationTransaction(
+        pageIndex: Int,
+        transaction: AnnotationTransaction,
+    ): AnnotationEdit? = synchronized(this) {
+        val docPage = documentPage(pageIndex)
+        if (docPage < 0) return null
+        try {
+            openPage(pageIndex)
+        } catch (_: PageRenderingException) {
+            return null
+        }
+        val previousLayer = annotationLayers[docPage]
+        val commit = pdfiumCore.applyAnnotationTransaction(docPage, transaction) ?: return null
+        if (commit.dirtyBounds == null) return AnnotationEdit(commit, previousLayer, previousLayer)
+
+        // A blank page may have something to draw now, and costs more to keep and render
+        if (pageIndex in pageBlankness.indices) pageBlankness[pageIndex] = PAGE_UNCHECKED
+        synchronized(lock) {
+            val complexity = pdfiumCore.getPageComplexity(docPage)
+            openedPageBytes.put(docPage, complexity?.memoryEstimate ?: 0)
+            if (docPage < pageComplexity.size) pageComplexity[docPage] = complexity
+        }
+        val layer = previousLayer?.let { pdfiumCore.getPageAnnotationLayer(docPage) }
+        when (layer) {
+            null -> annotationLayers.remove(docPage)
+            else -> annotationLayers.put(docPage, layer)
+        }
+        AnnotationEdit(commit, previousLayer, layer)
+    }
+
+    /** How expensive the page is to render, null until it has been opened once */
+    fun getPageComplexity(pageIndex: Int): PageComplexity? =
+        pageComplexity.getOrNull(documentPage(pageIndex))
+
+    /** True if [checkPageBlank] found the page blank, it is drawn as a solid fill then */
+    fun isPageBlank(pageIndex: Int): Boolean = pageBlankness.getOrNull(pageIndex) == PAGE_BLANK
+
+    /**
+     * Checks whether the page is blank, the first time only, the result is kept for the document.
+     * The page is opened for the check, it reuses the parsed page rendering needs anyway.
+     * Must be called while holding the document, like rendering does.
+     */
+    @Throws(PageRenderingException::class)
+    fun checkPageBlank(pageIndex: Int, annotationRendering: Boolean): Boolean {
+        val blankness = pageBlankness.getOrNull(pageIndex) ?: return false
+        if (blankness != PAGE_UNCHECKED) return blankness == PAGE_BLANK
+        val docPage = documentPage(pageIndex)
+        if (docPage < 0 || !openPage(pageIndex)) return false
+        val blank = pdfiumCore.isPageBlank(docPage, annotationRendering)
+        pageBlankness[pageIndex] = if (blank) PAGE_BLANK else PAGE_CONTENT
+        return blank
+    }
+
     fun pageHasError(pageIndex: Int): Boolean =
         !openedPages.getOrDefault(documentPage(pageIndex), false)
 
@@ -338,15 +748,26 @@ class PdfFile(
         pageIndex: Int,
         bounds: Rect,
         annotationRendering: Boolean,
-    ) = pdfiumCore.renderPageBitmap(
-        bitmap = bitmap,
-        pageIndex = documentPage(pageIndex),
-        startX = bounds.left,
-        startY = bounds.top,
-        drawSizeX = bounds.width(),
-        drawSizeY = bounds.height(),
-        renderAnnot = annotationRendering
-    )
+        draft: Boolean = false,
+        clear: Boolean = false,
+        pixelPipeline: PixelPipeline? = null,
+        crop: RectF? = null,
+    ) {
+        // A cropped page is rendered in full, shifted and scaled so that only the crop is drawn
+        val pageBounds = uncroppedBounds(bounds, crop)
+        pdfiumCore.renderPageBitmap(
+            bitmap = bitmap,
+            pageIndex = documentPage(pageIndex),
+            startX = pageBounds.left,
+            startY = pageBounds.top,
+            drawSizeX = pageBounds.width(),
+            drawSizeY = pageBounds.height(),
+            renderAnnot = annotationRendering,
+            draft = draft,
+            clear = clear,
+            pixelPipeline = pixelPipeline
+        )
+    }
 
     suspend fun getMetaData(): Meta = pdfiumCore.getDocumentMeta()
 
@@ -354,23 +775,233 @@ class PdfFile(
 
     fun getPageLinks(pageIndex: Int): List<Link> = pdfiumCore.getPageLinks(documentPage(pageIndex))
 
+    /**
+     * Searches every page of the document, [SEARCH_CHUNK_PAGES] pages per native call. The
+     * document is only held for the duration of a chunk so rendering can go on in between.
+     *
+     * @param isCancelled polled after every page, the search stops once it returns true.
+     * @param onPageResults receives the matches of each page, with user page indexes. Pages that
+     * are not part of the user page order are skipped.
+     * @return false if the search was cancelled.
+     */
+    fun searchDocument(
+        query: String,
+        matchCase: Boolean,
+        matchWholeWord: Boolean,
+        isCancelled: () -> Boolean,
+        onPageResults: (userPage: Int, matches: List<SearchMatch>) -> Unit,
+    ): Boolean {
+        val documentPagesCount = pdfiumCore.pageCount
+        var fromPage = 0
+        while (fromPage < documentPagesCount) {
+            val toPage = minOf(fromPage + SEARCH_CHUNK_PAGES, documentPagesCount) - 1
+            val result = synchronized(this) {
+                pdfiumCore.searchDocument(
+                    query = query,
+                    matchCase = matchCase,
+                    matchWholeWord = matchWholeWord,
+                    fromPage = fromPage,
+                    toPage = toPage
+                ) { docPage, matches ->
+                    val userPage = userPage(docPage)
+                    if (userPage >= 0 && matches.isNotEmpty())
+                        onPageResults(userPage, matches.map { it.copy(pageIndex = userPage) })
+                    !isCancelled()
+                }
+            }
+            if (result < 0) return false
+            fromPage = toPage + 1
+        }
+        return true
+    }
+
+    /**
+     * Searches the document as the user types, reusing the results of the previous queries of
+     * the same session, see [IncrementalSearchSession]. Pages are searched outwards from
+     * [centerPage], [SEARCH_CHUNK_PAGES] pages per native call, so the visible pages are reported
+     * first. The session is started again when the match options change.
+     *
+     * @param centerPage user page the search starts from, usually the current one.
+     * @param isCancelled polled after every page, the search stops once it returns true.
+     * @param onPageResults receives the matches of each page, with user page indexes. Their rects
+     * are empty on pages without a loaded text page, see [getTextRects].
+     * @return false if the search was cancelled.
+     */
+    fun searchIncremental(
+        query: String,
+        matchCase: Boolean,
+        matchWholeWord: Boolean,
+        centerPage: Int,
+        isCancelled: () -> Boolean,
+        onPageResults: (userPage: Int, matches: List<SearchMatch>) -> Unit,
+    ): Boolean {
+        val session = synchronized(this) {
+            incrementalSearch?.takeIf {
+                it.matchCase == matchCase && it.matchWholeWord == matchWholeWord
+            } ?: pdfiumCore.newIncrementalSearch(matchCase, matchWholeWord).also {
+                incrementalSearch?.close()
+                incrementalSearch = it
+            }
+        }
+
+        val pageOrder = searchPageOrder(centerPage)
+        var from = 0
+        while (from < pageOrder.size) {
+            val chunk = pageOrder.copyOfRange(from, minOf(from + SEARCH_CHUNK_PAGES, pageOrder.size))
+            val result = synchronized(this) {
+                session.search(query, chunk) { docPage, matches ->
+                    val userPage = userPage(docPage)
+                    if (userPage >= 0 && matches.isNotEmpty())
+                        onPageResults(userPage, matches.map { it.copy(pageIndex = userPage) })
+                    !isCancelled()
+                }
+            }
+            if (result < 0) return false
+            from += chunk.size
+        }
+        return true
+    }
+
+    /** Document pages of the user pages, alternating outwards from [centerPage] */
+    private fun searchPageOrder(centerPage: Int): IntArray {
+        val center = centerPage.coerceIn(0, (pagesCount - 1).coerceAtLeast(0))
+        val order = ArrayList<Int>(pagesCount)
+        for (distance in 0 until pagesCount) {
+            if (center + distance < pagesCount) order += documentPage(center + distance)
+            if (distance > 0 && center - distance >= 0) order += documentPage(center - distance)
+        }
+        return order.filter { it >= 0 }.distinct().toIntArray()
+    }
+
+    /**
+     * Highlight rects of a run of characters of a user page, in PDF page coordinates. The page is
+     * opened if needed, its text page is built from it.
+     */
+    fun getTextRects(pageIndex: Int, charIndex: Int, charCount: Int): List<RectF> =
+        synchronized(this) {
+            try {
+                if (!openPage(pageIndex)) return emptyList()
+            } catch (_: PageRenderingException) {
+                return emptyList()
+            }
+            pdfiumCore.getTextRects(documentPage(pageIndex), charIndex, charCount)
+        }
+
+    /**
+     * Writes the text of every document page to [fd] as UTF-8, [EXTRACT_CHUNK_PAGES] pages per
+     * native call so rendering can go on in between, see [PdfiumCore.extractText].
+     *
+     * @param isCancelled polled after every page, the extraction stops once it returns true.
+     * @param onProgress receives the number of pages written so far and the page count.
+     * @return the number of bytes written, -1 if cancelled or -2 if writing failed.
+     */
+    fun extractText(
+        fd: ParcelFileDescriptor,
+        isCancelled: () -> Boolean,
+        onProgress: (pagesDone: Int, pageCount: Int) -> Unit,
+    ): Long {
+        val documentPagesCount = pdfiumCore.pageCount
+        var bytes = 0L
+        var fromPage = 0
+        while (fromPage < documentPagesCount) {
+            val toPage = minOf(fromPage + EXTRACT_CHUNK_PAGES, documentPagesCount) - 1
+            val chunkStart = fromPage
+            val result = synchronized(this) {
+                pdfiumCore.extractText(fd, fromPage = fromPage, toPage = toPage) { done, _ ->
+                    onProgress(chunkStart + done, documentPagesCount)
+                    !isCancelled()
+                }
+            }
+            if (result < 0) return result
+            bytes += result
+            fromPage = toPage + 1
+        }
+        return bytes
+    }
+
+    /** Saves the document with its annotation edits to [fd], see [PdfiumCore.saveToFd] */
+    fun saveTo(fd: ParcelFileDescriptor, incremental: Boolean): SaveResult? =
+        synchronized(this) { pdfiumCore.saveToFd(fd, incremental) }
+
+    /** Permanent identifier of the document, null if it has none */
+    val documentIdentifier: String?
+        get() = synchronized(this) { pdfiumCore.documentIdentifier }
+
+    /**
+     * Builds the full-text index of the document into [file], [INDEX_CHUNK_PAGES] pages at a
+     * time. The document is only held while a chunk is indexed. The index is written once, when
+     * complete or when the build is cancelled, so that a cancelled build resumes from there next
+     * time. Once complete, the index is opened and used by [searchFullTextIndex].
+     *
+     * @param isCancelled polled after every chunk, the build stops once it returns true.
+     * @return false if the document has no identifier to key the index with, the index could not
+     * be written or the build was cancelled.
+     */
+    fun buildFullTextIndex(file: File, isCancelled: () -> Boolean): Boolean {
+        if (openFullTextIndex(file)?.isComplete == true) return true
+
+        val builder = synchronized(this) { pdfiumCore.newFullTextIndexBuilder(file) } ?: return false
+        builder.use {
+            while (!builder.isComplete) {
+                if (isCancelled()) {
+                    builder.save()
+                    return false
+                }
+                synchronized(this) { builder.indexPages(INDEX_CHUNK_PAGES) }
+            }
+            if (!builder.save()) return false
+        }
+        return openFullTextIndex(file)?.isComplete == true
+    }
+
+    /** Replaces the current full-text index with the one stored in [file], if it matches. */
+    private fun openFullTextIndex(file: File): FullTextIndex? = synchronized(this) {
+        fullTextIndex?.close()
+        fullTextIndex = pdfiumCore.openFullTextIndex(file)
+        fullTextIndex
+    }
+
+    /**
+     * Looks [query] up in the full-text index, see [FullTextIndex.search]. Positions are returned
+     * with user page indexes, pages outside the user page order are skipped.
+     *
+     * @return the positions found, empty if no index has been built.
+     */
+    fun searchFullTextIndex(query: String, prefix: Boolean): List<TextPosition> {
+        val index = fullTextIndex ?: return emptyList()
+        return index.search(query, prefix).mapNotNull { position ->
+            val userPage = userPage(position.pageIndex)
+            if (userPage >= 0) position.copy(pageIndex = userPage) else null
+        }
+    }
+
+    /** Maps a rect in page coordinates to the device area where the page, or its crop, is drawn */
     fun mapRectToDevice(
         pageIndex: Int, startX: Int, startY: Int, sizeX: Int, sizeY: Int,
         rect: RectF,
-    ): RectF = pdfiumCore.mapPageCoordinateToDevice(
-        pageIndex = documentPage(pageIndex),
-        startX = startX,
-        startY = startY,
-        sizeX = sizeX,
-        sizeY = sizeY,
-        rotate = 0,
-        coords = rect
-    )
+    ): RectF {
+        val drawBounds = Rect(startX, startY, startX + sizeX, startY + sizeY)
+        val pageBounds = uncroppedBounds(drawBounds, getPageCrop(pageIndex))
+        return pdfiumCore.mapPageCoordinateToDevice(
+            pageIndex = documentPage(pageIndex),
+            startX = pageBounds.left,
+            startY = pageBounds.top,
+            sizeX = pageBounds.width(),
+            sizeY = pageBounds.height(),
+            rotate = 0,
+            coords = rect
+        )
+    }
 
     fun dispose() {
         synchronized(this) {
+            fullTextIndex?.close()
+            fullTextIndex = null
+            incrementalSearch?.close()
+            incrementalSearch = null
             pdfiumCore.close()
             originalUserPages = null
+            firstUserPages = null
         }
     }
 
@@ -399,6 +1030,12 @@ class PdfFile(
         return userPage  // UserPage is already valid
     }
 
+    /** Returns the first user page showing the given document page, or -1 if none does */
+    fun userPage(documentPage: Int): Int = when (val userPages = firstUserPages) {
+        null -> if (documentPage in 0 until pagesCount) documentPage else -1
+        else -> userPages.get(documentPage, -1)
+    }
+
     fun documentPage(userPage: Int): Int {
         val documentPage: Int = when {
             // Check if userPage is within the original user-defined page order
@@ -418,5 +1055,23 @@ class PdfFile(
 
     companion object {
         private val lock = Any()
+
+        /** Pages searched per native call, see [searchDocument] */
+        private const val SEARCH_CHUNK_PAGES = 16
+
+        /** Pages indexed per hold of the document lock, see [buildFullTextIndex] */
+        private const val INDEX_CHUNK_PAGES = 64
+
+        /** Pages whose size is read up front to estimate the others */
+        private const val LAZY_SAMPLE_PAGES = 8
+
+        internal val FULL_PAGE = RectF(0f, 0f, 1f, 1f)
+
+        private const val PAGE_UNCHECKED: Byte = 0
+        private const val PAGE_CONTENT: Byte = 1
+        private const val PAGE_BLANK: Byte = 2
+
+        /** Pages extracted per native call, see [extractText] */
+        private const val EXTRACT_CHUNK_PAGES = 64
     }
 }
\ No newline at end of file
@@ -7,6 +7,7 @@ import android.graphics.RectF
 import android.os.Handler
 import android.os.Looper
 import android.os.Message
+import com.harissk.pdfium.PixelPipeline
 import com.harissk.pdfium.exception.PageRenderingException
 import com.harissk.pdfpreview.model.PagePart
 import kotlin.math.roundToInt
@@ -41,6 +42,7 @@ class RenderingHandler(looper: Looper, private val pdfView: PDFView) : Handler(l
 
     companion object {
         const val MSG_RENDER_TASK = 1
+        const val MSG_RELEASE_PAGES = 2
         private const val TAG = "RenderingHandler"
     }
 
@@ -53,6 +55,9 @@ class RenderingHandler(looper: Looper, private val pdfView: PDFView) : Handler(l
         cacheOrder: Int,
         bestQuality: Boolean,
         annotationRendering: Boolean,
+        draft: Boolean = false,
+        zoomLevel: Int = 0,
+        pixelPipeline: PixelPipeline? = null,
     ) {
         val task = RenderingTask(
             width = width,
@@ -62,19 +67,44 @@ class RenderingHandler(looper: Looper, private val pdfView: PDFView) : Handler(l
             thumbnail = thumbnail,
             cacheOrder = cacheOrder,
             bestQuality = bestQuality,
-            annotationRendering = annotationRendering
+            annotationRendering = annotationRendering,
+            draft = draft,
+            zoomLevel = zoomLevel,
+            pixelPipeline = pixelPipeline,
+            crop = pdfView.getPageCrop(page)
         )
         val msg: Message = obtainMessage(MSG_RENDER_TASK, task)
         sendMessage(msg)
     }
 
+    /** Closes the pages released by the memory governor once the current render is done */
+    fun releasePages() {
+        if (!hasMessages(MSG_RELEASE_PAGES)) sendEmptyMessage(MSG_RELEASE_PAGES)
+    }
+
     override fun handleMessage(message: Message) {
+        if (message.what == MSG_RELEASE_PAGES) {
+            if (running && !pdfView.isRecycled && !pdfView.isRecycling) {
+                val pdfFile: PdfFile = pdfView.pdfFile
+                synchronized(pdfFile) { pdfFile.closeReleasedPages() }
+            }
+            return
+        }
         val task = message.obj as RenderingTask
         try {
             val part = proceed(task)
             if (part != null) {
                 when {
-                    running && !pdfView.isRecycled -> pdfView.post { pdfView.onBitmapRendered(part); }
+                    running && !pdfView.isRecycled -> pdfView.post {
+                        // Tiles of a previous pixel pipeline or page crop must not reach the cache
+                        val isCurrent = task.pixelPipeline == pdfView.pixelPipeline &&
+                                task.crop == pdfView.getPageCrop(task.page)
+                        when {
+                            isCurrent -> pdfView.onBitmapRendered(part)
+                            else -> part.renderedBitmap?.let(pdfView.cacheManager.bitmapPool::put)
+                        }
+                    }
+
                     else -> part.renderedBitmap?.recycle()
                 }
             }
@@ -96,7 +126,30 @@ class RenderingHandler(looper: Looper, private val pdfView: PDFView) : Handler(l
         synchronized(pdfFile) {
             if (pdfView.isRecycled || pdfView.isRecycling || !running) return null
 
+            pdfFile.closeReleasedPages()
+            val wasProfiled = pdfFile.getPageComplexity(renderingTask.page) != null
             pdfFile.openPage(renderingTask.page)
+            // Opening the page measured its complexity, the loader can now schedule its tiles
+            if (!wasProfiled && pdfFile.getPageComplexity(renderingTask.page) != null)
+                pdfView.post { pdfView.onPageProfiled() }
+            // Blank pages are drawn as a fill, they are never rendered nor cached
+            if (pdfView.pdfViewerConfiguration.blankPageDetection &&
+                pdfFile.checkPageBlank(renderingTask.page, renderingTask.annotationRendering)
+            ) {
+                pdfView.post { pdfView.onPageBlank(renderingTask.page) }
+                return null
+            }
+            // Annotations the view draws itself are left out of the rendered content
+            var annotationRendering = renderingTask.annotationRendering
+            if (annotationRendering && pdfView.pdfViewerConfiguration.annotationOverlay) {
+                val wasLoaded = pdfFile.hasAnnotationLayer(renderingTask.page)
+                val layer = pdfFile.loadAnnotationLayer(renderingTask.page)
+                if (layer != null) {
+                    if (!wasLoaded)
+                        pdfView.post { pdfView.onAnnotationLayerLoaded(renderingTask.page, layer) }
+                    annotationRendering = !layer.isComplete
+                }
+            }
             val w = renderingTask.width
             val h = renderingTask.height
 
@@ -114,15 +167,14 @@ class RenderingHandler(looper: Looper, private val pdfView: PDFView) : Handler(l
                 return null
             }
 
-            val render: Bitmap = try {
-                createBitmap(
-                    width = roundedWidth,
-                    height = roundedHeight,
-                    config = when {
-                        renderingTask.bestQuality -> Bitmap.Config.ARGB_8888
-                        else -> Bitmap.Config.RGB_565
-                    }
-                )
+            val config = when {
+                renderingTask.draft -> Bitmap.Config.RGB_565
+                renderingTask.bestQuality -> Bitmap.Config.ARGB_8888
+                else -> Bitmap.Config.RGB_565
+            }
+            val pooled = pdfView.cacheManager.bitmapPool.get(roundedWidth, roundedHeight, config)
+            val render: Bitmap = pooled ?: try {
+                createBitmap(width = roundedWidth, height = roundedHeight, config = config)
             } catch (_: IllegalArgumentException) {
                 pdfView.logWriter?.writeLog("Cannot create bitmap", TAG)
                 return null
@@ -140,10 +192,14 @@ class RenderingHandler(looper: Looper, private val pdfView: PDFView) : Handler(l
                     bitmap = render,
                     pageIndex = renderingTask.page,
                     bounds = roundedRenderBounds,
-                    annotationRendering = renderingTask.annotationRendering
+                    annotationRendering = annotationRendering,
+                    draft = renderingTask.draft,
+                    clear = pooled != null,
+                    pixelPipeline = renderingTask.pixelPipeline,
+                    crop = renderingTask.crop
                 )
             } catch (_: Exception) {
-                render.recycle()
+                pdfView.cacheManager.bitmapPool.put(render)
                 return null
             }
 
@@ -152,7 +208,9 @@ class RenderingHandler(looper: Looper, private val pdfView: PDFView) : Handler(l
                 renderedBitmap = render,
                 pageRelativeBounds = renderingTask.bounds ?: RectF(),
                 isThumbnail = renderingTask.thumbnail,
-                cacheOrder = renderingTask.cacheOrder
+                cacheOrder = renderingTask.cacheOrder,
+                isDraft = renderingTask.draft,
+                zoomLevel = renderingTask.zoomLevel
             )
         }
     }
@@ -183,5 +241,9 @@ class RenderingHandler(looper: Looper, private val pdfView: PDFView) : Handler(l
         var cacheOrder: Int,
         var bestQuality: Boolean,
         var annotationRendering: Boolean,
+        var draft: Boolean,
+        var zoomLevel: Int,
+        var pixelPipeline: PixelPipeline?,
+        var crop: RectF?,
     )
 }
\ No newline at end of file
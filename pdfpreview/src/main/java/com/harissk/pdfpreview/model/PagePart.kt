@@ -28,6 +28,9 @@ import android.graphics.RectF
  * @param isThumbnail        Whether this page part represents a thumbnail.
  * @param cacheOrder          The order in which the page part was added to the cache, used for
  * caching strategies.
+ * @param isDraft            Whether this page part is a reduced quality render that should be
+ * replaced once the view settles.
+ * @param zoomLevel          The tile pyramid level this page part was rendered for.
  */
 data class PagePart(
     val page: Int,
@@ -35,4 +38,6 @@ data class PagePart(
     val pageRelativeBounds: RectF,
     val isThumbnail: Boolean,
     var cacheOrder: Int,
+    val isDraft: Boolean = false,
+    val zoomLevel: Int = 0,
 )
\ No newline at end of file
@@ -1,5 +1,7 @@
 package com.harissk.pdfpreview.request
 
+import com.harissk.pdfium.ColorMode
+import com.harissk.pdfium.PixelPipeline
 import com.harissk.pdfium.listener.LogWriter
 import com.harissk.pdfpreview.link.LinkHandler
 import com.harissk.pdfpreview.listener.GestureEventListener
@@ -7,6 +9,7 @@ import com.harissk.pdfpreview.listener.PageNavigationEventListener
 import com.harissk.pdfpreview.listener.RenderingEventListener
 import com.harissk.pdfpreview.listener.ZoomEventListener
 import com.harissk.pdfpreview.scroll.ScrollHandle
+import com.harissk.pdfpreview.utils.CropPolicy
 import com.harissk.pdfpreview.utils.FitPolicy
 
 /**
@@ -42,7 +45,9 @@ import com.harissk.pdfpreview.utils.FitPolicy
  * @property pageFling Enables or disables page flinging for faster navigation. Defaults to false.
  * @property pageSnap Enables or disables page snapping, where pages will snap to the screen edges. Defaults to false.
  * @property scrollOptimization Enables or disables scroll optimization. When true, bitmap generation is skipped during scrolling for better performance, but may show empty areas when scrolling to new content. Defaults to true.
- * @property nightMode Enables or disables night mode, which inverts the colors for better readability in low-light conditions. Defaults to false.
+ * @property nightMode Enables or disables night mode, which inverts the colors for better readability in low-light conditions. Same as [ColorMode.NIGHT]. Defaults to false.
+ * @property colorMode The color transform applied to pages when they are rendered, such as night, sepia or high contrast. Takes precedence over [nightMode] unless [ColorMode.NONE]. Defaults to [ColorMode.NONE].
+ * @property pixelPipeline Custom color transforms applied to pages when they are rendered, such as gamma and contrast for faint scans. Takes precedence over [colorMode] and [nightMode]. Defaults to null.
  * @property disableLongPress Disables long press gestures on the PDF view. Defaults to false.
  * @property scrollHandle The type of scroll handle to display. Defaults to null (no scroll handle).
  * @property pdfViewerConfiguration Custom rendering options for the PDF document. Defaults to [PdfViewerConfiguration.DEFAULT].
@@ -53,6 +58,7 @@ import com.harissk.pdfpreview.utils.FitPolicy
  * @property linkHandler A handler for processing link clicks in the PDF document. Defaults to null.
  * @property logWriter A writer for logging messages and errors. Defaults to null.
  * @property singlePageMode When true, displays only one page at a time in both portrait and landscape orientations, with no visibility of adjacent pages. When false, uses the traditional continuous scroll behavior. Defaults to false.
+ * @property cropPolicy How the white margins of pages are cropped, cropped pages fill more of the screen at the same zoom and render fewer pixels. Defaults to [CropPolicy.NONE].
  */
 data class PdfViewConfiguration(
     val enableSwipe: Boolean = true,
@@ -68,6 +74,8 @@ data class PdfViewConfiguration(
     val pageSnap: Boolean = false,
     val scrollOptimization: Boolean = true,
     val nightMode: Boolean = false,
+    val colorMode: ColorMode = ColorMode.NONE,
+    val pixelPipeline: PixelPipeline? = null,
     val disableLongPress: Boolean = false,
     val scrollHandle: ScrollHandle? = null,
     val pdfViewerConfiguration: PdfViewerConfiguration = PdfViewerConfiguration.DEFAULT,
@@ -78,6 +86,7 @@ data class PdfViewConfiguration(
     val linkHandler: LinkHandler? = null,
     val logWriter: LogWriter? = null,
     val singlePageMode: Boolean = false,
+    val cropPolicy: CropPolicy = CropPolicy.NONE,
 ) {
 
     class Builder {
@@ -94,6 +103,8 @@ data class PdfViewConfiguration(
         private var pageSnap: Boolean = false
         private var scrollOptimization: Boolean = true
         private var nightMode: Boolean = false
+        private var colorMode: ColorMode = ColorMode.NONE
+        private var pixelPipeline: PixelPipeline? = null
         private var disableLongPress: Boolean = false
         private var scrollHandle: ScrollHandle? = null
         private var pdfViewerConfiguration: PdfViewerConfiguration = PdfViewerConfiguration.DEFAULT
@@ -104,6 +115,7 @@ data class PdfViewConfiguration(
         private var linkHandler: LinkHandler? = null
         private var logWriter: LogWriter? = null
         private var singlePageMode: Boolean = false
+        private var cropPolicy: CropPolicy = CropPolicy.NONE
 
         fun enableSwipe(enableSwipe: Boolean): Builder {
             this.enableSwipe = enableSwipe
@@ -170,6 +182,16 @@ data class PdfViewConfiguration(
             return this
         }
 
+        fun colorMode(colorMode: ColorMode): Builder {
+            this.colorMode = colorMode
+            return this
+        }
+
+        fun pixelPipeline(pixelPipeline: PixelPipeline?): Builder {
+            this.pixelPipeline = pixelPipeline
+            return this
+        }
+
         fun disableLongPress(): Builder {
             this.disableLongPress = true
             return this
@@ -222,6 +244,11 @@ data class PdfViewConfiguration(
             return this
         }
 
+        fun cropPolicy(cropPolicy: CropPolicy): Builder {
+            this.cropPolicy = cropPolicy
+            return this
+        }
+
         fun build() = PdfViewConfiguration(
             enableSwipe = enableSwipe,
             enableDoubleTap = enableDoubleTap,
@@ -236,6 +263,8 @@ data class PdfViewConfiguration(
             pageFling = pageFling,
             scrollOptimization = scrollOptimization,
             nightMode = nightMode,
+            colorMode = colorMode,
+            pixelPipeline = pixelPipeline,
             disableLongPress = disableLongPress,
             scrollHandle = scrollHandle,
             pdfViewerConfiguration = pdfViewerConfiguration,
@@ -246,6 +275,7 @@ data class PdfViewConfiguration(
             linkHandler = linkHandler,
             logWriter = logWriter,
             singlePageMode = singlePageMode,
+            cropPolicy = cropPolicy,
         )
     }
 
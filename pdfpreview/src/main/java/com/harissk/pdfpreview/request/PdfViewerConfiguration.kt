@@ -30,6 +30,15 @@ package com.harissk.pdfpreview.request
  * @param maxCachedThumbnails The size of the thumbnail bitmap cache.
  * @param minZoom    The minimum zoom level allowed when pinching.
  * @param maxZoom    The maximum zoom level allowed when pinching.
+ * @param draftRendering Whether low quality draft tiles are rendered while flinging.
+ * @param draftRenderScale The resolution of draft tiles relative to full quality tiles.
+ * @param zoomLevelStep The zoom ratio between two consecutive levels of the tile pyramid.
+ * @param memoryBudgetBytes The memory shared by rendered tiles, thumbnails and opened pages.
+ * @param maxPooledBitmaps The number of evicted tile bitmaps kept for reuse.
+ * @param lazyPageSizeThreshold The page count above which page sizes are estimated at load time.
+ * @param blankPageDetection Whether blank pages are drawn as a solid fill instead of tiles.
+ * @param heavyPageCost The render cost from which pages are scheduled as heavy pages.
+ * @param annotationOverlay Whether simple annotations are drawn by the view above the tiles.
  */
 data class PdfViewerConfiguration(
     /**
@@ -74,6 +83,58 @@ data class PdfViewerConfiguration(
      * Maximum zoom level.
      */
     val maxZoom: Float = 5f,
+    /**
+     * Render cheap draft tiles while a fling is in progress instead of leaving empty areas.
+     * Visible draft tiles are re-rendered at full quality once the motion stops.
+     */
+    val draftRendering: Boolean = true,
+    /**
+     * Between 0 and 1, the resolution of draft tiles relative to full quality tiles (default 0.5).
+     */
+    val draftRenderScale: Float = 0.5f,
+    /**
+     * Tiles are rendered at discrete zoom levels that are powers of this step (default 1.5),
+     * use 2 for a power-of-two pyramid. Zooming within a level reuses the cached tiles, and
+     * tiles of other levels are shown scaled until the current level is rendered.
+     * Bigger : fewer re-renders while pinching but more pixels rendered per tile.
+     */
+    val zoomLevelStep: Float = 1.5f,
+    /**
+     * Bytes that rendered tiles, thumbnails and opened pages may hold together before the least
+     * valuable entries are released. 0 (default) derives the budget from the device memory class.
+     */
+    val memoryBudgetBytes: Long = 0L,
+    /**
+     * The number of bitmaps of evicted tiles kept to render new tiles into (default 16), which
+     * avoids allocating a bitmap for every tile while scrolling. 0 disables the pool.
+     */
+    val maxPooledBitmaps: Int = 16,
+    /**
+     * Documents with more pages than this (default 1000) are laid out from the size of their first
+     * pages, so that loading does not read every page size. Real sizes are read in the background,
+     * around the visible page first, and the layout is adjusted without moving the visible page.
+     * 0 reads every page size before the document is shown.
+     */
+    val lazyPageSizeThreshold: Int = 1000,
+    /**
+     * Check each page once before its first tile is rendered and draw blank pages, such as empty
+     * scanned separator pages, as a solid fill with no tiles rendered or cached (default true).
+     */
+    val blankPageDetection: Boolean = true,
+    /**
+     * Pages whose estimated render cost reaches this value (default 100 000), such as CAD drawings
+     * and maps, are rendered in larger tiles, get no draft tiles and are not prefetched outside
+     * the screen, their thumbnail stands in meanwhile. See PageComplexity.renderCost, 0 treats
+     * every page alike.
+     */
+    val heavyPageCost: Long = 100_000L,
+    /**
+     * Draw markups, ink, lines and shapes without an appearance stream as vectors above the
+     * rendered page content instead of rendering them into the tiles, so that editing them only
+     * redraws the annotations (default true). Pages with any other visible annotation, such as
+     * form fields or stamps, keep all their annotations rendered into the tiles.
+     */
+    val annotationOverlay: Boolean = true,
 ) {
     companion object {
         val DEFAULT: PdfViewerConfiguration = PdfViewerConfiguration()
@@ -15,6 +15,7 @@
  */
 package com.harissk.pdfpreview.thumbnail
 
+import android.content.ComponentCallbacks2
 import android.content.Context
 import android.graphics.Bitmap
 import android.graphics.Canvas
@@ -210,6 +211,17 @@ object PDFThumbnailGenerator {
      */
     fun getCacheSize(): Int = thumbnailCache.size()
 
+    /**
+     * Shrinks the thumbnail cache according to an [ComponentCallbacks2.onTrimMemory] level.
+     */
+    fun trimMemory(level: Int) {
+        when {
+            level >= ComponentCallbacks2.TRIM_MEMORY_UI_HIDDEN -> thumbnailCache.evictAll()
+            level >= ComponentCallbacks2.TRIM_MEMORY_RUNNING_LOW ->
+                thumbnailCache.trimToSize(thumbnailCache.maxSize() / 2)
+        }
+    }
+
     /**
      * Internal method to generate a thumbnail for a specific document and page.
      */
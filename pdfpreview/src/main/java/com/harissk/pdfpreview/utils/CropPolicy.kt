@@ -0,0 +1,40 @@
+package com.harissk.pdfpreview.utils
+
+/**
+ * Copyright [2025] [Haris Kumar R](https://github.com/rhariskumar3)
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ * */
+
+/**
+ * Enum representing the policies for cropping the white margins of PDF pages. Cropped pages are
+ * laid out, rendered and cached without their margins.
+ */
+enum class CropPolicy {
+    /**
+     * Show pages in full.
+     */
+    NONE,
+
+    /**
+     * Crop pages to the bounds of their text, paths and images. Pages covered by a single image,
+     * like scans, are shown in full.
+     */
+    CONTENT,
+
+    /**
+     * Like [CONTENT], and find the content of pages covered by an image with a low resolution
+     * render, which crops the margins of scans too.
+     */
+    CONTENT_AND_SCANS
+}
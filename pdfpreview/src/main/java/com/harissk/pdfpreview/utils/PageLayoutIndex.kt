@@ -0,0 +1,97 @@
+package com.harissk.pdfpreview.utils
+
+/**
+ * Copyright [2025] [Haris Kumar R](https://github.com/rhariskumar3)
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ * */
+
+/**
+ * Cumulative extents of the pages along the scroll axis, kept in a Fenwick tree.
+ *
+ * Each page contributes its extent, its length plus the spacing after it. The offset of a page
+ * is the sum of the extents before it, found in O(log n), and so is the page at an offset. A
+ * page extent can be changed in O(log n) without touching the other pages, so page sizes that
+ * arrive late only cost a logarithmic update.
+ *
+ * Sums are kept in doubles, float sums drift by whole pixels over tens of thousands of pages.
+ */
+internal class PageLayoutIndex(extents: FloatArray) {
+
+    private val extents = extents.copyOf()
+    private val tree = DoubleArray(extents.size + 1)
+
+    val size: Int
+        get() = extents.size
+
+    /** Sum of every extent. */
+    var total = 0.0
+        private set
+
+    init {
+        // Linear construction, each node passes its sum on to its parent
+        for (i in extents.indices) {
+            val node = i + 1
+            tree[node] += extents[i].toDouble()
+            val parent = node + (node and -node)
+            if (parent <= size) tree[parent] += tree[node]
+            total += extents[i]
+        }
+    }
+
+    /** Extent of the page at [index]. */
+    operator fun get(index: Int): Float = extents[index]
+
+    /** Changes the extent of the page at [index]. */
+    operator fun set(index: Int, extent: Float) {
+        val delta = extent.toDouble() - extents[index]
+        if (delta == 0.0) return
+        extents[index] = extent
+        total += delta
+        var node = index + 1
+        while (node <= size) {
+            tree[node] += delta
+            node += node and -node
+        }
+    }
+
+    /** Sum of the extents of the first [count] pages, that is the offset of page [count]. */
+    fun prefixSum(count: Int): Double {
+        var sum = 0.0
+        var node = count.coerceIn(0, size)
+        while (node > 0) {
+            sum += tree[node]
+            node -= node and -node
+        }
+        return sum
+    }
+
+    /**
+     * Returns the largest count of pages whose extents sum to less than [target], between 0 and
+     * [size]. Extents must not be negative.
+     */
+    fun countBelow(target: Double): Int {
+        var position = 0
+        var remaining = target
+        var step = Integer.highestOneBit(size)
+        while (step > 0) {
+            val next = position + step
+            if (next <= size && tree[next] < remaining) {
+                position = next
+                remaining -= tree[next]
+            }
+            step = step shr 1
+        }
+        return position
+    }
+}
@@ -0,0 +1,45 @@
+package com.harissk.pdfpreview.utils
+
+import kotlin.math.ceil
+import kotlin.math.ln
+import kotlin.math.pow
+
+/**
+ * Copyright [2025] [Haris Kumar R](https://github.com/rhariskumar3)
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ * */
+
+/**
+ * Maps continuous zoom values onto the discrete levels of the tile pyramid.
+ *
+ * Level `n` is rendered at a zoom of `step^n`. A zoom value always maps to the smallest level
+ * whose zoom is greater than or equal to it, so tiles are only ever scaled down on screen and
+ * never appear blurred.
+ */
+internal object TilePyramid {
+
+    private const val MIN_STEP = 1.1f
+
+    // Absorbs float noise so that a zoom of exactly step^n maps to level n
+    private const val LEVEL_EPSILON = 1e-3f
+
+    /** Returns the pyramid level used to render tiles shown at [zoom]. */
+    fun levelFor(zoom: Float, step: Float): Int {
+        if (zoom <= 0f || zoom.isNaN()) return 0
+        return ceil(ln(zoom) / ln(step.coerceAtLeast(MIN_STEP)) - LEVEL_EPSILON).toInt()
+    }
+
+    /** Returns the zoom at which tiles of the given pyramid [level] are rendered. */
+    fun zoomFor(level: Int, step: Float): Float = step.coerceAtLeast(MIN_STEP).pow(level)
+}
@@ -0,0 +1,25 @@
+#!/usr/bin/env bash
+
+# Builds and runs the host benchmarks of the native code in pdfium/src/benchmark/cpp.
+# They need no Android SDK or pdfium binaries, only a C++11 compiler (CXX, default c++).
+# Run on an ARM machine to check and time the NEON kernels.
+
+set -euo pipefail
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_ROOT="$(cd "$SCRIPT_DIR/.." && pwd)"
+BENCHMARK_DIR="$PROJECT_ROOT/pdfium/src/benchmark/cpp"
+BUILD_DIR="$(mktemp -d)"
+trap 'rm -rf "$BUILD_DIR"' EXIT
+
+CXX="${CXX:-c++}"
+status=0
+for source in "$BENCHMARK_DIR"/*.cpp; do
+  name="$(basename "$source" .cpp)"
+  echo ""
+  echo "▶ $name"
+  "$CXX" -std=c++11 -O2 -Wall -I"$PROJECT_ROOT/pdfium/src/main/cpp/utils" \
+    "$source" -o "$BUILD_DIR/$name"
+  "$BUILD_DIR/$name" || status=1
+done
+exit $status